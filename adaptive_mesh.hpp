@@ -0,0 +1,636 @@
+#pragma once
+
+#include "error_estimator.hpp"
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "post_processing.hpp"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fem
+{
+    // Адаптивное h-измельчение. Каждый элемент исходной сетки - корень квадродерева;
+    // листья хранятся линейным списком в порядке Мортона (корень, код Мортона угла).
+    // Отмеченный лист делится на четыре, соседи по рёбрам различаются не более чем на
+    // один уровень, а висячие узлы выражаются через концы ребра крупного элемента
+    // связями Mesh::Constraint. Матрицы жёсткости неизменившихся листьев и решение
+    // предыдущего шага (начальное приближение для CG) переносятся на новую сетку.
+    // Исходные элементы - прямоугольники с узлами против часовой стрелки от левого нижнего.
+    template <typename T>
+    class AdaptiveMesh
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using Indices = typename Mesh::Indices;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using Key = std::uint64_t;
+
+        static unsigned const maxLevel = 16;
+
+        // Один материал на всю сетку
+        AdaptiveMesh(Mesh const &baseMesh,
+                     Value const &elasticityModulus,
+                     Value const &poissonRatio,
+                     unsigned nThreads = 0) : baseNodes(baseMesh.getNodes()),
+                                              baseElements(baseMesh.getElements()),
+                                              baseNodeSets(baseMesh.getNodeSets()),
+                                              materials{{elasticityModulus, poissonRatio, 0}},
+                                              nThreads(nThreads != 0 ? nThreads : hardwareThreads())
+        {
+            valid = baseMesh.checkSingleMaterial("adaptive refinement");
+            this->initialize();
+        }
+
+        // Материалы из таблицы исходной сетки; потомки наследуют материал корня
+        AdaptiveMesh(Mesh const &baseMesh, unsigned nThreads = 0) : baseNodes(baseMesh.getNodes()),
+                                                                     baseElements(baseMesh.getElements()),
+                                                                     baseNodeSets(baseMesh.getNodeSets()),
+                                                                     materials(baseMesh.getMaterials()),
+                                                                     baseMaterialIds(baseMesh.getMaterialIds()),
+                                                                     nThreads(nThreads != 0 ? nThreads : hardwareThreads())
+        {
+            valid = baseMesh.checkMaterialTable();
+            this->initialize();
+        }
+
+        const Mesh &getMesh() const
+        {
+            return *mesh;
+        }
+
+        Mesh &getMesh()
+        {
+            return *mesh;
+        }
+
+        // Уровень листа, соответствующего элементу e текущей сетки
+        Size getLevel(Size const &e) const
+        {
+            return leaves[e].level;
+        }
+
+        Size getNumReusedMatrices() const
+        {
+            return nReusedMatrices;
+        }
+
+        // Число измельчений, выполненных последним refineAdaptively
+        Size getNumRefinements() const
+        {
+            return nRefinements;
+        }
+
+        // Сборка (заново считаются только матрицы новых листьев) и решение методом
+        // сопряжённых градиентов от перенесённого решения предыдущей сетки
+        bool solve(Value const &tolerance = std::sqrt(Eigen::NumTraits<Value>::epsilon()))
+        {
+            if (!valid)
+                return false;
+            nReusedMatrices = std::count(validMatrices.begin(), validMatrices.end(), 1);
+            parallelFor(0, leaves.size(), [&](std::size_t e)
+                        {
+                            if (validMatrices[e])
+                                return;
+                            FiniteElement fe;
+                            typename FiniteElement::Nodes feNodes;
+                            mesh->getElementNodes(feNodes, e);
+                            auto const &material = mesh->getElementMaterial(e);
+                            fe.calculateStiffnessMatrix(elementMatrices[e], feNodes, material.elasticityModulus, material.poissonRatio);
+                            validMatrices[e] = 1; },
+                        nThreads, 256);
+
+            if (!mesh->assembleSparseStiffnessMatrix([&](Size const &e) -> typename FiniteElement::StiffnessMatrix const &
+                                                     { return elementMatrices[e]; }))
+                return false;
+            mesh->calculateForceVector();
+            return mesh->calculateIterativeDisplacementVector(initialGuess, tolerance);
+        }
+
+        // Деление отмеченных элементов текущей сетки; соседи измельчаются для баланса 2:1
+        void refine(Indices const &marked)
+        {
+            std::vector<char> flags(leaves.size(), 0);
+            std::vector<Size> work;
+            for (Size i = 0; i < marked.size(); ++i)
+            {
+                Size e = marked(i);
+                if (leaves[e].level < maxLevel && !flags[e])
+                {
+                    flags[e] = 1;
+                    work.push_back(e);
+                }
+            }
+            while (!work.empty())
+            {
+                Size e = work.back();
+                work.pop_back();
+                for (Size k = 0; k < 4; ++k)
+                {
+                    Size n = this->findNeighbour(e, k);
+                    if (n != none && leaves[n].level < leaves[e].level && !flags[n])
+                    {
+                        flags[n] = 1;
+                        work.push_back(n);
+                    }
+                }
+            }
+
+            // Потомки записываются на место родителя, поэтому порядок Мортона сохраняется
+            std::vector<Leaf> newLeaves;
+            std::vector<Size> origins;
+            MatrixCache newMatrices;
+            std::vector<char> newValid;
+            for (Size e = 0; e < leaves.size(); ++e)
+            {
+                Leaf const &leaf = leaves[e];
+                if (!flags[e])
+                {
+                    newLeaves.push_back(leaf);
+                    origins.push_back(e);
+                    newMatrices.push_back(elementMatrices[e]);
+                    newValid.push_back(validMatrices[e]);
+                    continue;
+                }
+                std::uint32_t half = this->getLeafSize(leaf) / 2;
+                for (std::uint32_t c = 0; c < 4; ++c)
+                {
+                    Leaf child;
+                    child.root = leaf.root;
+                    child.level = leaf.level + 1;
+                    child.x = leaf.x + (c & 1) * half;
+                    child.y = leaf.y + (c >> 1) * half;
+                    child.key = (child.root << 32) | interleave(child.x, child.y);
+                    newLeaves.push_back(child);
+                    origins.push_back(e);
+                    newMatrices.emplace_back();
+                    newValid.push_back(0);
+                }
+            }
+
+            previousLeaves.swap(leaves);
+            leaves.swap(newLeaves);
+            elementMatrices.swap(newMatrices);
+            validMatrices.swap(newValid);
+            this->buildMesh(origins, flags);
+            previousLeaves.clear();
+        }
+
+        // Цикл решение -> оценка Зенкевича-Жу -> измельчение до достижения относительной
+        // погрешности targetRelativeError. Возвращает false, если решение на очередной сетке
+        // не удалось; число выполненных измельчений даёт getNumRefinements
+        bool refineAdaptively(Value const &targetRelativeError, Size const &maxSteps)
+        {
+            nRefinements = 0;
+            if (!this->solve())
+                return false;
+            for (;; ++nRefinements)
+            {
+                PostProcessor<T> postProcessor(*mesh, nThreads);
+                ErrorEstimator<T> estimator(*mesh, nThreads);
+                if (!postProcessor.calculateFields() || !estimator.calculateErrors(postProcessor))
+                    return false;
+                std::cout << "Refinement step " << nRefinements << ": " << mesh->getNumNodes() << " nodes, "
+                          << mesh->getNumElements() << " elements, " << mesh->getConstraints().size()
+                          << " hanging nodes, relative error " << estimator.getRelativeError() << std::endl;
+
+                Indices marked;
+                if (nRefinements == maxSteps || estimator.getRelativeError() <= targetRelativeError)
+                    break;
+                estimator.markElements(marked, targetRelativeError);
+                if (marked.size() == 0)
+                    break;
+                this->refine(marked);
+                if (!this->solve())
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        static Size const none = ~Size(0);
+        static std::uint32_t const rootSize = std::uint32_t(1) << maxLevel;
+
+        // Лист: корень, уровень и левый нижний угол в координатах самого мелкого уровня [0, rootSize)
+        struct Leaf
+        {
+            Key key;
+            Size root;
+            Size level;
+            std::uint32_t x, y;
+        };
+
+        // Узел определяется независимо от элемента, из которого он получен:
+        // узел исходной сетки, точка на ребре исходной сетки (младший узел ребра, старший, позиция)
+        // или точка внутри корня (корень, x, y)
+        struct NodeKey
+        {
+            std::uint64_t a, b;
+
+            bool operator==(NodeKey const &other) const
+            {
+                return a == other.a && b == other.b;
+            }
+        };
+
+        struct NodeKeyHash
+        {
+            std::size_t operator()(NodeKey const &key) const
+            {
+                return std::size_t(key.a * 0x9E3779B97F4A7C15ull ^ (key.b + 0x7F4A7C159E3779B9ull + (key.a << 6)));
+            }
+        };
+
+        using NodeIndex = std::unordered_map<NodeKey, Size, NodeKeyHash>;
+        using MatrixCache = std::vector<typename FiniteElement::StiffnessMatrix,
+                                        Eigen::aligned_allocator<typename FiniteElement::StiffnessMatrix>>;
+
+        static Key interleave(std::uint32_t x, std::uint32_t y)
+        {
+            auto spread = [](Key v)
+            {
+                v &= 0xFFFF;
+                v = (v | (v << 8)) & 0x00FF00FF;
+                v = (v | (v << 4)) & 0x0F0F0F0F;
+                v = (v | (v << 2)) & 0x33333333;
+                v = (v | (v << 1)) & 0x55555555;
+                return v;
+            };
+            return spread(x) | (spread(y) << 1);
+        }
+
+        static std::uint32_t getLeafSize(Leaf const &leaf)
+        {
+            return rootSize >> leaf.level;
+        }
+
+        // Лист, содержащий ячейку (x, y) корня root: последний лист с ключом не больше ключа ячейки
+        Size findLeaf(Size const &root, std::uint32_t const &x, std::uint32_t const &y) const
+        {
+            Key key = (Key(root) << 32) | interleave(x, y);
+            auto it = std::upper_bound(leaves.begin(), leaves.end(), key,
+                                       [](Key const &k, Leaf const &leaf)
+                                       { return k < leaf.key; });
+            return Size(it - leaves.begin()) - 1;
+        }
+
+        // Лист за ребром k листа e (рёбра нумеруются как в элементе: низ, право, верх, лево)
+        Size findNeighbour(Size const &e, Size const &k) const
+        {
+            Leaf const &leaf = leaves[e];
+            std::int64_t size = this->getLeafSize(leaf), n = rootSize;
+            std::int64_t x = leaf.x, y = leaf.y;
+            switch (k)
+            {
+            case 0:
+                --y;
+                break;
+            case 1:
+                x += size;
+                break;
+            case 2:
+                y += size;
+                break;
+            default:
+                --x;
+            }
+            Size root = leaf.root;
+            if (x < 0 || y < 0 || x >= n || y >= n)
+            {
+                // Позиция вдоль ребра корня, отсчитанная от его начального узла
+                std::int64_t t = k == 0 ? x : k == 1 ? y
+                                          : k == 2   ? n - 1 - x
+                                                     : n - 1 - y;
+                Size neighbour = rootNeighbours[root * 4 + k];
+                if (neighbour == none)
+                    return none;
+                root = neighbour / 4;
+                t = n - 1 - t;
+                switch (neighbour % 4)
+                {
+                case 0:
+                    x = t, y = 0;
+                    break;
+                case 1:
+                    x = n - 1, y = t;
+                    break;
+                case 2:
+                    x = n - 1 - t, y = n - 1;
+                    break;
+                default:
+                    x = 0, y = n - 1 - t;
+                }
+            }
+            return this->findLeaf(root, std::uint32_t(x), std::uint32_t(y));
+        }
+
+        // Ключ узла в точке (x, y) корня root, x и y из [0, rootSize]; для точки на ребре корня
+        // возвращаются концы ребра и доля пути от младшего из них
+        NodeKey getNodeKey(Size const &root, std::uint32_t const &x, std::uint32_t const &y,
+                           Size &edgeStart, Size &edgeEnd, std::uint32_t &t) const
+        {
+            std::uint32_t const n = rootSize;
+            auto const &corners = baseElements(root);
+            bool onX = x == 0 || x == n, onY = y == 0 || y == n;
+            if (onX && onY)
+            {
+                Size k = y == 0 ? (x == 0 ? 0 : 1) : (x == n ? 2 : 3);
+                edgeStart = edgeEnd = corners(k);
+                t = 0;
+                return {corners(k), 0};
+            }
+            if (onX || onY)
+            {
+                Size k = y == 0 ? 0 : x == n ? 1
+                                  : y == n   ? 2
+                                             : 3;
+                t = k == 0 ? x : k == 1 ? y
+                             : k == 2   ? n - x
+                                        : n - y;
+                edgeStart = corners(k);
+                edgeEnd = corners((k + 1) % 4);
+                if (edgeEnd < edgeStart)
+                {
+                    std::swap(edgeStart, edgeEnd);
+                    t = n - t;
+                }
+                return {(std::uint64_t(1) << 62) | edgeStart, (edgeEnd << 16) | t};
+            }
+            edgeStart = edgeEnd = none;
+            t = 0;
+            return {(std::uint64_t(2) << 62) | root, (std::uint64_t(x) << 32) | y};
+        }
+
+        void initialize()
+        {
+            std::map<std::pair<Size, Size>, Size> edges;
+            rootNeighbours.assign(baseElements.size() * 4, none);
+            for (Size r = 0; r < baseElements.size(); ++r)
+            {
+                for (Size k = 0; k < 4; ++k)
+                {
+                    Size a = baseElements(r)(k), b = baseElements(r)((k + 1) % 4);
+                    auto found = edges.emplace(std::make_pair(std::min(a, b), std::max(a, b)), r * 4 + k);
+                    if (!found.second)
+                    {
+                        rootNeighbours[r * 4 + k] = found.first->second;
+                        rootNeighbours[found.first->second] = r * 4 + k;
+                    }
+                }
+            }
+
+            leaves.resize(baseElements.size());
+            for (Size r = 0; r < baseElements.size(); ++r)
+            {
+                leaves[r] = {r << 32, r, 0, 0, 0};
+            }
+            elementMatrices.resize(leaves.size());
+            validMatrices.assign(leaves.size(), 0);
+            this->buildMesh(std::vector<Size>(), std::vector<char>());
+        }
+
+        void buildMesh(std::vector<Size> const &origins, std::vector<char> const &refined)
+        {
+            NodeIndex previousIndex;
+            previousIndex.swap(nodeIndex);
+            Vector previousDisplacements;
+            typename Mesh::Elements previousElements;
+            if (mesh)
+            {
+                previousDisplacements = mesh->getDisplacementVector();
+                previousElements = mesh->getElements();
+            }
+
+            std::vector<typename Mesh::Node> nodes;
+            std::vector<Value> guess;
+            typename Mesh::Elements elements(leaves.size());
+            std::vector<std::vector<Size>> sets(baseNodeSets.size());
+            std::vector<std::vector<char>> baseMembers;
+            for (auto const &set : baseNodeSets)
+            {
+                baseMembers.emplace_back(baseNodes.size(), 0);
+                for (Size i = 0; i < set.second.size(); ++i)
+                    baseMembers.back()[set.second(i)] = 1;
+            }
+
+            for (Size e = 0; e < leaves.size(); ++e)
+            {
+                Leaf const &leaf = leaves[e];
+                std::uint32_t size = this->getLeafSize(leaf);
+                std::uint32_t const cornerX[4] = {leaf.x, leaf.x + size, leaf.x + size, leaf.x};
+                std::uint32_t const cornerY[4] = {leaf.y, leaf.y, leaf.y + size, leaf.y + size};
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                {
+                    Size edgeStart, edgeEnd;
+                    std::uint32_t t;
+                    NodeKey key = this->getNodeKey(leaf.root, cornerX[i], cornerY[i], edgeStart, edgeEnd, t);
+                    auto inserted = nodeIndex.emplace(key, nodes.size());
+                    elements(e)(i) = inserted.first->second;
+                    if (!inserted.second)
+                        continue;
+
+                    nodes.push_back(this->createNode(leaf.root, cornerX[i], cornerY[i], edgeStart, edgeEnd, t));
+                    for (Size set = 0; set < baseMembers.size(); ++set)
+                    {
+                        if (edgeStart != edgeEnd && baseMembers[set][edgeStart] && baseMembers[set][edgeEnd])
+                            sets[set].push_back(nodes.size() - 1);
+                    }
+
+                    // Начальное приближение: значение в старом узле или билинейная интерполяция по родителю
+                    for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                        guess.push_back(0);
+                    if (previousElements.size() == 0)
+                        continue;
+                    auto old = previousIndex.find(key);
+                    Value *target = &guess[guess.size() - FiniteElement::nNodeDofs];
+                    if (old != previousIndex.end())
+                    {
+                        for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                            target[d] = previousDisplacements(old->second * FiniteElement::nNodeDofs + d);
+                    }
+                    else if (refined[origins[e]])
+                    {
+                        Leaf const &parent = previousLeaves[origins[e]];
+                        Value s = Value(cornerX[i] - parent.x) / this->getLeafSize(parent);
+                        Value r = Value(cornerY[i] - parent.y) / this->getLeafSize(parent);
+                        Value const weights[4] = {(1 - s) * (1 - r), s * (1 - r), s * r, (1 - s) * r};
+                        for (Size c = 0; c < FiniteElement::nNodes; ++c)
+                        {
+                            for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                                target[d] += weights[c] * previousDisplacements(previousElements(origins[e])(c) * FiniteElement::nNodeDofs + d);
+                        }
+                    }
+                }
+            }
+
+            typename Mesh::Nodes meshNodes(nodes.size());
+            for (Size i = 0; i < nodes.size(); ++i)
+                meshNodes(i) = std::move(nodes[i]);
+            typename Mesh::NodeSets nodeSets;
+            Size s = 0;
+            for (auto const &set : baseNodeSets)
+            {
+                Indices indices(set.second.size() + sets[s].size());
+                Size count = 0;
+                for (Size i = 0; i < set.second.size(); ++i)
+                {
+                    auto found = nodeIndex.find({set.second(i), 0});
+                    if (found != nodeIndex.end())
+                        indices(count++) = found->second;
+                }
+                for (Size node : sets[s])
+                    indices(count++) = node;
+                nodeSets.emplace(set.first, indices.head(count));
+                ++s;
+            }
+
+            mesh.reset(new Mesh(std::move(meshNodes), std::move(elements), std::move(nodeSets)));
+            mesh->setConstraints(this->findHangingNodes());
+            if (valid)
+            {
+                typename Mesh::MaterialIds materialIds(baseMaterialIds.size() != 0 ? leaves.size() : 0);
+                for (Size e = 0; e < materialIds.size(); ++e)
+                    materialIds(e) = baseMaterialIds(leaves[e].root);
+                mesh->setMaterials(materials, std::move(materialIds));
+            }
+            initialGuess = Eigen::Map<Vector>(guess.data(), guess.size());
+            mesh->setDisplacementVector(initialGuess);
+        }
+
+        typename Mesh::Node createNode(Size const &root, std::uint32_t const &x, std::uint32_t const &y,
+                                       Size const &edgeStart, Size const &edgeEnd, std::uint32_t const &t) const
+        {
+            typename Mesh::Node node;
+            if (edgeStart != none && edgeStart == edgeEnd)
+                return baseNodes(edgeStart);
+
+            if (edgeStart != none)
+            {
+                // Точка на ребре исходной сетки: координаты и заданные перемещения интерполируются по концам
+                Value w = Value(t) / rootSize;
+                auto const &a = baseNodes(edgeStart), &b = baseNodes(edgeEnd);
+                node.coords = (1 - w) * a.coords + w * b.coords;
+                std::vector<typename Mesh::Cond> disps;
+                for (Size i = 0; i < a.disps.size(); ++i)
+                {
+                    for (Size j = 0; j < b.disps.size(); ++j)
+                    {
+                        if (a.disps(i).direction == b.disps(j).direction)
+                            disps.push_back({a.disps(i).direction, (1 - w) * a.disps(i).value + w * b.disps(j).value});
+                    }
+                }
+                node.disps = Eigen::Map<typename Mesh::Conds>(disps.data(), disps.size());
+                return node;
+            }
+
+            Value s = Value(x) / rootSize, r = Value(y) / rootSize;
+            auto const &corners = baseElements(root);
+            node.coords = (1 - s) * (1 - r) * baseNodes(corners(0)).coords + s * (1 - r) * baseNodes(corners(1)).coords +
+                          s * r * baseNodes(corners(2)).coords + (1 - s) * r * baseNodes(corners(3)).coords;
+            return node;
+        }
+
+        // Середина ребра листа, существующая как узел, принадлежит более мелким соседям и висит.
+        // Связи раскрываются до свободных узлов, если конец ребра сам висит на более крупном элементе
+        typename Mesh::Constraints findHangingNodes() const
+        {
+            auto const &elements = mesh->getElements();
+            std::vector<std::pair<Size, Size>> hangingMasters(mesh->getNumNodes(), std::make_pair(none, none));
+            std::vector<Size> hanging;
+            for (Size e = 0; e < leaves.size(); ++e)
+            {
+                Leaf const &leaf = leaves[e];
+                if (leaf.level == maxLevel)
+                    continue;
+                std::uint32_t size = this->getLeafSize(leaf), half = size / 2;
+                std::uint32_t const midX[4] = {leaf.x + half, leaf.x + size, leaf.x + half, leaf.x};
+                std::uint32_t const midY[4] = {leaf.y, leaf.y + half, leaf.y + size, leaf.y + half};
+                for (Size k = 0; k < 4; ++k)
+                {
+                    Size edgeStart, edgeEnd;
+                    std::uint32_t t;
+                    auto found = nodeIndex.find(this->getNodeKey(leaf.root, midX[k], midY[k], edgeStart, edgeEnd, t));
+                    if (found == nodeIndex.end())
+                        continue;
+                    hangingMasters[found->second] = std::make_pair(elements(e)(k), elements(e)((k + 1) % 4));
+                    hanging.push_back(found->second);
+                }
+            }
+
+            typename Mesh::Constraints constraints(hanging.size());
+            std::vector<std::pair<Size, Value>> terms;
+            for (Size c = 0; c < hanging.size(); ++c)
+            {
+                terms.clear();
+                this->expandHangingNode(terms, hangingMasters, hanging[c], 1);
+                std::sort(terms.begin(), terms.end());
+                Size count = 0;
+                for (Size i = 0; i < terms.size(); ++i)
+                {
+                    if (count != 0 && terms[count - 1].first == terms[i].first)
+                        terms[count - 1].second += terms[i].second;
+                    else
+                        terms[count++] = terms[i];
+                }
+                constraints(c).node = hanging[c];
+                constraints(c).masters.resize(count);
+                constraints(c).weights.resize(count);
+                for (Size i = 0; i < count; ++i)
+                {
+                    constraints(c).masters(i) = terms[i].first;
+                    constraints(c).weights(i) = terms[i].second;
+                }
+            }
+            return constraints;
+        }
+
+        void expandHangingNode(std::vector<std::pair<Size, Value>> &terms,
+                               std::vector<std::pair<Size, Size>> const &hangingMasters,
+                               Size const &node, Value const &weight) const
+        {
+            auto const &masters = hangingMasters[node];
+            if (masters.first == none)
+            {
+                terms.emplace_back(node, weight);
+                return;
+            }
+            this->expandHangingNode(terms, hangingMasters, masters.first, weight / 2);
+            this->expandHangingNode(terms, hangingMasters, masters.second, weight / 2);
+        }
+
+        typename Mesh::Nodes baseNodes;
+        typename Mesh::Elements baseElements;
+        typename Mesh::NodeSets baseNodeSets;
+        typename Mesh::Materials materials;
+        typename Mesh::MaterialIds baseMaterialIds;
+        bool valid = false;
+        unsigned nThreads;
+        std::vector<Size> rootNeighbours; // корень * 4 + ребро -> соседний корень * 4 + его ребро
+        std::vector<Leaf> leaves, previousLeaves;
+        NodeIndex nodeIndex;
+        MatrixCache elementMatrices;
+        std::vector<char> validMatrices;
+        Vector initialGuess;
+        std::unique_ptr<Mesh> mesh;
+        Size nReusedMatrices = 0;
+        Size nRefinements = 0;
+    };
+
+    template <typename T>
+    unsigned const AdaptiveMesh<T>::maxLevel;
+
+    template <typename T>
+    typename AdaptiveMesh<T>::Size const AdaptiveMesh<T>::none;
+
+    template <typename T>
+    std::uint32_t const AdaptiveMesh<T>::rootSize;
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "post_processing.hpp"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace fem
+{
+    // Оценка погрешности Зенкевича-Жу. Напряжения восстанавливаются в узлах методом
+    // сверхсходящегося восстановления по патчам (SPR): для каждого узла по точкам Гаусса
+    // смежных элементов линейный полином a0 + a1 x + a2 y подбирается методом наименьших
+    // квадратов (система 3x3). Погрешность элемента - энергетическая норма разности
+    // восстановленного и конечно-элементного напряжений.
+    template <typename T>
+    class ErrorEstimator
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using Indices = typename Mesh::Indices;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using PostProcessor = fem::PostProcessor<T>;
+        using Values = typename PostProcessor::Values;
+
+        ErrorEstimator(Mesh const &mesh, unsigned nThreads = 0) : mesh(mesh),
+                                                                  nThreads(nThreads != 0 ? nThreads : hardwareThreads())
+        {
+        }
+
+        // postProcessor должен содержать напряжения в точках Гаусса для того же решения.
+        // Один материал на всю сетку
+        bool calculateErrors(PostProcessor const &postProcessor,
+                             Value const &elasticityModulus,
+                             Value const &poissonRatio)
+        {
+            if (!mesh.checkSingleMaterial("error estimation"))
+                return false;
+            typename Mesh::Material const material{elasticityModulus, poissonRatio, 0};
+            this->estimateErrors(postProcessor, [&](Size const &) -> typename Mesh::Material const &
+                                 { return material; });
+            return true;
+        }
+
+        // Материалы элементов из таблицы сетки
+        bool calculateErrors(PostProcessor const &postProcessor)
+        {
+            if (!mesh.checkMaterialTable())
+                return false;
+            this->estimateErrors(postProcessor, [&](Size const &e) -> typename Mesh::Material const &
+                                 { return mesh.getElementMaterial(e); });
+            return true;
+        }
+
+        const Values &getRecoveredStresses() const
+        {
+            return recoveredStresses;
+        }
+
+        // Оценка погрешности в энергетической норме по элементам
+        const Vector &getElementErrors() const
+        {
+            return elementErrors;
+        }
+
+        Value getGlobalError() const
+        {
+            return globalError;
+        }
+
+        Value getEnergyNorm() const
+        {
+            return energyNorm;
+        }
+
+        Value getRelativeError() const
+        {
+            return relativeError;
+        }
+
+        // Критерий равномерного распределения погрешности: отмечаются элементы, у которых
+        // погрешность больше допустимой доли targetRelativeError от полной энергетической нормы
+        void markElements(Indices &marked, Value const &targetRelativeError) const
+        {
+            Size nElements = elementErrors.size();
+            Value total = std::sqrt(energyNorm * energyNorm + globalError * globalError);
+            Value permissible = targetRelativeError * total / std::sqrt(Value(std::max<Size>(nElements, 1)));
+            std::vector<Size> list;
+            for (Size e = 0; e < nElements; ++e)
+            {
+                if (elementErrors(e) > permissible)
+                    list.push_back(e);
+            }
+            marked = Eigen::Map<Indices>(list.data(), list.size());
+        }
+
+    private:
+        // materialOf(e) - материал элемента e
+        template <typename MaterialOf>
+        void estimateErrors(PostProcessor const &postProcessor, MaterialOf const &materialOf)
+        {
+            Size nElements = mesh.getNumElements(), nNodes = mesh.getNumNodes();
+            Size const nGauss = FiniteElement::nGaussPoints;
+            Values const &gaussStresses = postProcessor.getGaussStresses();
+            Indices const &nodeOffsets = postProcessor.getNodeOffsets();
+            Indices const &nodeElements = postProcessor.getNodeElements();
+
+            Eigen::Matrix<Value, Eigen::Dynamic, 2, Eigen::RowMajor> gaussCoords(nElements * nGauss, 2);
+            Vector elementSizes(nElements);
+            parallelFor(0, nElements, [&](std::size_t e)
+                        {
+                            FiniteElement fe;
+                            typename FiniteElement::Nodes feNodes;
+                            typename FiniteElement::Coordinates lsX, lsY, od;
+                            mesh.getElementNodes(feNodes, e);
+                            fe.findLimits(lsX, lsY, feNodes);
+                            fe.calculateOverallDimensions(od, lsX, lsY);
+                            elementSizes(e) = std::max(od(0), od(1));
+                            Value xi, eta, weight;
+                            for (Size k = 0; k < nGauss; ++k)
+                            {
+                                fe.calculateGaussPoint(xi, eta, weight, k, od(0), od(1));
+                                gaussCoords(e * nGauss + k, 0) = (lsX(0) + lsX(1)) / 2 + xi;
+                                gaussCoords(e * nGauss + k, 1) = (lsY(0) + lsY(1)) / 2 + eta;
+                            } },
+                        nThreads, 256);
+
+            recoveredStresses.resize(nNodes, FiniteElement::nVoigt);
+            parallelFor(0, nNodes, [&](std::size_t n)
+                        {
+                            auto const &center = mesh.getNodes()(n).coords;
+                            Size first = nodeOffsets(n), last = nodeOffsets(n + 1);
+                            Value h = 0;
+                            for (Size k = first; k < last; ++k)
+                                h = std::max(h, elementSizes(nodeElements(k)));
+
+                            Eigen::Matrix<Value, 3, 3> A = Eigen::Matrix<Value, 3, 3>::Zero();
+                            Eigen::Matrix<Value, 3, FiniteElement::nVoigt> b = Eigen::Matrix<Value, 3, FiniteElement::nVoigt>::Zero();
+                            Eigen::Matrix<Value, 1, FiniteElement::nVoigt> mean = Eigen::Matrix<Value, 1, FiniteElement::nVoigt>::Zero();
+                            for (Size k = first; k < last; ++k)
+                            {
+                                Size e = nodeElements(k);
+                                for (Size g = 0; g < nGauss; ++g)
+                                {
+                                    Eigen::Matrix<Value, 3, 1> p(1, (gaussCoords(e * nGauss + g, 0) - center(0)) / h,
+                                                                 (gaussCoords(e * nGauss + g, 1) - center(1)) / h);
+                                    A += p * p.transpose();
+                                    b += p * gaussStresses.row(e * nGauss + g);
+                                    mean += gaussStresses.row(e * nGauss + g);
+                                }
+                            }
+                            // Узел в центре системы координат: восстановленное значение - свободный член
+                            Eigen::LDLT<Eigen::Matrix<Value, 3, 3>> ldlt(A);
+                            if (last > first && ldlt.info() == Eigen::Success && ldlt.isPositive() &&
+                                ldlt.vectorD().minCoeff() > A.trace() * Value(1e-6))
+                                recoveredStresses.row(n) = ldlt.solve(b).row(0);
+                            else
+                                recoveredStresses.row(n) = mean / Value(std::max<Size>(1, (last - first) * nGauss)); },
+                        nThreads, 256);
+
+            elementErrors.resize(nElements);
+            Vector elementEnergies(nElements);
+            auto const &elements = mesh.getElements();
+            parallelFor(0, nElements, [&](std::size_t e)
+                        {
+                            FiniteElement fe;
+                            typename FiniteElement::Nodes feNodes;
+                            typename FiniteElement::Coordinates lsX, lsY, od;
+                            typename FiniteElement::ShapeFunctions sf;
+                            mesh.getElementNodes(feNodes, e);
+                            fe.findLimits(lsX, lsY, feNodes);
+                            fe.calculateOverallDimensions(od, lsX, lsY);
+                            auto const &material = materialOf(e);
+                            Eigen::Matrix<Value, 3, 3> compliance;
+                            compliance << 1, -material.poissonRatio, 0,
+                                -material.poissonRatio, 1, 0,
+                                0, 0, 2 * (1 + material.poissonRatio);
+                            compliance /= material.elasticityModulus;
+                            Value xi, eta, weight, error = 0, energy = 0;
+                            for (Size g = 0; g < nGauss; ++g)
+                            {
+                                fe.calculateGaussPoint(xi, eta, weight, g, od(0), od(1));
+                                fe.calculateShapeFunctions(sf, xi, eta, od(0), od(1));
+                                Eigen::Matrix<Value, 1, FiniteElement::nVoigt> stress = gaussStresses.row(e * nGauss + g);
+                                Eigen::Matrix<Value, 1, FiniteElement::nVoigt> difference = -stress;
+                                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                                    difference += sf(i) * recoveredStresses.row(elements(e)(i));
+                                error += (difference * compliance * difference.transpose()).value() * weight;
+                                energy += (stress * compliance * stress.transpose()).value() * weight;
+                            }
+                            elementErrors(e) = std::sqrt(std::max<Value>(error, 0));
+                            elementEnergies(e) = energy; },
+                        nThreads, 256);
+
+            globalError = elementErrors.norm();
+            energyNorm = std::sqrt(elementEnergies.sum());
+            Value total = std::sqrt(energyNorm * energyNorm + globalError * globalError);
+            relativeError = total > 0 ? globalError / total : 0;
+        }
+
+        Mesh const &mesh;
+        unsigned nThreads;
+        Values recoveredStresses;
+        Vector elementErrors;
+        Value globalError = 0, energyNorm = 0, relativeError = 0;
+    };
+}
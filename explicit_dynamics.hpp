@@ -0,0 +1,416 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "transient_analysis.hpp"
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace fem
+{
+    // Явное интегрирование методом центральных разностей с сосредоточенной массой.
+    // Глобальная матрица жёсткости не строится: внутренние силы собираются поэлементно.
+    // Элементы с одним материалом и одинаковыми размерами (группы Mesh::calculateElementGroups)
+    // делят одну матрицу жёсткости типа, поэтому память O(n). Элементы раскрашены так, что
+    // элементы одного цвета не имеют общих узлов; цвет обрабатывается потоками без блокировок,
+    // пачками по batchSize элементов одного типа - произведение 8x8 на 8 x batchSize
+    // векторизуется. Потоки создаются один раз на вызов run() и синхронизируются барьерами,
+    // на шаге нет выделений памяти.
+    // Узловые силы и заданные перемещения умножаются на кривые нагрузки, как в TransientAnalysis
+    template <typename T>
+    class ExplicitDynamics
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using Indices = typename Mesh::Indices;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using LoadCurve = fem::LoadCurve<T>;
+
+        static Size const batchSize = 8;
+
+        // Вектор сил сетки должен быть вычислен (calculateForceVector). Материал один на всю сетку
+        ExplicitDynamics(Mesh const &mesh,
+                         Value const &elasticityModulus,
+                         Value const &poissonRatio,
+                         Value const &density,
+                         unsigned nThreads = 0) : ExplicitDynamics(mesh, nThreads, true)
+        {
+            typename Mesh::Material material = {elasticityModulus, poissonRatio, density};
+            this->classifyElements(&material);
+            this->colorElements();
+        }
+
+        // Материалы элементов из таблицы сетки (setMaterials)
+        ExplicitDynamics(Mesh const &mesh, unsigned nThreads = 0) : ExplicitDynamics(mesh, nThreads, true)
+        {
+            if (mesh.getMaterials().empty())
+            {
+                std::cerr << "Error: material table of the mesh is empty!" << std::endl;
+                return;
+            }
+            this->classifyElements(nullptr);
+            this->colorElements();
+        }
+
+        // Оценка устойчивого шага 2 / omega_max по наибольшей частоте отдельных элементов,
+        // которая ограничивает частоты всей сетки сверху
+        Value getCriticalTimeStep() const
+        {
+            return criticalTimeStep;
+        }
+
+        // Демпфирование, пропорциональное массе: a = (F - f) / m - massDamping * v
+        void setMassDamping(Value const &massDamping)
+        {
+            this->massDamping = massDamping;
+        }
+
+        void setForceCurve(LoadCurve curve)
+        {
+            forceCurve = std::move(curve);
+        }
+
+        void setDisplacementCurve(LoadCurve curve)
+        {
+            displacementCurve = std::move(curve);
+        }
+
+        void initialize(Eigen::Ref<const Vector> const &initialDisplacements,
+                        Eigen::Ref<const Vector> const &initialVelocities)
+        {
+            time = 0;
+            started = false;
+            u = initialDisplacements;
+            v = initialVelocities;
+            Value factor = displacementCurve(0);
+            for (Size dof = 0; dof < fixed.size(); ++dof)
+            {
+                if (fixed[dof])
+                    u(dof) = factor * prescribedValues(dof);
+            }
+            internalForces.setZero();
+            for (Size c = 0; c < colors.size(); ++c)
+                this->addInternalForces(colors[c], 0, colors[c].types.size());
+            this->updateAccelerations(0, u.size(), forceCurve(0));
+        }
+
+        void initialize()
+        {
+            this->initialize(Vector::Zero(u.size()), Vector::Zero(u.size()));
+        }
+
+        // steps шагов dt; onOutput(step, analysis) вызывается после каждого outputInterval-го шага
+        template <typename OnOutput>
+        bool run(Size const &steps, Value const &dt, Size const &outputInterval, OnOutput const &onOutput)
+        {
+            FEM_PROFILE("explicit dynamics");
+            if (!(dt > 0))
+            {
+                std::cerr << "Error: time step must be positive!" << std::endl;
+                return false;
+            }
+            if (typeMatrices.empty() && mesh.getNumElements() != 0)
+            {
+                std::cerr << "Error: element materials are not defined!" << std::endl;
+                return false;
+            }
+            if (dt > criticalTimeStep)
+                std::cerr << "Warning: time step " << dt << " exceeds the critical one " << criticalTimeStep << std::endl;
+
+            Size nDofs = u.size();
+            unsigned nWorkers = unsigned(std::max<Size>(1, std::min<Size>(nThreads, nDofs / 1024 + 1)));
+            Value startTime = time;
+            bool halfFirstStep = !started;
+            Barrier barrier(nWorkers);
+
+            auto worker = [&](unsigned t)
+            {
+                Size dofBegin = nDofs * t / nWorkers, dofEnd = nDofs * (t + 1) / nWorkers;
+                for (Size k = 1; k <= steps; ++k)
+                {
+                    Value timeNext = startTime + k * dt;
+                    Value velocityStep = k == 1 && halfFirstStep ? dt / 2 : dt;
+                    Value factor = displacementCurve(timeNext);
+                    for (Size dof = dofBegin; dof < dofEnd; ++dof)
+                    {
+                        if (fixed[dof])
+                        {
+                            Value target = factor * prescribedValues(dof);
+                            v(dof) = (target - u(dof)) / dt;
+                            u(dof) = target;
+                        }
+                        else
+                        {
+                            v(dof) += velocityStep * a(dof);
+                            u(dof) += dt * v(dof);
+                        }
+                        internalForces(dof) = 0;
+                    }
+                    barrier.wait();
+                    for (Size c = 0; c < colors.size(); ++c)
+                    {
+                        Size nBatches = colors[c].types.size();
+                        if (c + 1 == colors.size() && coloringOverflow)
+                        {
+                            if (t == 0)
+                                this->addInternalForces(colors[c], 0, nBatches);
+                        }
+                        else
+                            this->addInternalForces(colors[c], nBatches * t / nWorkers, nBatches * (t + 1) / nWorkers);
+                        barrier.wait();
+                    }
+                    this->updateAccelerations(dofBegin, dofEnd, forceCurve(timeNext));
+                    if (outputInterval != 0 && (k % outputInterval == 0 || k == steps))
+                    {
+                        barrier.wait();
+                        if (t == 0)
+                        {
+                            time = timeNext;
+                            onOutput(k, static_cast<ExplicitDynamics const &>(*this));
+                        }
+                        barrier.wait();
+                    }
+                }
+            };
+
+            std::vector<std::thread> threads;
+            threads.reserve(nWorkers - 1);
+            for (unsigned t = 1; t < nWorkers; ++t)
+                threads.emplace_back(worker, t);
+            worker(0);
+            for (auto &thread : threads)
+                thread.join();
+
+            time = startTime + steps * dt;
+            started = started || steps != 0;
+            nSteps += steps;
+            return true;
+        }
+
+        Value getTime() const
+        {
+            return time;
+        }
+
+        const Vector &getDisplacements() const
+        {
+            return u;
+        }
+
+        // Скорости на половине шага t - dt / 2
+        const Vector &getVelocities() const
+        {
+            return v;
+        }
+
+        const Vector &getAccelerations() const
+        {
+            return a;
+        }
+
+        Size getNumSteps() const
+        {
+            return nSteps;
+        }
+
+        Size getNumColors() const
+        {
+            return colors.size();
+        }
+
+        Size getNumElementTypes() const
+        {
+            return typeMatrices.size();
+        }
+
+    private:
+        ExplicitDynamics(Mesh const &mesh, unsigned nThreads, bool) : mesh(mesh),
+                                                                     nThreads(nThreads != 0 ? nThreads : hardwareThreads())
+        {
+            if (mesh.getConstraints().size() != 0)
+                std::cerr << "Warning: explicit dynamics ignores hanging-node constraints" << std::endl;
+            Size nDofs = mesh.getNumNodes() * FiniteElement::nNodeDofs;
+            u.setZero(nDofs);
+            v.setZero(nDofs);
+            a.setZero(nDofs);
+            internalForces.setZero(nDofs);
+            inverseMasses.setZero(nDofs);
+            externalForces = mesh.getForceVector();
+
+            fixed.assign(nDofs, 0);
+            prescribedValues.setZero(nDofs);
+            for (auto const &p : mesh.getPrescribedDofs())
+            {
+                fixed[p.first] = 1;
+                prescribedValues(p.first) = p.second;
+            }
+        }
+
+        using StiffnessMatrix = typename FiniteElement::StiffnessMatrix;
+        using Batch = Eigen::Matrix<Value, FiniteElement::nElemDofs, batchSize>;
+
+        struct Color
+        {
+            std::vector<Size> nodes;  // узлы элементов цвета подряд, по nNodes на элемент
+            std::vector<Size> starts; // начала пачек в элементах и общее число элементов в конце
+            std::vector<Size> types;  // тип элементов пачки
+        };
+
+        void updateAccelerations(Size const &dofBegin, Size const &dofEnd, Value const &forceFactor)
+        {
+            for (Size dof = dofBegin; dof < dofEnd; ++dof)
+            {
+                a(dof) = fixed[dof] ? Value(0)
+                                    : (forceFactor * externalForces(dof) - internalForces(dof)) * inverseMasses(dof) - massDamping * v(dof);
+            }
+        }
+
+        // Внутренние силы пачек [first, last) одного цвета
+        void addInternalForces(Color const &color, Size const &first, Size const &last)
+        {
+            Batch displacements, forces;
+            for (Size b = first; b < last; ++b)
+            {
+                Size begin = color.starts[b], count = color.starts[b + 1] - begin;
+                Size const *nodes = &color.nodes[begin * FiniteElement::nNodes];
+                if (count < batchSize)
+                    displacements.setZero();
+                for (Size j = 0; j < count; ++j)
+                {
+                    for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                    {
+                        for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                            displacements(i * FiniteElement::nNodeDofs + d, j) = u(nodes[j * FiniteElement::nNodes + i] * FiniteElement::nNodeDofs + d);
+                    }
+                }
+                forces.noalias() = typeMatrices[color.types[b]].lazyProduct(displacements);
+                for (Size j = 0; j < count; ++j)
+                {
+                    for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                    {
+                        for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                            internalForces(nodes[j * FiniteElement::nNodes + i] * FiniteElement::nNodeDofs + d) += forces(i * FiniteElement::nNodeDofs + d, j);
+                    }
+                }
+            }
+        }
+
+        // Типы элементов - группы сетки с одним материалом и размерами a x b; material задаёт
+        // материал всех элементов, nullptr - материалы из таблицы сетки
+        void classifyElements(typename Mesh::Material const *material)
+        {
+            Indices groups, representatives;
+            mesh.calculateElementGroups(groups, representatives);
+            FiniteElement fe;
+            typename FiniteElement::Nodes feNodes;
+            typename FiniteElement::MassMatrix mm;
+            std::vector<typename FiniteElement::Displacements, Eigen::aligned_allocator<typename FiniteElement::Displacements>> typeMasses;
+            typeMatrices.clear();
+            criticalTimeStep = std::numeric_limits<Value>::infinity();
+            for (Size g = 0; g < representatives.size(); ++g)
+            {
+                Size e = representatives(g);
+                auto const &m = material != nullptr ? *material : mesh.getMaterials()[mesh.getMaterialId(e)];
+                StiffnessMatrix sm;
+                mesh.getElementNodes(feNodes, e);
+                fe.calculateStiffnessMatrix(sm, feNodes, m.elasticityModulus, m.poissonRatio);
+                typeMatrices.push_back(sm);
+                fe.calculateLumpedMassMatrix(mm, feNodes, m.density);
+                typeMasses.push_back(mm.diagonal());
+
+                // omega_max^2 элемента: наибольшее собственное число m^-1/2 K m^-1/2
+                Eigen::Matrix<Value, FiniteElement::nElemDofs, 1> scale = mm.diagonal().cwiseSqrt().cwiseInverse();
+                StiffnessMatrix scaled = scale.asDiagonal() * sm * scale.asDiagonal();
+                Value omegaSquared = Eigen::SelfAdjointEigenSolver<StiffnessMatrix>(scaled, Eigen::EigenvaluesOnly).eigenvalues().maxCoeff();
+                if (omegaSquared > 0)
+                    criticalTimeStep = std::min(criticalTimeStep, 2 / std::sqrt(omegaSquared));
+            }
+
+            auto const &elements = mesh.getElements();
+            elementTypes.assign(groups.data(), groups.data() + groups.size());
+            Vector masses = Vector::Zero(u.size());
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                for (Size i = 0; i < FiniteElement::nElemDofs; ++i)
+                    masses(elements(e)(i / FiniteElement::nNodeDofs) * FiniteElement::nNodeDofs + i % FiniteElement::nNodeDofs) += typeMasses[groups(e)](i);
+            }
+            for (Size dof = 0; dof < masses.size(); ++dof)
+                inverseMasses(dof) = masses(dof) > 0 ? 1 / masses(dof) : 0;
+        }
+
+        // Жадная раскраска: элементу достаётся наименьший цвет, не занятый его узлами
+        void colorElements()
+        {
+            auto const &elements = mesh.getElements();
+            Size nElements = mesh.getNumElements();
+            std::vector<std::uint64_t> nodeColors(mesh.getNumNodes(), 0);
+            std::vector<Size> elementColors(nElements);
+            Size nColors = 0;
+            for (Size e = 0; e < nElements; ++e)
+            {
+                std::uint64_t used = 0;
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                    used |= nodeColors[elements(e)(i)];
+                Size color = 0;
+                while (color < 63 && (used >> color & 1))
+                    ++color;
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                    nodeColors[elements(e)(i)] |= std::uint64_t(1) << color;
+                elementColors[e] = color;
+                nColors = std::max(nColors, color + 1);
+            }
+            // Последний цвет - запасной: его элементы могут иметь общие узлы, он обрабатывается одним потоком
+            std::vector<std::vector<Size>> lists(nColors);
+            for (Size e = 0; e < nElements; ++e)
+                lists[elementColors[e]].push_back(e);
+
+            // Пачки: подряд идущие элементы цвета одного типа, не больше batchSize
+            colors.assign(nColors, Color());
+            for (Size c = 0; c < nColors; ++c)
+            {
+                auto &list = lists[c];
+                std::stable_sort(list.begin(), list.end(), [&](Size const &l, Size const &r)
+                                 { return elementTypes[l] < elementTypes[r]; });
+                Color &color = colors[c];
+                for (Size k = 0; k < list.size(); ++k)
+                {
+                    if (k == 0 || elementTypes[list[k]] != color.types.back() || k - color.starts.back() == batchSize)
+                    {
+                        color.starts.push_back(k);
+                        color.types.push_back(elementTypes[list[k]]);
+                    }
+                    for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                        color.nodes.push_back(elements(list[k])(i));
+                }
+                color.starts.push_back(list.size());
+            }
+            coloringOverflow = nColors == 64;
+        }
+
+        Mesh const &mesh;
+        unsigned nThreads;
+        std::vector<Size> elementTypes;
+        std::vector<StiffnessMatrix, Eigen::aligned_allocator<StiffnessMatrix>> typeMatrices;
+        std::vector<Color> colors;
+        std::vector<char> fixed;
+        Vector prescribedValues, inverseMasses, externalForces;
+        Vector u, v, a, internalForces;
+        Value criticalTimeStep = 0, massDamping = 0, time = 0;
+        bool started = false, coloringOverflow = false;
+        Size nSteps = 0;
+        LoadCurve forceCurve, displacementCurve;
+    };
+
+    template <typename T>
+    typename ExplicitDynamics<T>::Size const ExplicitDynamics<T>::batchSize;
+}
@@ -0,0 +1,486 @@
+// Пакетный расчёт: задания из текстового файла выполняются одновременно на пуле потоков с
+// перехватом задач (WorkStealingPool), число одновременно решаемых заданий ограничено оценками
+// памяти решений (Mesh::estimateSolveFootprint).
+//
+//   fem_batch jobs.txt [--threads N] [--memory MB]
+//
+// Файл заданий - строки "ключ значения", от # до конца строки - комментарий. Задание
+// начинается со строки job, остальные ключи относятся к последнему заданию:
+//
+//   job cantilever                  имя задания
+//   mesh grid 0 0 10 1 100 10       прямоугольник x0 y0 x1 y1 из nx x ny элементов;
+//                                   или mesh gmsh file.msh, mesh file file.fem
+//   material 200000 0.3 7.85e-9     E, nu и плотность; без неё - материалы файла сетки
+//   fix box 0 0 0 1 xy              закрепление узлов в прямоугольнике x0 y0 x1 y1 по x, y или xy,
+//   fix set right y -0.1            необязательное значение - заданное перемещение (0);
+//                                   выборки: box x0 y0 x1 y1, set имя (физическая группа), node номер
+//   load box 10 0 10 1 y -100       сила в каждом узле выборки
+//   solver sparse_direct            dense, sparse_direct (по умолчанию), mixed_precision, cg
+//   vtk cantilever.vtk              результаты: файл ParaView и/или файл сетки с перемещениями
+//   output cantilever.fem
+//
+// Закрепления и нагрузки задания заменяют заданные в файле сетки. Задания с одинаковой сеткой
+// читают её один раз; задания с одинаковыми сеткой и материалом собирают матрицу жёсткости один
+// раз и решают на её копиях. Бюджет памяти по умолчанию - 3/4 физической памяти; решатель
+// задания, которому он тесен, заменяется более экономным
+#include "mesh.hpp"
+#include "mesh_file.hpp"
+#include "mesh_source.hpp"
+#include "parallel.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace
+{
+    using Value = double;
+    using Mesh = fem::Mesh<Value>;
+    using Size = Mesh::Size;
+    using FiniteElement = Mesh::FiniteElement;
+    using Clock = std::chrono::steady_clock;
+
+    struct Selection
+    {
+        std::string kind; // box, set или node
+        Value x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        std::string set;
+        Size node = 0;
+    };
+
+    struct Condition
+    {
+        Selection selection;
+        std::vector<Size> directions;
+        Value value = 0;
+    };
+
+    struct Job
+    {
+        std::string name;
+        Size line = 0;
+        std::string mesh;     // описание сетки, ключ общей сетки
+        std::string material; // пусто - материалы файла сетки
+        Mesh::Material properties{0, 0, 0};
+        std::vector<Condition> fixes, loads;
+        fem::LinearSolver solver = fem::LinearSolver::SparseDirect;
+        std::string vtk, output;
+    };
+
+    struct Result
+    {
+        bool done = false;
+        fem::LinearSolver solver = fem::LinearSolver::SparseDirect;
+        Size dofs = 0;
+        double time = 0;
+        Value maxDisplacement = 0;
+    };
+
+    // Физическая память, байт; 0, если неизвестна
+    Size physicalMemory()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        long pages = sysconf(_SC_PHYS_PAGES), pageSize = sysconf(_SC_PAGE_SIZE);
+        return pages > 0 && pageSize > 0 ? Size(pages) * Size(pageSize) : 0;
+#else
+        return 0;
+#endif
+    }
+
+    bool parseSolver(std::string const &name, fem::LinearSolver &solver)
+    {
+        static std::map<std::string, fem::LinearSolver> const solvers = {
+            {"dense", fem::LinearSolver::Dense},
+            {"sparse_direct", fem::LinearSolver::SparseDirect},
+            {"mixed_precision", fem::LinearSolver::MixedPrecision},
+            {"cg", fem::LinearSolver::ConjugateGradients}};
+        auto found = solvers.find(name);
+        if (found == solvers.end())
+            return false;
+        solver = found->second;
+        return true;
+    }
+
+    bool parseCondition(std::istringstream &tokens, Condition &condition, bool const &valueRequired)
+    {
+        Selection &selection = condition.selection;
+        if (!(tokens >> selection.kind))
+            return false;
+        if (selection.kind == "box")
+        {
+            if (!(tokens >> selection.x0 >> selection.y0 >> selection.x1 >> selection.y1))
+                return false;
+        }
+        else if (selection.kind == "set")
+        {
+            if (!(tokens >> selection.set))
+                return false;
+        }
+        else if (selection.kind == "node")
+        {
+            if (!(tokens >> selection.node))
+                return false;
+        }
+        else
+            return false;
+
+        std::string directions;
+        if (!(tokens >> directions) || directions.empty())
+            return false;
+        for (char direction : directions)
+        {
+            if (direction != 'x' && direction != 'y')
+                return false;
+            condition.directions.push_back(direction == 'x' ? 0 : 1);
+        }
+        if (!(tokens >> condition.value))
+        {
+            if (valueRequired)
+                return false;
+            condition.value = 0;
+        }
+        return true;
+    }
+
+    bool readJobs(std::string const &filename, std::vector<Job> &jobs)
+    {
+        std::ifstream file(filename);
+        if (!file.is_open())
+        {
+            std::cerr << "Error: Could not open " << filename << " for reading!" << std::endl;
+            return false;
+        }
+        std::string text;
+        for (Size line = 1; std::getline(file, text); ++line)
+        {
+            text = text.substr(0, text.find('#'));
+            std::istringstream tokens(text);
+            std::string key;
+            if (!(tokens >> key))
+                continue;
+            if (key != "job" && jobs.empty())
+            {
+                std::cerr << "Error: " << filename << ":" << line << ": '" << key << "' before the first job!" << std::endl;
+                return false;
+            }
+
+            bool valid = true;
+            std::string rest;
+            if (key == "job")
+            {
+                jobs.emplace_back();
+                jobs.back().line = line;
+                valid = bool(tokens >> jobs.back().name);
+            }
+            else if (key == "mesh")
+            {
+                std::string kind, word;
+                valid = bool(tokens >> kind) && (kind == "grid" || kind == "gmsh" || kind == "file");
+                jobs.back().mesh = kind;
+                while (tokens >> word)
+                    jobs.back().mesh += " " + word;
+            }
+            else if (key == "material")
+            {
+                Mesh::Material &properties = jobs.back().properties;
+                valid = bool(tokens >> properties.elasticityModulus >> properties.poissonRatio);
+                if (!(tokens >> properties.density))
+                    properties.density = 0;
+                std::ostringstream material;
+                material.precision(17);
+                material << properties.elasticityModulus << " " << properties.poissonRatio << " " << properties.density;
+                jobs.back().material = material.str();
+            }
+            else if (key == "fix" || key == "load")
+            {
+                Condition condition;
+                valid = parseCondition(tokens, condition, key == "load");
+                (key == "fix" ? jobs.back().fixes : jobs.back().loads).push_back(condition);
+            }
+            else if (key == "solver")
+            {
+                std::string name;
+                valid = bool(tokens >> name) && parseSolver(name, jobs.back().solver);
+            }
+            else if (key == "vtk")
+                valid = bool(tokens >> jobs.back().vtk);
+            else if (key == "output")
+                valid = bool(tokens >> jobs.back().output);
+            else
+                valid = false;
+
+            if (!valid || tokens >> rest)
+            {
+                std::cerr << "Error: " << filename << ":" << line << ": invalid '" << key << "' line!" << std::endl;
+                return false;
+            }
+        }
+        for (auto const &job : jobs)
+        {
+            if (job.mesh.empty())
+            {
+                std::cerr << "Error: " << filename << ":" << job.line << ": job " << job.name << " has no mesh!" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Узлы выборки; tolerance - допуск попадания в прямоугольник
+    bool selectNodes(Mesh const &mesh, Selection const &selection, Value const &tolerance, std::vector<Size> &selected)
+    {
+        selected.clear();
+        auto const &nodes = mesh.getNodes();
+        if (selection.kind == "node")
+        {
+            if (selection.node >= mesh.getNumNodes())
+            {
+                std::cerr << "Error: node " << selection.node << " does not exist!" << std::endl;
+                return false;
+            }
+            selected.push_back(selection.node);
+        }
+        else if (selection.kind == "set")
+        {
+            auto found = mesh.getNodeSets().find(selection.set);
+            if (found == mesh.getNodeSets().end())
+            {
+                std::cerr << "Error: node set " << selection.set << " does not exist!" << std::endl;
+                return false;
+            }
+            selected.assign(found->second.data(), found->second.data() + found->second.size());
+        }
+        else
+        {
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                Value x = nodes(i).coords(0), y = nodes(i).coords(1);
+                if (x >= selection.x0 - tolerance && x <= selection.x1 + tolerance &&
+                    y >= selection.y0 - tolerance && y <= selection.y1 + tolerance)
+                    selected.push_back(i);
+            }
+        }
+        if (selected.empty())
+            std::cerr << "Warning: selection " << selection.kind << " contains no nodes" << std::endl;
+        return true;
+    }
+
+    // Заменяет закрепления и нагрузки сетки заданными в задании, если они есть
+    bool applyConditions(Mesh &mesh, Job const &job)
+    {
+        auto const &nodes = mesh.getNodes();
+        Value extent = 0;
+        for (Size i = 0; i < nodes.size(); ++i)
+            extent = std::max(extent, nodes(i).coords.cwiseAbs().maxCoeff());
+        Value tolerance = 1e-6 * std::max<Value>(extent, 1);
+
+        std::vector<Size> selected;
+        for (int kind = 0; kind < 2; ++kind)
+        {
+            auto const &conditions = kind == 0 ? job.fixes : job.loads;
+            if (conditions.empty())
+                continue;
+            // Значение по узлу и направлению; повторные закрепления заменяют, нагрузки складываются
+            std::vector<std::map<Size, Value>> values(mesh.getNumNodes());
+            for (auto const &condition : conditions)
+            {
+                if (!selectNodes(mesh, condition.selection, tolerance, selected))
+                    return false;
+                for (Size node : selected)
+                {
+                    for (Size direction : condition.directions)
+                    {
+                        if (kind == 0)
+                            values[node][direction] = condition.value;
+                        else
+                            values[node][direction] += condition.value;
+                    }
+                }
+            }
+            for (Size i = 0; i < mesh.getNumNodes(); ++i)
+            {
+                Mesh::Conds conds(values[i].size());
+                Size j = 0;
+                for (auto const &value : values[i])
+                    conds(j++) = {value.first, value.second};
+                if (kind == 0)
+                    mesh.setDisps(i, std::move(conds));
+                else
+                    mesh.setForces(i, std::move(conds));
+            }
+        }
+        return true;
+    }
+
+    class BatchRunner
+    {
+    public:
+        BatchRunner(std::vector<Job> const &jobs, unsigned nThreads, Size memoryBudget) : jobs(jobs),
+                                                                                           results(jobs.size()),
+                                                                                           memoryBudget(memoryBudget),
+                                                                                           pool(nThreads, memoryBudget)
+        {
+        }
+
+        // Сетки читаются задачами по одной на сетку, они ставят задачи сборки по одной на материал,
+        // а те - задачи решения заданий с оценкой их памяти
+        void run()
+        {
+            std::map<std::string, std::map<std::string, std::vector<Size>>> groups;
+            for (Size j = 0; j < jobs.size(); ++j)
+                groups[jobs[j].mesh][jobs[j].material].push_back(j);
+            for (auto const &meshGroup : groups)
+            {
+                auto materialGroups = meshGroup.second;
+                pool.submit([this, materialGroups]()
+                            { this->prepareMesh(materialGroups); });
+            }
+            pool.wait();
+        }
+
+        std::vector<Result> const &getResults() const
+        {
+            return results;
+        }
+
+        fem::WorkStealingPool const &getPool() const
+        {
+            return pool;
+        }
+
+    private:
+        using MaterialGroups = std::map<std::string, std::vector<Size>>;
+
+        void prepareMesh(MaterialGroups const &materialGroups)
+        {
+            std::unique_ptr<Mesh> loaded;
+            if (!fem::loadMesh(jobs[materialGroups.begin()->second.front()].mesh, loaded))
+                return;
+            std::shared_ptr<Mesh const> mesh(std::move(loaded));
+            Size assembly = mesh->getMemoryUsage().total() + mesh->estimateSolveFootprint(fem::LinearSolver::ConjugateGradients).assembly;
+            for (auto const &materialGroup : materialGroups)
+            {
+                std::vector<Size> group = materialGroup.second;
+                pool.submit([this, mesh, group]()
+                            { this->assemble(*mesh, group); },
+                            assembly);
+            }
+        }
+
+        void assemble(Mesh const &mesh, std::vector<Size> const &group)
+        {
+            std::shared_ptr<Mesh> assembled = std::make_shared<Mesh>(mesh);
+            Job const &first = jobs[group.front()];
+            if (!first.material.empty() && !assembled->setMaterials({first.properties}))
+                return;
+            if (!assembled->calculateSparseStiffnessMatrix())
+                return;
+            assembled->setMemoryBudget(memoryBudget);
+            Size inUse = assembled->getMemoryUsage().total();
+            for (Size j : group)
+            {
+                // Решатель выбирается до постановки, чтобы оценка памяти задачи была оценкой выбранного
+                fem::LinearSolver solver = jobs[j].solver;
+                if (!assembled->selectSolver(solver))
+                    continue;
+                Size bytes = inUse + assembled->estimateSolveFootprint(solver).total();
+                std::shared_ptr<Mesh const> prototype = assembled;
+                pool.submit([this, prototype, j, solver]()
+                            { this->solve(*prototype, j, solver); },
+                            bytes);
+            }
+        }
+
+        void solve(Mesh const &prototype, Size const &j, fem::LinearSolver const &solver)
+        {
+            Clock::time_point start = Clock::now();
+            Job const &job = jobs[j];
+            Mesh mesh = prototype;
+            if (!applyConditions(mesh, job))
+                return;
+            mesh.calculateForceVector();
+            if (!mesh.calculateDisplacementVector(solver))
+                return;
+            if (!job.vtk.empty())
+                mesh.writeParaViewVtk(job.vtk);
+            if (!job.output.empty() && !fem::MeshFile<Value>::write(job.output, mesh))
+                return;
+
+            Result &result = results[j];
+            result.solver = solver;
+            result.dofs = mesh.getNumNodes() * FiniteElement::nNodeDofs;
+            result.maxDisplacement = mesh.getDisplacementVector().cwiseAbs().maxCoeff();
+            result.time = std::chrono::duration<double>(Clock::now() - start).count();
+            result.done = true;
+        }
+
+        std::vector<Job> const &jobs;
+        std::vector<Result> results;
+        Size memoryBudget;
+        fem::WorkStealingPool pool;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    std::string jobsFile;
+    unsigned nThreads = 0;
+    Size memoryBudget = physicalMemory() / 4 * 3;
+    for (int i = 1; i < argc; ++i)
+    {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--threads") == 0 && hasValue)
+            nThreads = unsigned(std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--memory") == 0 && hasValue)
+            memoryBudget = Size(std::strtoull(argv[++i], nullptr, 10)) << 20;
+        else if (argv[i][0] != '-' && jobsFile.empty())
+            jobsFile = argv[i];
+        else
+        {
+            std::cerr << "Usage: fem_batch jobs.txt [--threads N] [--memory MB]" << std::endl;
+            return 1;
+        }
+    }
+    if (jobsFile.empty())
+    {
+        std::cerr << "Usage: fem_batch jobs.txt [--threads N] [--memory MB]" << std::endl;
+        return 1;
+    }
+
+    std::vector<Job> jobs;
+    if (!readJobs(jobsFile, jobs))
+        return 1;
+
+    Clock::time_point start = Clock::now();
+    BatchRunner runner(jobs, nThreads, memoryBudget);
+    runner.run();
+    double time = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Size failed = 0;
+    for (Size j = 0; j < jobs.size(); ++j)
+    {
+        Result const &result = runner.getResults()[j];
+        if (!result.done)
+        {
+            std::cout << jobs[j].name << ": failed" << std::endl;
+            ++failed;
+            continue;
+        }
+        std::cout << jobs[j].name << ": " << result.dofs << " DOFs, " << fem::getLinearSolverName(result.solver)
+                  << " solve, " << result.time << " s, max displacement " << result.maxDisplacement << std::endl;
+    }
+    std::cout << jobs.size() - failed << " of " << jobs.size() << " jobs done in " << time << " s on "
+              << runner.getPool().getNumThreads() << " threads, " << runner.getPool().getNumSteals() << " tasks stolen, peak estimated memory "
+              << (runner.getPool().getPeakBytes() >> 20) << " MB" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,405 @@
+// Замеры всех этапов расчёта на регулярных сетках N x N (N = 2, 4, ..., 4096):
+// построение сетки, матрицы элементов, варианты сборки, решатели и запись файлов.
+// Результат - JSON со временем, DOF/с, объёмом данных этапа и пиковым RSS процесса.
+//
+//   fem_bench [--min-size N] [--max-size N] [--tries N] [--output file.json] [--scratch dir]
+//
+// По умолчанию N до 256; полный диапазон - --max-size 4096. Этапы, которым не хватит
+// памяти или времени на больших сетках (плотные матрицы, прямой и итерационные решатели),
+// ограничены собственными предельными N и на больших сетках пропускаются.
+// Сравнимые числа - только у сборки с -DCMAKE_BUILD_TYPE=Release (поле "assertions" в JSON)
+#include "matrix_io.hpp"
+#include "mesh.hpp"
+#include "mesh_file.hpp"
+#include "parallel.hpp"
+#include "bench/BenchTimer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    using Value = double;
+    using Mesh = fem::Mesh<Value>;
+    using Size = Mesh::Size;
+    using FiniteElement = Mesh::FiniteElement;
+
+    Value const elastMod = 200000;
+    Value const poissRat = 0.3;
+    Value const density = 7.85e-9;
+
+    // Предельные N для этапов, чья память или время растут быстрее числа элементов
+    Size const maxDenseSize = 32;      // плотная матрица (2 (N + 1)^2)^2
+    Size const maxDirectSize = 512;    // заполнение при разложении LDL^T
+    Size const maxIterativeSize = 256; // число итераций CG растёт как N
+
+    struct Record
+    {
+        std::string stage;
+        Size size, elements, dofs;
+        double time, cpuTime, bytes;
+        long long peakRss;
+        std::string note;
+    };
+
+    // Пиковый резидентный объём процесса в байтах (монотонно растёт за время работы)
+    long long peakRss()
+    {
+#if defined(__APPLE__)
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+#elif defined(__unix__)
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<long long>(usage.ru_maxrss) * 1024;
+#else
+        return 0;
+#endif
+    }
+
+    std::string jsonEscape(std::string const &text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    double fileBytes(std::string const &filename)
+    {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        return file.is_open() ? static_cast<double>(file.tellg()) : 0;
+    }
+
+    template <typename SparseMatrix>
+    double sparseBytes(SparseMatrix const &matrix)
+    {
+        return static_cast<double>(matrix.nonZeros()) * (sizeof(typename SparseMatrix::Scalar) + sizeof(typename SparseMatrix::StorageIndex)) +
+               static_cast<double>(matrix.outerSize() + 1) * sizeof(typename SparseMatrix::StorageIndex);
+    }
+
+    // Консоль: левый край закреплён, к правому приложена вертикальная нагрузка
+    Mesh::Nodes buildNodes(Size const &n)
+    {
+        Mesh::Nodes nodes = Mesh::buildRegulArea(0.0, 0.0, 1.0, 1.0, n, n);
+        for (Size j = 0; j <= n; ++j)
+        {
+            Size left = j * (n + 1), right = left + n;
+            nodes(left).disps.resize(2);
+            nodes(left).disps(0) = {0, 0.0};
+            nodes(left).disps(1) = {1, 0.0};
+            nodes(right).forces.resize(1);
+            nodes(right).forces(0) = {1, -1000.0 / (n + 1)};
+        }
+        return nodes;
+    }
+
+    class Benchmark
+    {
+    public:
+        Benchmark(Size tries, std::string scratch) : tries(tries), scratch(std::move(scratch))
+        {
+        }
+
+        // Время - лучшая из попыток; попытка одна, если первая заняла больше секунды.
+        // bytes() - объём данных, созданных этапом (матрица, файл), после замера
+        template <typename Run>
+        void run(std::string const &stage, Size const &size, Size const &elements, Size const &dofs,
+                 Run const &runStage, std::function<double()> const &bytes)
+        {
+            Eigen::BenchTimer timer;
+            bool ok = true;
+            for (Size k = 0; k < tries; ++k)
+            {
+                timer.start();
+                ok = runStage() && ok;
+                timer.stop();
+                if (timer.value(Eigen::REAL_TIMER) > 1)
+                    break;
+            }
+            Record record{stage, size, elements, dofs, timer.best(Eigen::REAL_TIMER), timer.best(Eigen::CPU_TIMER),
+                          bytes(), peakRss(), ok ? "" : "failed"};
+            std::cerr << stage << " N=" << size << ": " << record.time << " s" << (ok ? "" : " (failed)") << std::endl;
+            records.push_back(record);
+        }
+
+        std::string path(std::string const &name) const
+        {
+            return scratch + "/fem_bench." + name;
+        }
+
+        void writeJson(std::ostream &out) const
+        {
+            out.precision(12);
+            out << "{\n  \"benchmark\": \"fem_bench\",\n";
+            out << "  \"value_bytes\": " << sizeof(Value) << ",\n";
+            out << "  \"threads\": " << fem::hardwareThreads() << ",\n";
+#if defined(__VERSION__)
+            out << "  \"compiler\": \"" << jsonEscape(__VERSION__) << "\",\n";
+#endif
+#if defined(NDEBUG)
+            out << "  \"assertions\": false,\n";
+#else
+            out << "  \"assertions\": true,\n";
+#endif
+            out << "  \"results\": [";
+            for (Size k = 0; k < records.size(); ++k)
+            {
+                Record const &r = records[k];
+                out << (k == 0 ? "\n" : ",\n") << "    {\"stage\": \"" << jsonEscape(r.stage) << "\", \"size\": " << r.size
+                    << ", \"elements\": " << r.elements << ", \"dofs\": " << r.dofs << ", \"time\": " << r.time
+                    << ", \"cpu_time\": " << r.cpuTime << ", \"dofs_per_second\": " << (r.time > 0 ? r.dofs / r.time : 0)
+                    << ", \"bytes\": " << r.bytes << ", \"peak_rss\": " << r.peakRss;
+                if (!r.note.empty())
+                    out << ", \"note\": \"" << jsonEscape(r.note) << "\"";
+                out << "}";
+            }
+            out << "\n  ]\n}\n";
+        }
+
+    private:
+        Size tries;
+        std::string scratch;
+        std::vector<Record> records;
+    };
+
+    void benchSize(Benchmark &bench, Size const &n)
+    {
+        Size nElements = n * n, nDofs = (n + 1) * (n + 1) * FiniteElement::nNodeDofs;
+
+        Mesh::Nodes nodes;
+        std::unique_ptr<Mesh> meshPtr;
+        bench.run(
+            "mesh", n, nElements, nDofs,
+            [&]
+            {
+                nodes = buildNodes(n);
+                meshPtr.reset(new Mesh(nodes));
+                return meshPtr->getNumElements() == nElements;
+            },
+            [&]
+            { return static_cast<double>(nodes.size()) * sizeof(Mesh::Node) + static_cast<double>(nElements) * sizeof(Mesh::Element); });
+        Mesh &mesh = *meshPtr;
+
+        // Матрицы элементов без сборки: стоимость ядра на элемент
+        FiniteElement fe;
+        FiniteElement::Nodes feNodes;
+        FiniteElement::StiffnessMatrix sm;
+        FiniteElement::MassMatrix mm;
+        Value checksum = 0;
+        auto elementBytes = [&]
+        { return static_cast<double>(nElements) * FiniteElement::nElemDofs * FiniteElement::nElemDofs * sizeof(Value); };
+        bench.run(
+            "element_stiffness", n, nElements, nDofs,
+            [&]
+            {
+                for (Size e = 0; e < nElements; ++e)
+                {
+                    mesh.getElementNodes(feNodes, e);
+                    fe.calculateStiffnessMatrix(sm, feNodes, elastMod, poissRat);
+                    checksum += sm(0, 0);
+                }
+                return true;
+            },
+            elementBytes);
+        bench.run(
+            "element_mass", n, nElements, nDofs,
+            [&]
+            {
+                for (Size e = 0; e < nElements; ++e)
+                {
+                    mesh.getElementNodes(feNodes, e);
+                    fe.calculateMassMatrix(mm, feNodes, density);
+                    checksum += mm(0, 0);
+                }
+                return true;
+            },
+            elementBytes);
+        escape(&checksum);
+
+        // Сборка
+        if (n <= maxDenseSize)
+        {
+            bench.run(
+                "assembly_dense", n, nElements, nDofs,
+                [&]
+                { return mesh.calculateStiffnessMatrix(elastMod, poissRat); },
+                [&]
+                { return static_cast<double>(nDofs) * nDofs * sizeof(Value); });
+        }
+        bench.run(
+            "assembly_sparse", n, nElements, nDofs,
+            [&]
+            { return mesh.calculateSparseStiffnessMatrix(elastMod, poissRat); },
+            [&]
+            { return sparseBytes(mesh.getSparseStiffnessMatrix()); });
+        mesh.setMaterials({{elastMod, poissRat, density}});
+        bench.run(
+            "assembly_sparse_grouped", n, nElements, nDofs,
+            [&]
+            { return mesh.calculateSparseStiffnessMatrix(); },
+            [&]
+            { return sparseBytes(mesh.getSparseStiffnessMatrix()); });
+        bench.run(
+            "assembly_mass", n, nElements, nDofs,
+            [&]
+            { return mesh.calculateSparseMassMatrixFromMaterials(); },
+            [&]
+            { return sparseBytes(mesh.getSparseMassMatrix()); });
+        bench.run(
+            "force_vector", n, nElements, nDofs,
+            [&]
+            {
+                mesh.calculateForceVector();
+                return true;
+            },
+            [&]
+            { return static_cast<double>(nDofs) * sizeof(Value); });
+
+        // Решатели
+        auto solutionBytes = [&]
+        { return static_cast<double>(nDofs) * sizeof(Value); };
+        auto stiffnessBytes = [&]
+        { return sparseBytes(mesh.getSparseStiffnessMatrix()); };
+        Mesh::Vector zero = Mesh::Vector::Zero(nDofs);
+        if (n <= maxDenseSize)
+        {
+            bench.run(
+                "solve_dense", n, nElements, nDofs,
+                [&]
+                { return mesh.calculateDisplacementVector(); },
+                solutionBytes);
+        }
+        if (n <= maxDirectSize)
+        {
+            bench.run(
+                "solve_direct", n, nElements, nDofs,
+                [&]
+                { return mesh.calculateSparseDisplacementVector(); },
+                stiffnessBytes);
+            bench.run(
+                "solve_mixed_precision", n, nElements, nDofs,
+                [&]
+                { return mesh.calculateMixedPrecisionDisplacementVector(); },
+                stiffnessBytes);
+        }
+        if (n <= maxIterativeSize)
+        {
+            bench.run(
+                "solve_cg", n, nElements, nDofs,
+                [&]
+                { return mesh.calculateIterativeDisplacementVector(zero, 1e-6); },
+                stiffnessBytes);
+            bench.run(
+                "solve_cg_float_storage", n, nElements, nDofs,
+                [&]
+                { return mesh.calculateReducedPrecisionDisplacementVector(zero, fem::StoragePrecision::Float, 1e-6); },
+                stiffnessBytes);
+        }
+
+        // Запись результатов
+        std::string vtk = bench.path("vtk"), meshFile = bench.path("femb"), mtx = bench.path("mtx"), sparse = bench.path("spm");
+        bench.run(
+            "write_vtk", n, nElements, nDofs,
+            [&]
+            {
+                mesh.writeParaViewVtk(vtk);
+                return true;
+            },
+            [&]
+            { return fileBytes(vtk); });
+        bench.run(
+            "write_mesh_file", n, nElements, nDofs,
+            [&]
+            { return fem::MeshFile<Value>::write(meshFile, mesh); },
+            [&]
+            { return fileBytes(meshFile); });
+        bench.run(
+            "write_matrix_market", n, nElements, nDofs,
+            [&]
+            { return fem::saveMatrixMarket(mesh.getSparseStiffnessMatrix(), mtx); },
+            [&]
+            { return fileBytes(mtx); });
+        bench.run(
+            "write_binary_sparse", n, nElements, nDofs,
+            [&]
+            { return fem::saveBinarySparse(mesh.getSparseStiffnessMatrix(), sparse); },
+            [&]
+            { return fileBytes(sparse); });
+        for (auto const &file : {vtk, meshFile, mtx, sparse})
+            std::remove(file.c_str());
+    }
+
+    bool parseSize(char const *text, Size &value)
+    {
+        char *end = nullptr;
+        unsigned long long parsed = std::strtoull(text, &end, 10);
+        if (end == text || *end != '\0' || parsed == 0)
+            return false;
+        value = parsed;
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Size minSize = 2, maxSize = 256, tries = 3;
+    std::string output, scratch = ".";
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--min-size" && hasValue && parseSize(argv[i + 1], minSize))
+            ++i;
+        else if (option == "--max-size" && hasValue && parseSize(argv[i + 1], maxSize))
+            ++i;
+        else if (option == "--tries" && hasValue && parseSize(argv[i + 1], tries))
+            ++i;
+        else if (option == "--output" && hasValue)
+            output = argv[++i];
+        else if (option == "--scratch" && hasValue)
+            scratch = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--min-size N] [--max-size N] [--tries N] [--output file.json] [--scratch dir]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Сообщения этапов в std::cout подавляются: они не входят в замер и не смешиваются с JSON
+    Benchmark bench(tries, scratch);
+    std::streambuf *coutBuffer = std::cout.rdbuf(nullptr);
+    for (Size n = minSize; n <= maxSize; n *= 2)
+        benchSize(bench, n);
+    std::cout.rdbuf(coutBuffer);
+    std::cout.clear();
+
+    if (output.empty())
+    {
+        bench.writeJson(std::cout);
+        return 0;
+    }
+    std::ofstream file(output);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Could not open " << output << " for writing!" << std::endl;
+        return 1;
+    }
+    bench.writeJson(file);
+    return 0;
+}
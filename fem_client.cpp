@@ -0,0 +1,94 @@
+// Пример клиента сервера решений: консоль 10 x 1 из 10N x N элементов, закреплённая по левому
+// краю, решается при разных нагрузках, заданных перемещениях и материалах. Первый запрос
+// раскладывает матрицу; повторные с теми же nu и закреплениями обходятся треугольными решениями.
+//
+//   fem_client socket [--size N] [--shutdown]
+#include "solve_server.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+    using Cond = fem::SolveClient::Cond;
+    std::string socketPath;
+    std::uint64_t n = 20;
+    bool shutdown = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            n = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--shutdown") == 0)
+            shutdown = true;
+        else if (argv[i][0] != '-' && socketPath.empty())
+            socketPath = argv[i];
+        else
+        {
+            std::cerr << "Usage: fem_client socket [--size N] [--shutdown]" << std::endl;
+            return 1;
+        }
+    }
+    if (socketPath.empty() || n == 0)
+    {
+        std::cerr << "Usage: fem_client socket [--size N] [--shutdown]" << std::endl;
+        return 1;
+    }
+
+    fem::SolveClient client;
+    if (!client.connect(socketPath))
+        return 1;
+    if (shutdown)
+        return client.shutdown() ? 0 : 1;
+
+    std::uint64_t nx = 10 * n, ny = n;
+    fem::SolveMessage::OpenReply model;
+    if (!client.open("grid 0 0 10 1 " + std::to_string(nx) + " " + std::to_string(ny), model))
+        return 1;
+    std::cout << "Model " << model.model << ": " << model.nNodes << " nodes, " << model.nDofs << " DOFs" << std::endl;
+
+    // Узлы сетки по строкам: узел (i, j) имеет номер j (nx + 1) + i
+    std::vector<Cond> clamp, tipLoad, tipDisplacement;
+    for (std::uint64_t j = 0; j <= ny; ++j)
+    {
+        std::uint64_t left = j * (nx + 1), right = left + nx;
+        clamp.push_back({left, 0, 0.0});
+        clamp.push_back({left, 1, 0.0});
+        tipLoad.push_back({right, 1, -5.0});
+        tipDisplacement.push_back({right, 1, -0.01});
+    }
+    std::vector<Cond> doubledLoad = tipLoad;
+    for (auto &load : doubledLoad)
+        load.value *= 2;
+    std::vector<Cond> noLoads, clampAndTip = clamp;
+    clampAndTip.insert(clampAndTip.end(), tipDisplacement.begin(), tipDisplacement.end());
+
+    struct Query
+    {
+        char const *name;
+        double elasticityModulus, poissonRatio;
+        std::vector<Cond> const &loads, &disps;
+    };
+    std::vector<Query> queries = {
+        {"steel, tip load", 200000, 0.3, tipLoad, clamp},
+        {"steel, doubled load", 200000, 0.3, doubledLoad, clamp},
+        {"steel, prescribed tip", 200000, 0.3, noLoads, clampAndTip},
+        {"E = 70000, tip load", 70000, 0.3, tipLoad, clamp},
+        {"nu = 0.33, tip load", 70000, 0.33, tipLoad, clamp},
+        {"steel, tip load again", 200000, 0.3, tipLoad, clamp}};
+    std::uint64_t tipDof = 2 * (ny * (nx + 1) + nx) + 1;
+    for (auto const &query : queries)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fem::SolveMessage::SolveReply reply;
+        if (!client.solve(model.model, query.elasticityModulus, query.poissonRatio, query.loads, query.disps, reply))
+            return 1;
+        double roundTrip = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << query.name << ": tip deflection " << client.displacements()(tipDof) << ", "
+                  << (reply.reused ? "cached factorization" : "new factorization") << ", server "
+                  << reply.time * 1e3 << " ms, round trip " << roundTrip * 1e3 << " ms" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+// Сервер решений: держит сетки, матрицы и разложения в памяти и решает по запросам через
+// сокет Unix (см. SolveServer). Запрос - новые нагрузки, заданные перемещения или материал;
+// перемещения возвращаются через разделяемую память клиента.
+//
+//   fem_server socket [--preload "grid 0 0 10 1 200 20"]...
+//
+// Материал задаётся в каждом запросе, материалы файла сетки не используются. Сервер
+// работает до запроса Shutdown (fem_client --shutdown)
+#include "solve_server.hpp"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    using Value = double;
+    std::string socketPath;
+    fem::SolveServer<Value> server;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--preload") == 0 && i + 1 < argc)
+        {
+            if (!server.preload(argv[++i]))
+                return 1;
+        }
+        else if (argv[i][0] != '-' && socketPath.empty())
+            socketPath = argv[i];
+        else
+        {
+            std::cerr << "Usage: fem_server socket [--preload mesh]..." << std::endl;
+            return 1;
+        }
+    }
+    if (socketPath.empty())
+    {
+        std::cerr << "Usage: fem_server socket [--preload mesh]..." << std::endl;
+        return 1;
+    }
+    if (!server.listen(socketPath))
+        return 1;
+    std::cout << "Listening on " << socketPath << std::endl;
+    server.run();
+    return 0;
+}
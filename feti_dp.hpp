@@ -0,0 +1,570 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace fem
+{
+    // Двойственно-первичный метод FETI (FETI-DP). Подобласти соединяются в угловых узлах
+    // (узлы в трёх и более подобластях и концы интерфейса на внешней границе) - это первичные
+    // степени свободы грубой задачи; на остальных узлах интерфейса непрерывность обеспечивают
+    // множители Лагранжа. Интерфейсная задача для множителей решается методом сопряжённых
+    // градиентов с предобусловливателем Дирихле. Каждая подобласть раскладывается и
+    // обрабатывается в своём потоке, глобальная матрица не собирается и не раскладывается.
+    template <typename T>
+    class FetiDpSolver
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using Matrix = typename Mesh::Matrix;
+        using SparseMatrix = typename Mesh::SparseMatrix;
+        using Indices = typename Mesh::Indices;
+        using FiniteElement = typename Mesh::FiniteElement;
+
+        FetiDpSolver(Mesh const &mesh, Indices const &elementSubdomains, unsigned nThreads = 0) : mesh(mesh),
+                                                                                                 nThreads(nThreads != 0 ? nThreads : hardwareThreads())
+        {
+            if (mesh.getConstraints().size() != 0)
+                std::cerr << "Warning: FETI-DP ignores hanging-node constraints" << std::endl;
+            this->classifyDofs(elementSubdomains);
+        }
+
+        Size getNumSubdomains() const
+        {
+            return subdomains.size();
+        }
+
+        Size getNumPrimalDofs() const
+        {
+            return nPrimal;
+        }
+
+        Size getNumMultipliers() const
+        {
+            return nMultipliers;
+        }
+
+        Size getIterations() const
+        {
+            return iterations;
+        }
+
+        // Локальные разложения K_rr и K_ii и грубая задача по первичным степеням свободы.
+        // Один материал на всю сетку
+        bool factorize(Value const &elasticityModulus, Value const &poissonRatio)
+        {
+            if (!mesh.checkSingleMaterial("FETI-DP"))
+                return false;
+            typename Mesh::Material const material{elasticityModulus, poissonRatio, 0};
+            return this->factorizeSubdomains([&](Size const &) -> typename Mesh::Material const &
+                                             { return material; });
+        }
+
+        // Материалы элементов из таблицы сетки
+        bool factorize()
+        {
+            if (!mesh.checkMaterialTable())
+                return false;
+            return this->factorizeSubdomains([&](Size const &e) -> typename Mesh::Material const &
+                                             { return mesh.getElementMaterial(e); });
+        }
+
+        // Решение для вектора нагрузки F с заданными перемещениями из узлов сетки
+        bool solve(Vector &u, Eigen::Ref<const Vector> const &F,
+                   Value const &tolerance = std::sqrt(Eigen::NumTraits<Value>::epsilon()), Size const &maxIterations = 1000)
+        {
+            Size nSubdomains = subdomains.size();
+            std::vector<Vector> fr(nSubdomains), fc(nSubdomains);
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        {
+                            Subdomain const &subdomain = *subdomains[s];
+                            Vector uP = gather(prescribedValues, subdomain.prescribed);
+                            fr[s] = gather(F, subdomain.remaining, subdomain.remainingWeights) - subdomain.Krp * uP;
+                            fc[s] = gather(F, subdomain.primal, subdomain.primalWeights) - subdomain.Kcp * uP; },
+                        nThreads);
+
+            // d = sum B K_rr^-1 f_r - F_rc S_cc^-1 f~_c, f~_c = sum A^T (f_c - K_cr K_rr^-1 f_r)
+            std::vector<Vector> x(nSubdomains);
+            Vector fcTilde = Vector::Zero(nPrimal);
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        { x[s] = subdomains[s]->remainingSolver.solve(fr[s]); },
+                        nThreads);
+            for (Size s = 0; s < nSubdomains; ++s)
+            {
+                Vector local = fc[s] - subdomains[s]->Krc.transpose() * x[s];
+                this->addPrimal(fcTilde, *subdomains[s], local);
+            }
+            Vector primalCorrection = nPrimal != 0 ? Vector(coarseSolver.solve(fcTilde)) : Vector();
+            Vector d = Vector::Zero(nMultipliers);
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        {
+                            Subdomain const &subdomain = *subdomains[s];
+                            x[s] -= subdomain.remainingSolver.solve(subdomain.Krc * this->scatterPrimal(subdomain, primalCorrection)); },
+                        nThreads);
+            for (Size s = 0; s < nSubdomains; ++s)
+                this->addJump(d, *subdomains[s], x[s]);
+
+            // Сопряжённые градиенты для множителей
+            Vector lambda = Vector::Zero(nMultipliers), r = d, z, p, q;
+            Value dNorm = d.norm();
+            iterations = 0;
+            if (dNorm > 0)
+            {
+                this->applyPreconditioner(z, r);
+                p = z;
+                Value rz = r.dot(z);
+                while (iterations < maxIterations && r.norm() > tolerance * dNorm)
+                {
+                    this->applyOperator(q, p);
+                    Value alpha = rz / p.dot(q);
+                    lambda += alpha * p;
+                    r -= alpha * q;
+                    ++iterations;
+                    this->applyPreconditioner(z, r);
+                    Value rzNew = r.dot(z);
+                    p = z + (rzNew / rz) * p;
+                    rz = rzNew;
+                }
+            }
+            bool converged = dNorm == 0 || r.norm() <= tolerance * dNorm;
+            if (!converged)
+                std::cerr << "Warning: FETI-DP stopped after " << iterations << " iterations with relative residual "
+                          << r.norm() / dNorm << std::endl;
+
+            // u_c = S_cc^-1 (f~_c + F_rc^T lambda), u_r = K_rr^-1 (f_r - B^T lambda - K_rc u_c)
+            std::vector<Vector> br(nSubdomains);
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        {
+                            br[s] = fr[s] - this->transposeJump(*subdomains[s], lambda);
+                            x[s] = subdomains[s]->remainingSolver.solve(br[s]); },
+                        nThreads);
+            Vector primalRhs = Vector::Zero(nPrimal);
+            for (Size s = 0; s < nSubdomains; ++s)
+            {
+                Vector local = fc[s] - subdomains[s]->Krc.transpose() * x[s];
+                this->addPrimal(primalRhs, *subdomains[s], local);
+            }
+            Vector uPrimal = nPrimal != 0 ? Vector(coarseSolver.solve(primalRhs)) : Vector();
+
+            u.setZero(F.size());
+            Vector counts = Vector::Zero(F.size());
+            for (Size dof = 0; dof < prescribedDofs.size(); ++dof)
+            {
+                if (prescribedDofs[dof])
+                    u(dof) = prescribedValues(dof);
+            }
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        {
+                            Subdomain const &subdomain = *subdomains[s];
+                            x[s] = subdomain.remainingSolver.solve(br[s] - subdomain.Krc * this->scatterPrimal(subdomain, uPrimal)); },
+                        nThreads);
+            for (Size s = 0; s < nSubdomains; ++s)
+            {
+                Subdomain const &subdomain = *subdomains[s];
+                for (Size k = 0; k < subdomain.remaining.size(); ++k)
+                {
+                    u(subdomain.remaining[k]) += x[s](k);
+                    counts(subdomain.remaining[k]) += 1;
+                }
+                for (Size k = 0; k < subdomain.primal.size(); ++k)
+                    u(subdomain.primal[k]) = uPrimal(subdomain.primalIndices[k]);
+            }
+            // Двойственные узлы получены из двух подобластей и совпадают с точностью решения
+            for (Size dof = 0; dof < counts.size(); ++dof)
+            {
+                if (counts(dof) > 1)
+                    u(dof) /= counts(dof);
+            }
+            return converged;
+        }
+
+    private:
+        enum Category : Size
+        {
+            Interior = 0,
+            Dual = 1,
+            Primal = 2,
+            Prescribed = 3
+        };
+
+        // Оставшиеся степени свободы r: сначала внутренние, затем двойственные
+        struct Subdomain
+        {
+            std::vector<Size> elements;
+            std::vector<Size> remaining, primal, prescribed; // глобальные степени свободы
+            std::vector<Value> remainingWeights, primalWeights; // доля узловой нагрузки подобласти
+            Size nInterior = 0;
+            std::vector<Size> multipliers;   // для двойственных: номер множителя
+            std::vector<Value> signs;        // и знак в операторе скачка B
+            std::vector<Size> primalIndices; // для первичных: номер в грубой задаче
+            std::vector<Size> elementDofs;   // 4 * индекс + категория
+            SparseMatrix Krr, Krc, Krp, Kcp, Kid, Kdd;
+            Matrix coarseMatrix;
+            Eigen::SimplicialLDLT<SparseMatrix> remainingSolver, interiorSolver;
+        };
+
+        static Vector gather(Eigen::Ref<const Vector> const &source, std::vector<Size> const &dofs)
+        {
+            Vector result(dofs.size());
+            for (Size k = 0; k < dofs.size(); ++k)
+                result(k) = source(dofs[k]);
+            return result;
+        }
+
+        static Vector gather(Eigen::Ref<const Vector> const &source, std::vector<Size> const &dofs, std::vector<Value> const &weights)
+        {
+            Vector result(dofs.size());
+            for (Size k = 0; k < dofs.size(); ++k)
+                result(k) = source(dofs[k]) * weights[k];
+            return result;
+        }
+
+        void addPrimal(Vector &target, Subdomain const &subdomain, Vector const &local) const
+        {
+            for (Size k = 0; k < subdomain.primalIndices.size(); ++k)
+                target(subdomain.primalIndices[k]) += local(k);
+        }
+
+        Vector scatterPrimal(Subdomain const &subdomain, Vector const &global) const
+        {
+            Vector local(subdomain.primalIndices.size());
+            for (Size k = 0; k < subdomain.primalIndices.size(); ++k)
+                local(k) = global(subdomain.primalIndices[k]);
+            return local;
+        }
+
+        // B_s w: двойственная часть вектора подобласти в пространство множителей
+        void addJump(Vector &target, Subdomain const &subdomain, Vector const &w) const
+        {
+            for (Size k = 0; k < subdomain.multipliers.size(); ++k)
+                target(subdomain.multipliers[k]) += subdomain.signs[k] * w(subdomain.nInterior + k);
+        }
+
+        Vector transposeJump(Subdomain const &subdomain, Vector const &lambda) const
+        {
+            Vector w = Vector::Zero(subdomain.remaining.size());
+            for (Size k = 0; k < subdomain.multipliers.size(); ++k)
+                w(subdomain.nInterior + k) = subdomain.signs[k] * lambda(subdomain.multipliers[k]);
+            return w;
+        }
+
+        // F lambda = sum B K_rr^-1 B^T lambda + F_rc S_cc^-1 F_rc^T lambda
+        void applyOperator(Vector &result, Vector const &lambda) const
+        {
+            Size nSubdomains = subdomains.size();
+            std::vector<Vector> x(nSubdomains);
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        { x[s] = subdomains[s]->remainingSolver.solve(this->transposeJump(*subdomains[s], lambda)); },
+                        nThreads);
+            Vector y = Vector::Zero(nPrimal);
+            for (Size s = 0; s < nSubdomains; ++s)
+            {
+                Vector local = subdomains[s]->Krc.transpose() * x[s];
+                this->addPrimal(y, *subdomains[s], local);
+            }
+            Vector z = nPrimal != 0 ? Vector(coarseSolver.solve(y)) : Vector();
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        {
+                            Subdomain const &subdomain = *subdomains[s];
+                            x[s] += subdomain.remainingSolver.solve(subdomain.Krc * this->scatterPrimal(subdomain, z)); },
+                        nThreads);
+            result.setZero(nMultipliers);
+            for (Size s = 0; s < nSubdomains; ++s)
+                this->addJump(result, *subdomains[s], x[s]);
+        }
+
+        // Предобусловливатель Дирихле: sum B_D S_dd B_D^T, S_dd = K_dd - K_di K_ii^-1 K_id,
+        // B_D - оператор скачка, масштабированный кратностью узлов
+        void applyPreconditioner(Vector &result, Vector const &lambda) const
+        {
+            Size nSubdomains = subdomains.size();
+            std::vector<Vector> w(nSubdomains);
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        {
+                            Subdomain const &subdomain = *subdomains[s];
+                            Vector v(subdomain.multipliers.size());
+                            for (Size k = 0; k < subdomain.multipliers.size(); ++k)
+                                v(k) = subdomain.signs[k] * lambda(subdomain.multipliers[k]) / 2;
+                            w[s] = subdomain.Kdd * v;
+                            if (subdomain.nInterior != 0)
+                                w[s] -= subdomain.Kid.transpose() * subdomain.interiorSolver.solve(subdomain.Kid * v); },
+                        nThreads);
+            result.setZero(nMultipliers);
+            for (Size s = 0; s < nSubdomains; ++s)
+            {
+                Subdomain const &subdomain = *subdomains[s];
+                for (Size k = 0; k < subdomain.multipliers.size(); ++k)
+                    result(subdomain.multipliers[k]) += subdomain.signs[k] * w[s](k) / 2;
+            }
+        }
+
+        void classifyDofs(Indices const &elementSubdomains)
+        {
+            auto const &nodes = mesh.getNodes();
+            auto const &elements = mesh.getElements();
+            Size nNodes = nodes.size(), nDofs = nNodes * FiniteElement::nNodeDofs;
+            Size nSubdomains = elementSubdomains.size() != 0 ? elementSubdomains.maxCoeff() + 1 : 0;
+            subdomains.clear();
+            for (Size s = 0; s < nSubdomains; ++s)
+                subdomains.emplace_back(new Subdomain());
+            for (Size e = 0; e < elements.size(); ++e)
+                subdomains[elementSubdomains(e)]->elements.push_back(e);
+
+            prescribedDofs.assign(nDofs, 0);
+            prescribedValues.setZero(nDofs);
+            for (auto const &p : mesh.getPrescribedDofs())
+            {
+                prescribedDofs[p.first] = 1;
+                prescribedValues(p.first) = p.second;
+            }
+
+            // Подобласти каждого узла (отсортированы, без повторов)
+            std::vector<std::vector<Size>> nodeSubdomains(nNodes);
+            for (Size s = 0; s < nSubdomains; ++s)
+            {
+                for (Size e : subdomains[s]->elements)
+                {
+                    for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                    {
+                        auto &list = nodeSubdomains[elements(e)(i)];
+                        if (list.empty() || list.back() != s)
+                            list.push_back(s);
+                    }
+                }
+            }
+            Indices boundaryNodes;
+            mesh.calculateBoundaryNodes(boundaryNodes);
+            std::vector<char> onBoundary(nNodes, 0);
+            for (Size k = 0; k < boundaryNodes.size(); ++k)
+                onBoundary[boundaryNodes(k)] = 1;
+
+            nodeCategories.assign(nNodes, Interior);
+            nPrimal = nMultipliers = 0;
+            std::vector<Size> dofIndex(nDofs, none);
+            for (Size n = 0; n < nNodes; ++n)
+            {
+                Size multiplicity = nodeSubdomains[n].size();
+                if (multiplicity >= 3 || (multiplicity == 2 && onBoundary[n]))
+                    nodeCategories[n] = Primal;
+                else if (multiplicity == 2)
+                    nodeCategories[n] = Dual;
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                {
+                    Size dof = n * FiniteElement::nNodeDofs + d;
+                    if (prescribedDofs[dof])
+                        continue;
+                    if (nodeCategories[n] == Primal)
+                        dofIndex[dof] = nPrimal++;
+                    else if (nodeCategories[n] == Dual)
+                        dofIndex[dof] = nMultipliers++;
+                }
+            }
+
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        { this->numberSubdomain(*subdomains[s], s, nodeSubdomains, dofIndex); },
+                        nThreads);
+        }
+
+        void numberSubdomain(Subdomain &subdomain, Size const &s,
+                             std::vector<std::vector<Size>> const &nodeSubdomains,
+                             std::vector<Size> const &dofIndex) const
+        {
+            auto const &elements = mesh.getElements();
+            std::vector<Size> localNodes;
+            for (Size e : subdomain.elements)
+            {
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                    localNodes.push_back(elements(e)(i));
+            }
+            std::sort(localNodes.begin(), localNodes.end());
+            localNodes.erase(std::unique(localNodes.begin(), localNodes.end()), localNodes.end());
+
+            std::vector<Size> codes(localNodes.size() * FiniteElement::nNodeDofs);
+            std::vector<Size> interior, dual;
+            std::vector<Value> interiorWeights, dualWeights;
+            for (Size local = 0; local < localNodes.size(); ++local)
+            {
+                Size n = localNodes[local];
+                Value weight = Value(1) / nodeSubdomains[n].size();
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                {
+                    Size dof = n * FiniteElement::nNodeDofs + d;
+                    Size &code = codes[local * FiniteElement::nNodeDofs + d];
+                    if (prescribedDofs[dof])
+                    {
+                        code = 4 * subdomain.prescribed.size() + Prescribed;
+                        subdomain.prescribed.push_back(dof);
+                    }
+                    else if (nodeCategories[n] == Primal)
+                    {
+                        code = 4 * subdomain.primal.size() + Primal;
+                        subdomain.primal.push_back(dof);
+                        subdomain.primalWeights.push_back(weight);
+                        subdomain.primalIndices.push_back(dofIndex[dof]);
+                    }
+                    else if (nodeCategories[n] == Dual)
+                    {
+                        code = 4 * dual.size() + Dual;
+                        dual.push_back(dof);
+                        dualWeights.push_back(weight);
+                        subdomain.multipliers.push_back(dofIndex[dof]);
+                        subdomain.signs.push_back(nodeSubdomains[n].front() == s ? 1 : -1);
+                    }
+                    else
+                    {
+                        code = 4 * interior.size() + Interior;
+                        interior.push_back(dof);
+                        interiorWeights.push_back(weight);
+                    }
+                }
+            }
+            subdomain.nInterior = interior.size();
+            subdomain.remaining = interior;
+            subdomain.remaining.insert(subdomain.remaining.end(), dual.begin(), dual.end());
+            subdomain.remainingWeights = interiorWeights;
+            subdomain.remainingWeights.insert(subdomain.remainingWeights.end(), dualWeights.begin(), dualWeights.end());
+
+            subdomain.elementDofs.resize(subdomain.elements.size() * FiniteElement::nElemDofs);
+            for (Size k = 0; k < subdomain.elements.size(); ++k)
+            {
+                for (Size i = 0; i < FiniteElement::nElemDofs; ++i)
+                {
+                    Size n = elements(subdomain.elements[k])(i / FiniteElement::nNodeDofs);
+                    Size local = std::lower_bound(localNodes.begin(), localNodes.end(), n) - localNodes.begin();
+                    subdomain.elementDofs[k * FiniteElement::nElemDofs + i] = codes[local * FiniteElement::nNodeDofs + i % FiniteElement::nNodeDofs];
+                }
+            }
+        }
+
+        // materialOf(e) - материал элемента e
+        template <typename MaterialOf>
+        bool factorizeSubdomains(MaterialOf const &materialOf)
+        {
+            std::vector<char> ok(subdomains.size(), 0);
+            parallelFor(0, subdomains.size(), [&](std::size_t s)
+                        { ok[s] = this->factorizeSubdomain(*subdomains[s], materialOf); },
+                        nThreads);
+            if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+            {
+                std::cerr << "Error: subdomain factorization failed, not enough corner DOFs?" << std::endl;
+                return false;
+            }
+
+            std::vector<Eigen::Triplet<Value>> triplets;
+            for (auto const &subdomain : subdomains)
+            {
+                Matrix const &S = subdomain->coarseMatrix;
+                for (Size j = 0; j < subdomain->primalIndices.size(); ++j)
+                {
+                    for (Size i = 0; i < subdomain->primalIndices.size(); ++i)
+                        triplets.emplace_back(subdomain->primalIndices[i], subdomain->primalIndices[j], S(i, j));
+                }
+            }
+            SparseMatrix Scc(nPrimal, nPrimal);
+            Scc.setFromTriplets(triplets.begin(), triplets.end());
+            if (nPrimal != 0)
+            {
+                coarseSolver.compute(Scc);
+                if (coarseSolver.info() != Eigen::Success)
+                {
+                    std::cerr << "Error: FETI-DP coarse problem factorization failed!" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        template <typename MaterialOf>
+        bool factorizeSubdomain(Subdomain &subdomain, MaterialOf const &materialOf) const
+        {
+            Size nR = subdomain.remaining.size(), nC = subdomain.primal.size(), nP = subdomain.prescribed.size();
+            Size nI = subdomain.nInterior, nD = nR - nI;
+            std::vector<Eigen::Triplet<Value>> rr, rc, rp, cp;
+            Matrix Kcc = Matrix::Zero(nC, nC);
+
+            FiniteElement fe;
+            typename FiniteElement::Nodes feNodes;
+            typename FiniteElement::StiffnessMatrix sm;
+            for (Size k = 0; k < subdomain.elements.size(); ++k)
+            {
+                mesh.getElementNodes(feNodes, subdomain.elements[k]);
+                auto const &material = materialOf(subdomain.elements[k]);
+                fe.calculateStiffnessMatrix(sm, feNodes, material.elasticityModulus, material.poissonRatio);
+                Size const *codes = &subdomain.elementDofs[k * FiniteElement::nElemDofs];
+                for (Size i = 0; i < FiniteElement::nElemDofs; ++i)
+                {
+                    Size ci = codes[i] % 4, li = codes[i] / 4 + (codes[i] % 4 == Dual ? nI : 0);
+                    for (Size j = 0; j < FiniteElement::nElemDofs; ++j)
+                    {
+                        Size cj = codes[j] % 4, lj = codes[j] / 4 + (codes[j] % 4 == Dual ? nI : 0);
+                        bool ri = ci == Interior || ci == Dual, rj = cj == Interior || cj == Dual;
+                        if (ri && rj)
+                            rr.emplace_back(li, lj, sm(i, j));
+                        else if (ri && cj == Primal)
+                            rc.emplace_back(li, lj, sm(i, j));
+                        else if (ri && cj == Prescribed)
+                            rp.emplace_back(li, lj, sm(i, j));
+                        else if (ci == Primal && cj == Primal)
+                            Kcc(li, lj) += sm(i, j);
+                        else if (ci == Primal && cj == Prescribed)
+                            cp.emplace_back(li, lj, sm(i, j));
+                    }
+                }
+            }
+            subdomain.Krr.resize(nR, nR);
+            subdomain.Krr.setFromTriplets(rr.begin(), rr.end());
+            subdomain.Krc.resize(nR, nC);
+            subdomain.Krc.setFromTriplets(rc.begin(), rc.end());
+            subdomain.Krp.resize(nR, nP);
+            subdomain.Krp.setFromTriplets(rp.begin(), rp.end());
+            subdomain.Kcp.resize(nC, nP);
+            subdomain.Kcp.setFromTriplets(cp.begin(), cp.end());
+            subdomain.Kid = subdomain.Krr.block(0, nI, nI, nD);
+            subdomain.Kdd = subdomain.Krr.bottomRightCorner(nD, nD);
+
+            subdomain.remainingSolver.compute(subdomain.Krr);
+            if (nR != 0 && subdomain.remainingSolver.info() != Eigen::Success)
+                return false;
+            if (nI != 0)
+            {
+                SparseMatrix Kii = subdomain.Krr.topLeftCorner(nI, nI);
+                subdomain.interiorSolver.compute(Kii);
+                if (subdomain.interiorSolver.info() != Eigen::Success)
+                    return false;
+            }
+
+            // Вклад в грубую задачу: K_cc - K_cr K_rr^-1 K_rc
+            subdomain.coarseMatrix = Kcc;
+            if (nR != 0 && nC != 0)
+            {
+                Matrix solution = subdomain.remainingSolver.solve(Matrix(subdomain.Krc));
+                subdomain.coarseMatrix -= subdomain.Krc.transpose() * solution;
+            }
+            return true;
+        }
+
+        static Size const none = ~Size(0);
+
+        Mesh const &mesh;
+        unsigned nThreads;
+        std::vector<std::unique_ptr<Subdomain>> subdomains;
+        std::vector<Size> nodeCategories;
+        std::vector<char> prescribedDofs;
+        Vector prescribedValues;
+        Size nPrimal = 0, nMultipliers = 0, iterations = 0;
+        Eigen::SimplicialLDLT<SparseMatrix> coarseSolver;
+    };
+
+    template <typename T>
+    typename FetiDpSolver<T>::Size const FetiDpSolver<T>::none;
+}
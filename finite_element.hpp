@@ -16,13 +16,17 @@ namespace fem
     Size const static nNodeDofs = 2;
     Size const static nElemDofs = nNodes * nNodeDofs;
     Size const static nVoigt = 3;
+    Size const static nGaussPoints = 4;
 
     using Coordinates = Eigen::Vector<Value, nNodeDofs>;
     using Nodes = Eigen::Vector<Coordinates, nNodes>;
     using StiffnessMatrix = Eigen::Matrix<Value, nElemDofs, nElemDofs>;
+    using MassMatrix = Eigen::Matrix<Value, nElemDofs, nElemDofs>;
     using ElasticityMatrix = Eigen::Matrix<Value, nVoigt, nVoigt>;
     using ShapeFunctions = Eigen::Vector<Value, nNodes>;
     using DifferentiationMatrix = Eigen::Matrix<Value, nVoigt, nElemDofs>;
+    using Displacements = Eigen::Vector<Value, nElemDofs>;
+    using GaussValues = Eigen::Matrix<Value, nVoigt, nGaussPoints>;
 
     void calculateStiffnessMatrix(StiffnessMatrix &sm,
                                   Nodes const &nodes,
@@ -40,28 +44,129 @@ namespace fem
       ElasticityMatrix em;
       this->calculateElasticityMatrix(em, elasticityModulus, poissonRatio);
 
-      const Value gaussPoints[2] = {-1.0 / std::sqrt(3.0), 1.0 / std::sqrt(3.0)};
-      const Value gaussWeights[2] = {1.0, 1.0};
+      Value xi, eta, weight;
+      DifferentiationMatrix dm;
+
+      for (Size k = 0; k < nGaussPoints; ++k)
+      {
+        this->calculateGaussPoint(xi, eta, weight, k, a, b);
+        this->calculateDifferentiationMatrix(dm, xi, eta, a, b);
+        sm += dm.transpose() * em * dm * weight;
+      }
+    }
+
+    // Матрица жёсткости аффинно зависит от материала: K = E / (1 - nu^2) (K0 + nu K1),
+    // где K0 и K1 определяются только геометрией элемента
+    void calculateAffineStiffnessMatrices(StiffnessMatrix &sm0, StiffnessMatrix &sm1,
+                                          Nodes const &nodes)
+    {
+      sm0.setZero();
+      sm1.setZero();
+      Coordinates lsX, lsY;
+      this->findLimits(lsX, lsY, nodes);
+
+      Coordinates od;
+      this->calculateOverallDimensions(od, lsX, lsY);
+      Value const &a = od(0), &b = od(1);
+
+      ElasticityMatrix em0, em1;
+      this->calculateAffineElasticityMatrices(em0, em1);
 
       Value xi, eta, weight;
       DifferentiationMatrix dm;
 
-      for (int i = 0; i < 2; ++i)
+      for (Size k = 0; k < nGaussPoints; ++k)
       {
-        for (int j = 0; j < 2; ++j) // переписать 2
-        {
-          xi = gaussPoints[i];
-          eta = gaussPoints[j];
-          weight = gaussWeights[i] * gaussWeights[j];
+        this->calculateGaussPoint(xi, eta, weight, k, a, b);
+        this->calculateDifferentiationMatrix(dm, xi, eta, a, b);
+        sm0 += dm.transpose() * em0 * dm * weight;
+        sm1 += dm.transpose() * em1 * dm * weight;
+      }
+    }
 
-          this->calculateDifferentiationMatrix(dm, xi, eta, a, b);
-          sm += dm.transpose() * em * dm * weight;
+    // Согласованная матрица масс: density * int(N^T N) по площади элемента. Подынтегральное
+    // выражение билинейно по каждой координате, поэтому квадратура 2x2 точна
+    void calculateMassMatrix(MassMatrix &mm,
+                             Nodes const &nodes,
+                             Value const &density)
+    {
+      mm.setZero();
+      Coordinates lsX, lsY;
+      this->findLimits(lsX, lsY, nodes);
+
+      Coordinates od;
+      this->calculateOverallDimensions(od, lsX, lsY);
+      Value const &a = od(0), &b = od(1);
+
+      Value xi, eta, weight;
+      ShapeFunctions sf;
+
+      for (Size k = 0; k < nGaussPoints; ++k)
+      {
+        this->calculateGaussPoint(xi, eta, weight, k, a, b);
+        this->calculateShapeFunctions(sf, xi, eta, a, b);
+        for (Size i = 0; i < nNodes; ++i)
+        {
+          for (Size j = 0; j < nNodes; ++j)
+          {
+            for (Size d = 0; d < nNodeDofs; ++d)
+              mm(nNodeDofs * i + d, nNodeDofs * j + d) += density * sf(i) * sf(j) * weight;
+          }
         }
       }
-      sm *= (a * b / 4.0);
     }
 
-  private:
+    // Сосредоточенная (диагональная) матрица масс: суммы строк согласованной матрицы
+    void calculateLumpedMassMatrix(MassMatrix &mm,
+                                   Nodes const &nodes,
+                                   Value const &density)
+    {
+      MassMatrix consistent;
+      this->calculateMassMatrix(consistent, nodes, density);
+      mm.setZero();
+      mm.diagonal() = consistent.rowwise().sum();
+    }
+
+    // Деформации и напряжения (xx, yy, xy) в точках Гаусса по узловым перемещениям элемента
+    void calculateStrainsAndStresses(GaussValues &strains, GaussValues &stresses,
+                                     Nodes const &nodes,
+                                     Displacements const &displacements,
+                                     Value const &elasticityModulus,
+                                     Value const &poissonRatio)
+    {
+      Coordinates lsX, lsY;
+      this->findLimits(lsX, lsY, nodes);
+
+      Coordinates od;
+      this->calculateOverallDimensions(od, lsX, lsY);
+      Value const &a = od(0), &b = od(1);
+
+      ElasticityMatrix em;
+      this->calculateElasticityMatrix(em, elasticityModulus, poissonRatio);
+
+      Value xi, eta, weight;
+      DifferentiationMatrix dm;
+
+      for (Size k = 0; k < nGaussPoints; ++k)
+      {
+        this->calculateGaussPoint(xi, eta, weight, k, a, b);
+        this->calculateDifferentiationMatrix(dm, xi, eta, a, b);
+        strains.col(k) = dm * displacements;
+        stresses.col(k) = em * strains.col(k);
+      }
+    }
+
+    // Точки Гаусса 2x2 в локальных координатах элемента a x b с началом в центре,
+    // пронумерованы как узлы; вес включает якобиан a * b / 4
+    void calculateGaussPoint(Value &xi, Value &eta, Value &weight,
+                             Size const &k, Value const &a, Value const &b)
+    {
+      Value const gaussPoint = 1.0 / std::sqrt(3.0);
+      xi = (k == 0 || k == 3 ? -gaussPoint : gaussPoint) * a / 2;
+      eta = (k < 2 ? -gaussPoint : gaussPoint) * b / 2;
+      weight = a * b / 4;
+    }
+
     void calculateShapeFunctions(ShapeFunctions &sf,
                                  Value const &xi, Value const &eta,
                                  Value const &a, Value const &b)
@@ -103,6 +208,17 @@ namespace fem
       em *= factor;
     }
 
+    // D = E / (1 - nu^2) (D0 + nu D1)
+    void calculateAffineElasticityMatrices(ElasticityMatrix &em0, ElasticityMatrix &em1)
+    {
+      em0 << 1, 0, 0,
+          0, 1, 0,
+          0, 0, Value(0.5);
+      em1 << 0, 1, 0,
+          1, 0, 0,
+          0, 0, Value(-0.5);
+    }
+
     void calculateDifferentiationMatrix(DifferentiationMatrix &dm,
                                         Value const &xi, Value const &eta,
                                         Value const &a, Value const &b)
@@ -148,6 +264,7 @@ namespace fem
       od(1) = lsY(1) - lsY(0);
     }
 
+  private:
     void calculateLocalNodes(Nodes &locNodes, Coordinates const &lsX, Coordinates const &lsY, Nodes const &nodes)
     {
       Value avgX = (lsX(0) + lsX(1)) / 2;
@@ -159,4 +276,19 @@ namespace fem
       }
     }
   };
-}
\ No newline at end of file
+
+  template <typename T>
+  typename FiniteElement<T>::Size const FiniteElement<T>::nNodes;
+
+  template <typename T>
+  typename FiniteElement<T>::Size const FiniteElement<T>::nNodeDofs;
+
+  template <typename T>
+  typename FiniteElement<T>::Size const FiniteElement<T>::nElemDofs;
+
+  template <typename T>
+  typename FiniteElement<T>::Size const FiniteElement<T>::nVoigt;
+
+  template <typename T>
+  typename FiniteElement<T>::Size const FiniteElement<T>::nGaussPoints;
+}
@@ -0,0 +1,675 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fem
+{
+    // Чтение сеток Gmsh формата 4.1 (ASCII и binary). Файл отображается в память,
+    // блоки узлов и элементов разбираются параллельно сразу в хранилище Mesh.
+    // В сетку попадают линейные четырёхугольники (тип 3); квадратичные (10 и 16) отклоняются,
+    // так как их срединные узлы остались бы без элементов. Элементы остальных размерностей
+    // используются для наборов узлов физических групп.
+    template <typename T>
+    class GmshReader
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Nodes = typename Mesh::Nodes;
+        using Element = typename Mesh::Element;
+        using Elements = typename Mesh::Elements;
+        using Indices = typename Mesh::Indices;
+        using NodeSets = typename Mesh::NodeSets;
+
+        GmshReader(unsigned nThreads = 0) : nThreads(nThreads != 0 ? nThreads : hardwareThreads())
+        {
+        }
+
+        bool read(const std::string &filename)
+        {
+            nodes.resize(0);
+            elements.resize(0);
+            nodeSets.clear();
+            physicalNames.clear();
+            entityPhysicals.clear();
+            tagToIndex.clear();
+            binary = false;
+
+            MappedFile file;
+            if (!file.open(filename))
+                return false;
+
+            pos = file.data();
+            end = file.data() + file.size();
+            bool formatFound = false, nodesFound = false;
+            std::string section;
+            while (this->readSectionName(section))
+            {
+                bool ok = true;
+                if (section == "$MeshFormat")
+                {
+                    ok = this->readMeshFormat();
+                    formatFound = ok;
+                }
+                else if (!formatFound)
+                {
+                    std::cerr << "Error: " << filename << " does not start with $MeshFormat!" << std::endl;
+                    return false;
+                }
+                else if (section == "$PhysicalNames")
+                    ok = this->readPhysicalNames();
+                else if (section == "$Entities")
+                    ok = this->readEntities();
+                else if (section == "$Nodes")
+                {
+                    ok = this->readNodes();
+                    nodesFound = ok;
+                }
+                else if (section == "$Elements")
+                {
+                    if (!nodesFound)
+                    {
+                        std::cerr << "Error: $Elements before $Nodes in " << filename << std::endl;
+                        return false;
+                    }
+                    ok = this->readElements();
+                }
+
+                if (!ok || !this->skipSection(section))
+                {
+                    std::cerr << "Error: Could not read section " << section << " of " << filename << std::endl;
+                    return false;
+                }
+            }
+            std::cout << "Read " << nodes.size() << " nodes, " << elements.size() << " elements and "
+                      << nodeSets.size() << " node sets from " << filename << std::endl;
+            return formatFound;
+        }
+
+        // Передаёт прочитанные данные в сетку без копирования
+        Mesh createMesh()
+        {
+            return Mesh(std::move(nodes), std::move(elements), std::move(nodeSets));
+        }
+
+        const Nodes &getNodes() const
+        {
+            return nodes;
+        }
+
+        const Elements &getElements() const
+        {
+            return elements;
+        }
+
+        const NodeSets &getNodeSets() const
+        {
+            return nodeSets;
+        }
+
+    private:
+        static Size const invalid = ~Size(0);
+        static Size const chunkSize = 1 << 14;
+
+        // Участок блока, разбираемый одним потоком: count записей начиная с first
+        struct Task
+        {
+            Size block;
+            char const *tags;
+            char const *coords;
+            Size first, count;
+            Size stride;
+        };
+
+        struct Block
+        {
+            int dim, entity, type;
+            Size nElemNodes, first;
+        };
+
+        bool readSectionName(std::string &section)
+        {
+            this->skipSpaces();
+            if (pos >= end)
+                return false;
+            char const *lineEnd = this->findLineEnd(pos);
+            section.assign(pos, lineEnd);
+            while (!section.empty() && (section.back() == '\r' || section.back() == ' '))
+                section.pop_back();
+            pos = lineEnd == end ? end : lineEnd + 1;
+            return true;
+        }
+
+        bool skipSection(std::string const &section)
+        {
+            std::string endTag = "$End" + section.substr(1);
+            char const *found = std::search(pos, end, endTag.begin(), endTag.end());
+            if (found == end)
+                return false;
+            pos = this->findLineEnd(found);
+            return true;
+        }
+
+        bool readMeshFormat()
+        {
+            this->skipSpaces();
+            double version = this->parseDouble(pos);
+            Size fileType = this->parseInteger(pos);
+            dataSize = this->parseInteger(pos);
+            pos = this->findLineEnd(pos) + 1;
+            if (version < 4.1 || version >= 5)
+            {
+                std::cerr << "Error: Gmsh format " << version << " is not supported, save the mesh as 4.1!" << std::endl;
+                return false;
+            }
+            if (dataSize != 4 && dataSize != 8)
+            {
+                std::cerr << "Error: unsupported size_t width " << dataSize << std::endl;
+                return false;
+            }
+            binary = fileType == 1;
+            if (binary)
+            {
+                int one = 0;
+                if (end - pos < 4)
+                    return false;
+                std::memcpy(&one, pos, sizeof(int));
+                pos += sizeof(int);
+                if (one != 1)
+                {
+                    std::cerr << "Error: binary mesh has a different endianness!" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool readPhysicalNames()
+        {
+            this->skipSpaces();
+            Size n = this->parseInteger(pos);
+            for (Size i = 0; i < n; ++i)
+            {
+                int dim = int(this->parseInteger(pos));
+                int tag = int(this->parseInteger(pos));
+                char const *open = std::find(pos, end, '"');
+                char const *close = open == end ? end : std::find(open + 1, end, '"');
+                if (close == end)
+                    return false;
+                physicalNames[{dim, tag}] = std::string(open + 1, close);
+                pos = close + 1;
+            }
+            return true;
+        }
+
+        bool readEntities()
+        {
+            Size counts[4];
+            for (auto &count : counts)
+                count = this->readSize();
+            for (int dim = 0; dim < 4; ++dim)
+            {
+                for (Size i = 0; i < counts[dim]; ++i)
+                {
+                    int tag = this->readInt();
+                    for (int k = 0; k < (dim == 0 ? 3 : 6); ++k)
+                        this->readDouble();
+                    Size nPhysicals = this->readSize();
+                    std::vector<int> physicals(nPhysicals);
+                    for (auto &physical : physicals)
+                        physical = this->readInt();
+                    if (nPhysicals != 0)
+                        entityPhysicals[{dim, tag}] = physicals;
+                    if (dim > 0)
+                    {
+                        Size nBounding = this->readSize();
+                        for (Size k = 0; k < nBounding; ++k)
+                            this->readInt();
+                    }
+                    if (pos > end)
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        bool readNodes()
+        {
+            Size nBlocks = this->readSize();
+            Size nNodes = this->readSize();
+            minNodeTag = this->readSize();
+            Size maxNodeTag = this->readSize();
+            nodes.resize(nNodes);
+            tagToIndex.assign(nNodes != 0 ? maxNodeTag - minNodeTag + 1 : 0, invalid);
+
+            std::vector<Task> tasks;
+            Size first = 0;
+            for (Size b = 0; b < nBlocks; ++b)
+            {
+                int dim = this->readInt();
+                this->readInt();
+                int parametric = this->readInt();
+                Size n = this->readSize();
+                Size nValues = 3 + (parametric != 0 ? dim : 0);
+                if (first + n > nNodes)
+                    return false;
+                if (binary)
+                {
+                    char const *tags = pos;
+                    char const *coords = tags + n * dataSize;
+                    pos = coords + n * nValues * sizeof(double);
+                    if (pos > end)
+                        return false;
+                    for (Size k = 0; k < n; k += chunkSize)
+                    {
+                        tasks.push_back({b, tags + k * dataSize, coords + k * nValues * sizeof(double),
+                                         first + k, std::min(chunkSize, n - k), nValues * sizeof(double)});
+                    }
+                }
+                else
+                {
+                    pos = this->findLineEnd(pos) + 1;
+                    std::vector<char const *> tagLines, coordLines;
+                    if (!this->skipLines(n, tagLines) || !this->skipLines(n, coordLines))
+                        return false;
+                    for (Size k = 0; k < tagLines.size(); ++k)
+                    {
+                        tasks.push_back({b, tagLines[k], coordLines[k], first + k * chunkSize,
+                                         std::min(chunkSize, n - k * chunkSize), 0});
+                    }
+                }
+                first += n;
+            }
+            if (first != nNodes)
+                return false;
+
+            std::atomic<bool> failed(false);
+            parallelFor(0, tasks.size(), [&](std::size_t t)
+                        {
+                            Task const &task = tasks[t];
+                            char const *tagPos = task.tags, *coordPos = task.coords;
+                            for (Size k = 0; k < task.count; ++k)
+                            {
+                                Size index = task.first + k;
+                                Size tag;
+                                double x, y;
+                                if (binary)
+                                {
+                                    tag = this->loadSize(tagPos);
+                                    tagPos += dataSize;
+                                    std::memcpy(&x, coordPos, sizeof(double));
+                                    std::memcpy(&y, coordPos + sizeof(double), sizeof(double));
+                                    coordPos += task.stride;
+                                }
+                                else
+                                {
+                                    tag = this->parseInteger(tagPos);
+                                    x = this->parseDouble(coordPos);
+                                    y = this->parseDouble(coordPos);
+                                    coordPos = this->findLineEnd(coordPos);
+                                }
+                                if (tag < minNodeTag || tag - minNodeTag >= tagToIndex.size())
+                                {
+                                    failed = true;
+                                    return;
+                                }
+                                tagToIndex[tag - minNodeTag] = index;
+                                nodes(index).coords = {Value(x), Value(y)};
+                            } },
+                        nThreads);
+            return !failed;
+        }
+
+        bool readElements()
+        {
+            Size nBlocks = this->readSize();
+            this->readSize();
+            this->readSize();
+            this->readSize();
+
+            std::vector<Block> blocks(nBlocks);
+            std::vector<Task> tasks;
+            Size nQuads = 0;
+            for (Size b = 0; b < nBlocks; ++b)
+            {
+                Block &block = blocks[b];
+                block.dim = this->readInt();
+                block.entity = this->readInt();
+                block.type = this->readInt();
+                Size n = this->readSize();
+                block.nElemNodes = this->getNumElementNodes(block.type);
+                if (block.nElemNodes == 0)
+                {
+                    std::cerr << "Error: unsupported Gmsh element type " << block.type << std::endl;
+                    return false;
+                }
+                if (block.dim == 2 && block.type != 3)
+                {
+                    std::cerr << "Error: only 4-node quadrilateral surface elements are supported, found type "
+                              << block.type << std::endl;
+                    return false;
+                }
+                if (block.dim > 2)
+                {
+                    std::cerr << "Error: volume elements are not supported" << std::endl;
+                    return false;
+                }
+                block.first = nQuads;
+                if (block.dim == 2)
+                    nQuads += n;
+
+                if (binary)
+                {
+                    Size stride = (1 + block.nElemNodes) * dataSize;
+                    char const *data = pos;
+                    pos += n * stride;
+                    if (pos > end)
+                        return false;
+                    for (Size k = 0; k < n; k += chunkSize)
+                        tasks.push_back({b, data + k * stride, nullptr, k, std::min(chunkSize, n - k), stride});
+                }
+                else
+                {
+                    pos = this->findLineEnd(pos) + 1;
+                    std::vector<char const *> lines;
+                    if (!this->skipLines(n, lines))
+                        return false;
+                    for (Size k = 0; k < lines.size(); ++k)
+                        tasks.push_back({b, lines[k], nullptr, k * chunkSize, std::min(chunkSize, n - k * chunkSize), 0});
+                }
+            }
+            elements.resize(nQuads);
+
+            std::vector<std::vector<Size>> taskNodes(tasks.size());
+            std::atomic<bool> failed(false), skewed(false);
+            parallelFor(0, tasks.size(), [&](std::size_t t)
+                        {
+                            Task const &task = tasks[t];
+                            Block const &block = blocks[task.block];
+                            bool collect = entityPhysicals.count({block.dim, block.entity}) != 0;
+                            char const *p = task.tags;
+                            Size elemNodes[32];
+                            for (Size k = 0; k < task.count; ++k)
+                            {
+                                if (binary)
+                                {
+                                    for (Size i = 0; i < block.nElemNodes; ++i)
+                                        elemNodes[i] = this->loadSize(p + (1 + i) * dataSize);
+                                    p += (1 + block.nElemNodes) * dataSize;
+                                }
+                                else
+                                {
+                                    this->parseInteger(p);
+                                    for (Size i = 0; i < block.nElemNodes; ++i)
+                                        elemNodes[i] = this->parseInteger(p);
+                                    p = this->findLineEnd(p);
+                                }
+                                for (Size i = 0; i < block.nElemNodes; ++i)
+                                {
+                                    Size tag = elemNodes[i];
+                                    if (tag < minNodeTag || tag - minNodeTag >= tagToIndex.size() ||
+                                        tagToIndex[tag - minNodeTag] == invalid)
+                                    {
+                                        failed = true;
+                                        return;
+                                    }
+                                    elemNodes[i] = tagToIndex[tag - minNodeTag];
+                                    if (collect)
+                                        taskNodes[t].push_back(elemNodes[i]);
+                                }
+                                if (block.dim == 2 && !this->orientElement(elements(block.first + task.first + k), elemNodes))
+                                    skewed = true;
+                            } },
+                        nThreads);
+            if (failed)
+            {
+                std::cerr << "Error: element references an unknown node" << std::endl;
+                return false;
+            }
+            if (skewed)
+            {
+                std::cerr << "Error: only axis-aligned rectangular elements are supported" << std::endl;
+                return false;
+            }
+
+            std::map<std::string, std::vector<Size>> sets;
+            for (Size t = 0; t < tasks.size(); ++t)
+            {
+                Block const &block = blocks[tasks[t].block];
+                auto entity = entityPhysicals.find({block.dim, block.entity});
+                if (entity == entityPhysicals.end())
+                    continue;
+                for (int physical : entity->second)
+                {
+                    auto &set = sets[this->getPhysicalName(block.dim, physical)];
+                    set.insert(set.end(), taskNodes[t].begin(), taskNodes[t].end());
+                }
+            }
+
+            std::vector<std::pair<std::string const *, std::vector<Size> *>> setList;
+            for (auto &set : sets)
+                setList.push_back({&set.first, &set.second});
+            std::vector<Indices> indices(setList.size());
+            parallelFor(0, setList.size(), [&](std::size_t s)
+                        {
+                            auto &set = *setList[s].second;
+                            std::sort(set.begin(), set.end());
+                            set.erase(std::unique(set.begin(), set.end()), set.end());
+                            indices[s] = Eigen::Map<Indices>(set.data(), set.size()); },
+                        nThreads);
+            for (Size s = 0; s < setList.size(); ++s)
+                nodeSets[*setList[s].first] = std::move(indices[s]);
+            return true;
+        }
+
+        // Приводит порядок узлов к принятому в FiniteElement: против часовой стрелки от левого нижнего.
+        // FiniteElement интегрирует по описанному прямоугольнику, поэтому элемент, не являющийся
+        // прямоугольником со сторонами вдоль осей, отклоняется (false)
+        bool orientElement(Element &element, Size const *elemNodes) const
+        {
+            Value area = 0;
+            for (Size i = 0; i < 4; ++i)
+            {
+                auto const &p = nodes(elemNodes[i]).coords;
+                auto const &q = nodes(elemNodes[(i + 1) % 4]).coords;
+                area += p(0) * q(1) - q(0) * p(1);
+            }
+            Size order[4] = {0, 1, 2, 3};
+            if (area < 0)
+                std::swap(order[1], order[3]);
+
+            Size start = 0;
+            for (Size i = 1; i < 4; ++i)
+            {
+                auto const &p = nodes(elemNodes[order[i]]).coords;
+                auto const &s = nodes(elemNodes[order[start]]).coords;
+                if (p(0) + p(1) < s(0) + s(1))
+                    start = i;
+            }
+            for (Size i = 0; i < 4; ++i)
+                element(i) = elemNodes[order[(start + i) % 4]];
+
+            auto const &p0 = nodes(element(0)).coords, &p1 = nodes(element(1)).coords;
+            auto const &p2 = nodes(element(2)).coords, &p3 = nodes(element(3)).coords;
+            Value width = p1(0) - p0(0), height = p3(1) - p0(1);
+            Value tolerance = std::sqrt(Eigen::NumTraits<Value>::epsilon()) * std::max(std::abs(width), std::abs(height));
+            return width > tolerance && height > tolerance &&
+                   std::abs(p1(1) - p0(1)) <= tolerance && std::abs(p2(0) - p1(0)) <= tolerance &&
+                   std::abs(p2(1) - p3(1)) <= tolerance && std::abs(p3(0) - p0(0)) <= tolerance;
+        }
+
+        std::string getPhysicalName(int dim, int tag) const
+        {
+            auto name = physicalNames.find({dim, tag});
+            if (name != physicalNames.end())
+                return name->second;
+            static char const *const kinds[] = {"Point", "Curve", "Surface", "Volume"};
+            return std::string("Physical ") + kinds[dim] + " " + std::to_string(tag);
+        }
+
+        static Size getNumElementNodes(int type)
+        {
+            switch (type)
+            {
+            case 1: // отрезок
+                return 2;
+            case 2: // треугольник
+                return 3;
+            case 3: // четырёхугольник
+                return 4;
+            case 8: // квадратичный отрезок
+                return 3;
+            case 9:
+                return 6;
+            case 10:
+                return 9;
+            case 15: // точка
+                return 1;
+            case 16:
+                return 8;
+            case 26:
+                return 4;
+            case 36:
+                return 16;
+            default:
+                return 0;
+            }
+        }
+
+        // Запоминает начало каждой порции из chunkSize строк
+        bool skipLines(Size n, std::vector<char const *> &chunks)
+        {
+            for (Size k = 0; k < n; ++k)
+            {
+                if (k % chunkSize == 0)
+                    chunks.push_back(pos);
+                char const *lineEnd = this->findLineEnd(pos);
+                if (lineEnd == end)
+                    return false;
+                pos = lineEnd + 1;
+            }
+            return true;
+        }
+
+        char const *findLineEnd(char const *p) const
+        {
+            char const *found = static_cast<char const *>(std::memchr(p, '\n', end - p));
+            return found != nullptr ? found : end;
+        }
+
+        void skipSpaces()
+        {
+            while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n'))
+                ++pos;
+        }
+
+        Size parseInteger(char const *&p) const
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+                ++p;
+            bool negative = p < end && *p == '-';
+            if (negative)
+                ++p;
+            Size value = 0;
+            while (p < end && *p >= '0' && *p <= '9')
+                value = value * 10 + Size(*p++ - '0');
+            return negative ? Size(-(long long)value) : value;
+        }
+
+        // Отображённый файл не завершается нулём, поэтому strtod разбирает копию числа
+        double parseDouble(char const *&p) const
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+                ++p;
+            char token[64];
+            std::size_t length = 0;
+            while (p + length < end && length + 1 < sizeof(token) && p[length] != ' ' && p[length] != '\t' &&
+                   p[length] != '\r' && p[length] != '\n')
+            {
+                token[length] = p[length];
+                ++length;
+            }
+            token[length] = '\0';
+            char *next = nullptr;
+            double value = std::strtod(token, &next);
+            p += next - token;
+            return value;
+        }
+
+        Size loadSize(char const *p) const
+        {
+            if (dataSize == 4)
+            {
+                unsigned int value;
+                std::memcpy(&value, p, sizeof(value));
+                return value;
+            }
+            unsigned long long value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        int readInt()
+        {
+            if (!binary)
+                return int(this->parseInteger(pos));
+            int value = 0;
+            if (end - pos >= 4)
+                std::memcpy(&value, pos, sizeof(int));
+            pos += sizeof(int);
+            return value;
+        }
+
+        Size readSize()
+        {
+            if (!binary)
+                return this->parseInteger(pos);
+            Size value = end - pos >= std::ptrdiff_t(dataSize) ? this->loadSize(pos) : 0;
+            pos += dataSize;
+            return value;
+        }
+
+        double readDouble()
+        {
+            if (!binary)
+                return this->parseDouble(pos);
+            double value = 0;
+            if (end - pos >= 8)
+                std::memcpy(&value, pos, sizeof(double));
+            pos += sizeof(double);
+            return value;
+        }
+
+        unsigned nThreads;
+        char const *pos = nullptr, *end = nullptr;
+        bool binary = false;
+        Size dataSize = 8;
+        Size minNodeTag = 0;
+        std::vector<Size> tagToIndex;
+        std::map<std::pair<int, int>, std::string> physicalNames;
+        std::map<std::pair<int, int>, std::vector<int>> entityPhysicals;
+
+        Nodes nodes;
+        Elements elements;
+        NodeSets nodeSets;
+    };
+
+    template <typename T>
+    typename GmshReader<T>::Size const GmshReader<T>::invalid;
+
+    template <typename T>
+    typename GmshReader<T>::Size const GmshReader<T>::chunkSize;
+}
@@ -1,5 +1,17 @@
+#include "explicit_dynamics.hpp"
+#include "feti_dp.hpp"
 #include "mesh.hpp"
+#include "modal_analysis.hpp"
+#include "parameter_sweep.hpp"
+#include "post_processing.hpp"
+#include "profiler.hpp"
+#include "reanalysis.hpp"
+#include "reduced_order_model.hpp"
+#include "substructuring.hpp"
+#include "transient_analysis.hpp"
+#include <cmath>
 #include <iostream>
+#include <string>
 #include <vector>
 
 int main()
@@ -8,6 +20,9 @@ int main()
     using Mesh = fem::Mesh<Value>;
     using Size = Mesh::Size;
 
+    // Сводка по этапам печатается при выходе, трасса открывается в chrome://tracing или Perfetto
+    fem::Profiler::instance().enable("big_mesh_profile.json");
+
     typename Mesh::Nodes bigMeshNodes = Mesh::buildRegulArea(0.0, 0.0, 1.0, 1.0, 2, 2);
 
     for (Size i = 0; i < 3; ++i)
@@ -51,8 +66,165 @@ int main()
                   << ", v = " << displacements(2 * i + 1) << std::endl;
     }
 
-    // сохраняем в vtk
-    bigMesh.writeParaViewVtk("big_mesh.vtk");
+    // То же решение через подконструкции: области area0..area3 конденсируются на общий интерфейс
+    fem::Substructuring<Value> substructuring(bigMesh, fem::Substructuring<Value>::partitionGrid(bigMesh, 2, 2));
+    typename Mesh::Vector substructuredDisplacements;
+    if (substructuring.factorize(elastMod, poissRat) &&
+        substructuring.solve(substructuredDisplacements, bigMesh.getForceVector()))
+    {
+        std::cout << "\nSubstructuring: " << substructuring.getNumSubdomains() << " subdomains, "
+                  << substructuring.getNumDistinctSubstructures() << " distinct, "
+                  << substructuring.getNumInterfaceDofs() << " interface DOFs, max difference "
+                  << (substructuredDisplacements - displacements).cwiseAbs().maxCoeff() << std::endl;
+    }
+
+    // И итерационно методом FETI-DP на том же разбиении
+    fem::FetiDpSolver<Value> fetiDp(bigMesh, fem::Substructuring<Value>::partitionGrid(bigMesh, 2, 2));
+    typename Mesh::Vector fetiDpDisplacements;
+    if (fetiDp.factorize(elastMod, poissRat) &&
+        fetiDp.solve(fetiDpDisplacements, bigMesh.getForceVector()))
+    {
+        std::cout << "FETI-DP: " << fetiDp.getNumPrimalDofs() << " corner DOFs, "
+                  << fetiDp.getNumMultipliers() << " multipliers, " << fetiDp.getIterations()
+                  << " iterations, max difference "
+                  << (fetiDpDisplacements - displacements).cwiseAbs().maxCoeff() << std::endl;
+    }
+
+    // Серия расчётов по материалу: K0 и K1 собираются один раз, разложение - на каждое значение nu
+    fem::ParameterSweep<Value> parameterSweep(bigMesh);
+    std::vector<fem::ParameterSweep<Value>::Parameters> materials = {
+        {elastMod, poissRat}, {70000, 0.33f}, {elastMod / 2, poissRat}, {110000, 0.33f}};
+    Value sweepDifference = 0;
+    if (parameterSweep.sweep(materials, [&](Size const &k, typename Mesh::Vector const &u)
+                             {
+                                 if (k == 0)
+                                     sweepDifference = (u - displacements).cwiseAbs().maxCoeff(); }))
+    {
+        std::cout << "Parameter sweep: " << materials.size() << " materials, "
+                  << parameterSweep.getNumFactorizations() << " factorizations, max difference "
+                  << sweepDifference << std::endl;
+    }
+
+    // Два материала: нижний ряд элементов - сталь, верхний - алюминий
+    Mesh layeredMesh = bigMesh;
+    typename Mesh::MaterialIds materialIds(layeredMesh.getNumElements());
+    for (Size e = 0; e < layeredMesh.getNumElements(); ++e)
+        materialIds(e) = e < 2 ? 0 : 1;
+    if (layeredMesh.setMaterials({{elastMod, poissRat, 7.85e-9f}, {70000, 0.33f, 2.7e-9f}}, materialIds) &&
+        layeredMesh.calculateStiffnessMatrix())
+    {
+        layeredMesh.calculateDisplacementVector();
+        std::cout << "Two materials: node 4 displacement " << layeredMesh.getDisplacementVector()(2 * 4) << ", "
+                  << layeredMesh.getDisplacementVector()(2 * 4 + 1) << std::endl;
+    }
+
+    // Повреждение: жёсткость элемента 3 снижена вдвое, решение - поправкой малого ранга к разложению
+    fem::Reanalysis<Value> reanalysis(bigMesh, elastMod, poissRat);
+    reanalysis.setElementStiffnessFactor(3, 0.5f);
+    typename Mesh::Vector damagedDisplacements;
+    if (reanalysis.solve(damagedDisplacements))
+    {
+        std::cout << "Reanalysis: update rank " << reanalysis.getUpdateRank() << ", "
+                  << reanalysis.getNumFactorizations() << " factorization, node 4 displacement "
+                  << damagedDisplacements(2 * 4) << ", " << damagedDisplacements(2 * 4 + 1) << std::endl;
+    }
+
+    // Модель пониженного порядка по снимкам: заданное перемещение кромки и силы в узле 4
+    bigMesh.calculateSparseStiffnessMatrix(elastMod, poissRat);
+    fem::ReducedOrderModel<Value> reducedModel(bigMesh);
+    typename Mesh::Vector loads = bigMesh.getForceVector();
+    reducedModel.addSnapshot(loads);
+    for (Size direction = 0; direction < 2; ++direction)
+    {
+        typename Mesh::Vector unitLoad = Mesh::Vector::Zero(loads.size());
+        unitLoad(2 * 4 + direction) = 1000;
+        reducedModel.addSnapshot(unitLoad);
+    }
+    typename Mesh::Vector reducedDisplacements;
+    if (reducedModel.buildBasis(3) && reducedModel.solve(reducedDisplacements, loads))
+    {
+        std::cout << "Reduced model: rank " << reducedModel.getRank() << ", error indicator "
+                  << reducedModel.getErrorIndicator() << ", max difference "
+                  << (reducedDisplacements - displacements).cwiseAbs().maxCoeff() << std::endl;
+    }
+
+    // Разложение во float с уточнением в double до обратной погрешности порядка eps_double
+    Mesh refinedMesh = bigMesh;
+    if (refinedMesh.calculateMixedPrecisionDisplacementVector())
+    {
+        std::cout << "Mixed precision: " << refinedMesh.getSolverIterations() << " refinement iterations, backward error "
+                  << refinedMesh.getBackwardError() << ", max difference "
+                  << (refinedMesh.getDisplacementVector() - displacements).cwiseAbs().maxCoeff() << std::endl;
+    }
+
+    // Сопряжённые градиенты с матрицей в bfloat16 и векторами в double
+    Mesh compactMesh = bigMesh;
+    if (compactMesh.calculateReducedPrecisionDisplacementVector(Mesh::Vector::Zero(displacements.size()),
+                                                                fem::StoragePrecision::BFloat16, 1e-6))
+    {
+        std::cout << "Reduced-precision CG: " << compactMesh.getSolverIterations() << " iterations, finished in "
+                  << (compactMesh.getStoragePrecision() == fem::StoragePrecision::BFloat16 ? "bfloat16" : "higher precision")
+                  << ", max difference " << (compactMesh.getDisplacementVector() - displacements).cwiseAbs().maxCoeff() << std::endl;
+    }
+
+    // Оценки памяти решений; бюджет рассчитан на сопряжённые градиенты, и выбирается первый
+    // решатель, начиная с плотного, который в него укладывается
+    Mesh budgetMesh = bigMesh;
+    auto usage = budgetMesh.getMemoryUsage();
+    std::cout << "Memory: " << usage.total() << " bytes in use, solve footprints";
+    for (fem::LinearSolver solver : {fem::LinearSolver::Dense, fem::LinearSolver::SparseDirect,
+                                     fem::LinearSolver::MixedPrecision, fem::LinearSolver::ConjugateGradients})
+        std::cout << " " << fem::getLinearSolverName(solver) << " " << budgetMesh.estimateSolveFootprint(solver).total();
+    std::cout << std::endl;
+    budgetMesh.setMemoryBudget(usage.total() + budgetMesh.estimateSolveFootprint(fem::LinearSolver::ConjugateGradients).total());
+    fem::LinearSolver solver = fem::LinearSolver::Dense;
+    if (budgetMesh.selectSolver(solver) && budgetMesh.calculateDisplacementVector(solver))
+    {
+        std::cout << "Memory budget: solved with " << fem::getLinearSolverName(solver) << ", max difference "
+                  << (budgetMesh.getDisplacementVector() - displacements).cwiseAbs().maxCoeff() << std::endl;
+    }
+
+    // Собственные частоты и формы при тех же закреплениях (сталь, т/мм^3)
+    Value const density = 7.85e-9f;
+    bigMesh.calculateSparseMassMatrix(density);
+    fem::ModalAnalysis<Value> modalAnalysis(bigMesh);
+    if (modalAnalysis.solve(3))
+    {
+        std::cout << "\nNatural frequencies:" << std::endl;
+        modalAnalysis.writeModes(std::cout);
+        modalAnalysis.writeParaViewVtk("big_mesh_modes.vtk");
+
+        // Переходный процесс: заданное перемещение верхней кромки нарастает за пять периодов
+        // основного тона; каждое 25-е состояние сохраняется в vtk
+        Value period = 1 / modalAnalysis.getFrequencies()(0);
+        fem::TransientAnalysis<Value> transient(bigMesh);
+        transient.setDisplacementCurve(fem::LoadCurve<Value>({{0, 0}, {5 * period, 1}}));
+        Mesh frame = bigMesh;
+        if (transient.initialize())
+        {
+            transient.run(200, period / 20, 25, [&](Size const &step, fem::TransientAnalysis<Value> const &analysis)
+                          {
+                              frame.setDisplacementVector(analysis.getDisplacements());
+                              frame.writeParaViewVtk("big_mesh_dynamics_" + std::to_string(step) + ".vtk"); });
+        }
+
+        // Тот же процесс явной схемой с сосредоточенной массой
+        fem::ExplicitDynamics<Value> explicitDynamics(bigMesh, elastMod, poissRat, density);
+        explicitDynamics.setDisplacementCurve(fem::LoadCurve<Value>({{0, 0}, {5 * period, 1}}));
+        explicitDynamics.initialize();
+        Value explicitStep = Value(0.9) * explicitDynamics.getCriticalTimeStep();
+        Size explicitSteps = Size(std::ceil(transient.getTime() / explicitStep));
+        explicitStep = transient.getTime() / explicitSteps;
+        explicitDynamics.run(explicitSteps, explicitStep, 0, [](Size const &, fem::ExplicitDynamics<Value> const &) {});
+        std::cout << "Explicit dynamics: " << explicitSteps << " steps, critical step "
+                  << explicitDynamics.getCriticalTimeStep() << ", max difference from implicit "
+                  << (explicitDynamics.getDisplacements() - transient.getDisplacements()).cwiseAbs().maxCoeff() << std::endl;
+    }
+
+    // деформации и напряжения, сохраняем в vtk вместе с перемещениями
+    fem::PostProcessor<Value> postProcessor(bigMesh);
+    postProcessor.calculateFields(elastMod, poissRat);
+    postProcessor.writeParaViewVtk("big_mesh.vtk");
     // 4 маленькие области
     typename Mesh::Nodes area0 = Mesh::buildRegulArea(0.0, 0.0, 0.5, 0.5, 2, 2);
     typename Mesh::Nodes area1 = Mesh::buildRegulArea(0.5, 0.0, 1.0, 0.5, 2, 2);
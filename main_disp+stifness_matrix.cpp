@@ -1,8 +1,11 @@
 #include "mesh.hpp"
+#include "matrix_io.hpp"
+#include "submodel.hpp"
 #include <iostream>
 #include <vector>
 #include <fstream>
 #include <iomanip>
+#include <string>
 
 int main()
 {
@@ -43,160 +46,87 @@ int main()
     }
     bigMesh.writeParaViewVtk("big_mesh.vtk");
 
-    // 4 маленькие области
-    typename Mesh::Nodes area0 = Mesh::buildRegulArea(0.0, 0.0, 0.5, 0.5, 2, 2);
-    typename Mesh::Nodes area1 = Mesh::buildRegulArea(0.5, 0.0, 1.0, 0.5, 2, 2);
-    typename Mesh::Nodes area2 = Mesh::buildRegulArea(0.0, 0.5, 0.5, 1.0, 2, 2);
-    typename Mesh::Nodes area3 = Mesh::buildRegulArea(0.5, 0.5, 1.0, 1.0, 2, 2);
-
-    // выбираем область
-    auto &targetArea = area1;
-
-    for (Size i = 0; i < targetArea.size(); ++i)
-    {
-        targetArea(i).disps.resize(2);
-        targetArea(i).disps(0) = {0, displacements(2 * i)};     // u
-        targetArea(i).disps(1) = {1, displacements(2 * i + 1)}; // v
-
-        std::cout << "node tsrgetarea " << i << ": u="
-                  << displacements(2 * i) << ", v=" << displacements(2 * i + 1) << std::endl;
-    }
-
-    Mesh mesh0(area0);
-    Mesh mesh1(area1);
-    Mesh mesh2(area2);
-    Mesh mesh3(area3);
-
-    Mesh *targetMesh = nullptr;
-
-    if (&targetArea == &area0)
-        targetMesh = &mesh0;
-    else if (&targetArea == &area1)
-        targetMesh = &mesh1;
-    else if (&targetArea == &area2)
-        targetMesh = &mesh2;
-    else if (&targetArea == &area3)
-        targetMesh = &mesh3;
-
-    mesh0.calculateStiffnessMatrix(elastMod, poissRat);
-    mesh1.calculateStiffnessMatrix(elastMod, poissRat);
-    mesh2.calculateStiffnessMatrix(elastMod, poissRat);
-    mesh3.calculateStiffnessMatrix(elastMod, poissRat);
-
-    // ВЫВОД МАТРИЦ ЖЁСТКОСТИ В ФАЙЛ
-    std::ofstream stiffnessFile("stiffness_matrix.txt");
-    if (stiffnessFile.is_open())
-    {
-        // Большая сетка
-        stiffnessFile << "BIG MESH STIFFNESS MATRIX ("
-                      << bigMesh.getStiffnessMatrix().rows() << "x"
-                      << bigMesh.getStiffnessMatrix().cols() << "):\n";
-        stiffnessFile << bigMesh.getStiffnessMatrix() << "\n\n";
-
-        // Area 0
-        stiffnessFile << "AREA0 STIFFNESS MATRIX ("
-                      << mesh0.getStiffnessMatrix().rows() << "x"
-                      << mesh0.getStiffnessMatrix().cols() << "):\n";
-        stiffnessFile << mesh0.getStiffnessMatrix() << "\n\n";
-
-        // Area 1
-        stiffnessFile << "AREA1 STIFFNESS MATRIX ("
-                      << mesh1.getStiffnessMatrix().rows() << "x"
-                      << mesh1.getStiffnessMatrix().cols() << "):\n";
-        stiffnessFile << mesh1.getStiffnessMatrix() << "\n\n";
-
-        // Area 2
-        stiffnessFile << "AREA2 STIFFNESS MATRIX ("
-                      << mesh2.getStiffnessMatrix().rows() << "x"
-                      << mesh2.getStiffnessMatrix().cols() << "):\n";
-        stiffnessFile << mesh2.getStiffnessMatrix() << "\n\n";
-
-        // Area 3
-        stiffnessFile << "AREA3 STIFFNESS MATRIX ("
-                      << mesh3.getStiffnessMatrix().rows() << "x"
-                      << mesh3.getStiffnessMatrix().cols() << "):\n";
-        stiffnessFile << mesh3.getStiffnessMatrix() << "\n";
-
-        stiffnessFile.close();
-        std::cout << "Stiffness matrix saved to 'stiffness_matrix.txt'" << std::endl;
-    }
-    else
-    {
-        std::cerr << "Error: Could not open stiffness_matrix.txt for writing!" << std::endl;
-    }
-
-    targetMesh->calculateStiffnessMatrix(elastMod, poissRat);
-    targetMesh->calculateForceVector();
-    targetMesh->calculateDisplacementVector();
-    auto target_displacements = targetMesh->getDisplacementVector();
-    std::cout << "\ndisplacement targetarea:" << std::endl;
-    std::cout << "Node\tu\t\tv" << std::endl;
-    std::cout << "----------------------------" << std::endl;
-    for (Size i = 0; i < targetMesh->getNumNodes(); ++i)
+    // Подмодели: любое число областей, каждая решается независимо и параллельно с остальными
+    struct Area
     {
-        std::cout << i << "\t" << target_displacements(2 * i)
-                  << "\t\t" << target_displacements(2 * i + 1) << std::endl;
-    }
+        Value x0, y0, x1, y1;
+        Size nx, ny;
+    };
+    std::vector<Area> areas = {{0.0, 0.0, 0.5, 0.5, 2, 2},
+                               {0.5, 0.0, 1.0, 0.5, 2, 2},
+                               {0.0, 0.5, 0.5, 1.0, 2, 2},
+                               {0.5, 0.5, 1.0, 1.0, 2, 2}};
+
+    // ВЫВОД МАТРИЦ ЖЁСТКОСТИ В ФАЙЛЫ (разреженный формат Matrix Market)
+    bigMesh.calculateSparseStiffnessMatrix(elastMod, poissRat);
+    fem::saveMatrixMarket(bigMesh.getSparseStiffnessMatrix(), "big_mesh_stiffness.mtx");
 
     // ВЫВОД ПЕРЕМЕЩЕНИЙ В ТЕКСТОВЫЙ ФАЙЛ
     std::ofstream dispFile("displacements.txt");
-    if (dispFile.is_open())
+    dispFile << std::fixed << std::setprecision(6);
+
+    // Перемещения большой сетки
+    dispFile << "BIG MESH DISPLACEMENTS:\n";
+    dispFile << "Node\tX-Coord\t\tY-Coord\t\tu\t\tv\n";
+    dispFile << "------------------------------------------------------------\n";
+    for (Size i = 0; i < bigMesh.getNumNodes(); ++i)
     {
-        dispFile << std::fixed << std::setprecision(6);
+        dispFile << i << "\t"
+                 << bigMeshNodes(i).coords(0) << "\t\t"
+                 << bigMeshNodes(i).coords(1) << "\t\t"
+                 << displacements(2 * i) << "\t\t"
+                 << displacements(2 * i + 1) << "\n";
+    }
 
-        // Перемещения большой сетки
-        dispFile << "BIG MESH DISPLACEMENTS:\n";
-        dispFile << "Node\tX-Coord\t\tY-Coord\t\tu\t\tv\n";
-        dispFile << "------------------------------------------------------------\n";
-        for (Size i = 0; i < bigMesh.getNumNodes(); ++i)
+    // Граничные перемещения подмоделей интерполируются с большой сетки по положению узлов,
+    // результаты выводятся по мере готовности
+    fem::SubmodelTransfer<Value> transfer(bigMesh);
+    bool submodelsSolved = transfer.solveSubmodels(
+        areas.size(),
+        [&](Size i)
         {
-            dispFile << i << "\t"
-                     << bigMeshNodes(i).coords(0) << "\t\t"
-                     << bigMeshNodes(i).coords(1) << "\t\t"
-                     << displacements(2 * i) << "\t\t"
-                     << displacements(2 * i + 1) << "\n";
-        }
-
-        dispFile << "\n\nTARGET AREA DISPLACEMENTS:\n";
-        dispFile << "Node\tX-Coord\t\tY-Coord\t\tu\t\tv\n";
-        dispFile << "------------------------------------------------------------\n";
-        for (Size i = 0; i < targetMesh->getNumNodes(); ++i)
+            auto const &area = areas[i];
+            return Mesh(Mesh::buildRegulArea(area.x0, area.y0, area.x1, area.y1, area.nx, area.ny));
+        },
+        elastMod, poissRat,
+        [&](Size i, Mesh const &mesh)
         {
-            dispFile << i << "\t"
-                     << targetArea(i).coords(0) << "\t\t"
-                     << targetArea(i).coords(1) << "\t\t"
-                     << target_displacements(2 * i) << "\t\t"
-                     << target_displacements(2 * i + 1) << "\n";
-        }
+            std::string name = "area" + std::to_string(i);
+            auto const &areaDisplacements = mesh.getDisplacementVector();
+            std::cout << "\ndisplacement " << name << ":" << std::endl;
+            std::cout << "Node\tu\t\tv" << std::endl;
+            std::cout << "----------------------------" << std::endl;
+            for (Size j = 0; j < mesh.getNumNodes(); ++j)
+            {
+                std::cout << j << "\t" << areaDisplacements(2 * j)
+                          << "\t\t" << areaDisplacements(2 * j + 1) << std::endl;
+            }
+
+            dispFile << "\n\n" << name << " DISPLACEMENTS:\n";
+            dispFile << "Node\tX-Coord\t\tY-Coord\t\tu\t\tv\n";
+            dispFile << "------------------------------------------------------------\n";
+            for (Size j = 0; j < mesh.getNumNodes(); ++j)
+            {
+                dispFile << j << "\t"
+                         << mesh.getNodes()(j).coords(0) << "\t\t"
+                         << mesh.getNodes()(j).coords(1) << "\t\t"
+                         << areaDisplacements(2 * j) << "\t\t"
+                         << areaDisplacements(2 * j + 1) << "\n";
+            }
+
+            fem::saveMatrixMarket(mesh.getSparseStiffnessMatrix(), name + "_stiffness.mtx");
+            mesh.writeParaViewVtk(name + ".vtk");
+        });
+    if (!submodelsSolved)
+    {
+        std::cerr << "Error: not all submodels were solved!" << std::endl;
     }
-    mesh0.writeParaViewVtk("area0.vtk");
-    mesh1.writeParaViewVtk("area1.vtk");
-    mesh2.writeParaViewVtk("area2.vtk");
-    mesh3.writeParaViewVtk("area3.vtk");
-
-    if (&targetArea == &area0)
-        targetMesh->writeParaViewVtk("target_area0.vtk");
-    else if (&targetArea == &area1)
-        targetMesh->writeParaViewVtk("target_area1.vtk");
-    else if (&targetArea == &area2)
-        targetMesh->writeParaViewVtk("target_area2.vtk");
-    else if (&targetArea == &area3)
-        targetMesh->writeParaViewVtk("target_area3.vtk");
 
     std::cout << "- big_mesh.vtk" << std::endl;
-    std::cout << "- area0.vtk" << std::endl;
-    std::cout << "- area1.vtk" << std::endl;
-    std::cout << "- area2.vtk" << std::endl;
-    std::cout << "- area3.vtk" << std::endl;
-
-    if (&targetArea == &area0)
-        std::cout << "- target_area0.vtk (displacements)" << std::endl;
-    else if (&targetArea == &area1)
-        std::cout << "- target_area1.vtk (displacements)" << std::endl;
-    else if (&targetArea == &area2)
-        std::cout << "- target_area2.vtk (displacements)" << std::endl;
-    else if (&targetArea == &area3)
-        std::cout << "- target_area3.vtk (displacements)" << std::endl;
+    for (Size i = 0; i < areas.size(); ++i)
+    {
+        std::cout << "- area" << i << ".vtk (displacements)" << std::endl;
+    }
 
     std::system("pause");
     return 0;
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fem
+{
+    // Файл, отображённый в память только для чтения
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        MappedFile(MappedFile const &) = delete;
+        MappedFile &operator=(MappedFile const &) = delete;
+
+        ~MappedFile()
+        {
+            this->close();
+        }
+
+        bool open(const std::string &filename)
+        {
+            this->close();
+#ifdef _WIN32
+            file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+            {
+                std::cerr << "Error: Could not open " << filename << " for reading!" << std::endl;
+                return false;
+            }
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize))
+            {
+                std::cerr << "Error: Could not get size of " << filename << std::endl;
+                this->close();
+                return false;
+            }
+            length = std::size_t(fileSize.QuadPart);
+            if (length != 0)
+            {
+                mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping != nullptr)
+                    address = static_cast<char const *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            }
+#else
+            descriptor = ::open(filename.c_str(), O_RDONLY);
+            if (descriptor < 0)
+            {
+                std::cerr << "Error: Could not open " << filename << " for reading!" << std::endl;
+                return false;
+            }
+            struct stat fileStat;
+            if (fstat(descriptor, &fileStat) != 0)
+            {
+                std::cerr << "Error: Could not get size of " << filename << std::endl;
+                this->close();
+                return false;
+            }
+            length = std::size_t(fileStat.st_size);
+            if (length != 0)
+            {
+                void *map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                if (map != MAP_FAILED)
+                {
+                    address = static_cast<char const *>(map);
+                    madvise(map, length, MADV_WILLNEED);
+                }
+            }
+#endif
+            if (address == nullptr && length != 0)
+            {
+                std::cerr << "Error: Could not map " << filename << " into memory!" << std::endl;
+                this->close();
+                return false;
+            }
+            return true;
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if (address != nullptr)
+                UnmapViewOfFile(address);
+            if (mapping != nullptr)
+                CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+            mapping = nullptr;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (address != nullptr)
+                munmap(const_cast<char *>(address), length);
+            if (descriptor >= 0)
+                ::close(descriptor);
+            descriptor = -1;
+#endif
+            address = nullptr;
+            length = 0;
+        }
+
+        char const *data() const
+        {
+            return address;
+        }
+
+        std::size_t size() const
+        {
+            return length;
+        }
+
+    private:
+        char const *address = nullptr;
+        std::size_t length = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int descriptor = -1;
+#endif
+    };
+}
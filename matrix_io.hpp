@@ -0,0 +1,201 @@
+#pragma once
+
+#include "profiler.hpp"
+#include <Eigen/SparseCore>
+#include <unsupported/Eigen/SparseExtra>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace fem
+{
+    // Запись разреженной матрицы в формате Matrix Market (coordinate real general).
+    // Ненулевые элементы пишутся прямо из сжатого хранилища, без плотной копии
+    template <typename SparseMatrix>
+    bool saveMatrixMarket(SparseMatrix const &matrix, const std::string &filename)
+    {
+        FEM_PROFILE("write Matrix Market");
+        if (!Eigen::saveMarket(matrix, filename))
+        {
+            std::cerr << "Error: Could not open " << filename << " for writing!" << std::endl;
+            return false;
+        }
+        std::cout << "Matrix " << matrix.rows() << "x" << matrix.cols() << " (" << matrix.nonZeros()
+                  << " non-zeros) saved to " << filename << std::endl;
+        return true;
+    }
+
+    // Чтение Matrix Market; для файлов "symmetric" достраивается верхний треугольник
+    template <typename SparseMatrix>
+    bool loadMatrixMarket(SparseMatrix &matrix, const std::string &filename)
+    {
+        std::ifstream file(filename);
+        std::string banner;
+        std::getline(file, banner);
+        if (!file.good() || banner.compare(0, 14, "%%MatrixMarket") != 0)
+        {
+            std::cerr << "Error: " << filename << " is not a Matrix Market file!" << std::endl;
+            return false;
+        }
+        file.close();
+
+        if (!Eigen::loadMarket(matrix, filename))
+        {
+            std::cerr << "Error: Could not read " << filename << std::endl;
+            return false;
+        }
+        if (banner.find("symmetric") != std::string::npos)
+        {
+            SparseMatrix lower = matrix.template triangularView<Eigen::Lower>();
+            matrix = lower.template selfadjointView<Eigen::Lower>();
+        }
+        return true;
+    }
+
+    // Двоичная сжатая разреженная матрица: заголовок и массивы outer/inner/values как есть.
+    // Порядок хранения записывается в заголовке: CSC для Eigen::ColMajor (как у матриц
+    // жёсткости сетки), CSR для Eigen::RowMajor. Матрица другого порядка при чтении
+    // перестраивается; для симметричной K массивы CSC и CSR совпадают
+    struct BinarySparseHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t valueBytes;
+        std::uint32_t indexBytes;
+        std::uint32_t columnMajor;
+        std::uint64_t rows;
+        std::uint64_t cols;
+        std::uint64_t nonZeros;
+    };
+
+    template <typename SparseMatrix>
+    bool saveBinarySparse(SparseMatrix const &matrix, const std::string &filename)
+    {
+        FEM_PROFILE("write binary sparse matrix");
+        using Scalar = typename SparseMatrix::Scalar;
+        using StorageIndex = typename SparseMatrix::StorageIndex;
+        if (!matrix.isCompressed())
+        {
+            std::cerr << "Error: matrix must be compressed before saving to " << filename << std::endl;
+            return false;
+        }
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cerr << "Error: Could not open " << filename << " for writing!" << std::endl;
+            return false;
+        }
+
+        BinarySparseHeader header = {};
+        std::memcpy(header.magic, "FEMSPM", 7);
+        header.version = 1;
+        header.valueBytes = sizeof(Scalar);
+        header.indexBytes = sizeof(StorageIndex);
+        header.columnMajor = SparseMatrix::IsRowMajor ? 0 : 1;
+        header.rows = matrix.rows();
+        header.cols = matrix.cols();
+        header.nonZeros = matrix.nonZeros();
+
+        file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        file.write(reinterpret_cast<char const *>(matrix.outerIndexPtr()), (matrix.outerSize() + 1) * sizeof(StorageIndex));
+        file.write(reinterpret_cast<char const *>(matrix.innerIndexPtr()), matrix.nonZeros() * sizeof(StorageIndex));
+        file.write(reinterpret_cast<char const *>(matrix.valuePtr()), matrix.nonZeros() * sizeof(Scalar));
+        if (!file.good())
+        {
+            std::cerr << "Error: Could not write " << filename << std::endl;
+            return false;
+        }
+        std::cout << "Matrix " << matrix.rows() << "x" << matrix.cols() << " (" << matrix.nonZeros() << " non-zeros, "
+                  << (SparseMatrix::IsRowMajor ? "CSR" : "CSC") << ") saved to " << filename << std::endl;
+        return true;
+    }
+
+    template <typename Scalar, int Options, typename StorageIndex>
+    bool loadBinarySparse(Eigen::SparseMatrix<Scalar, Options, StorageIndex> &matrix, const std::string &filename)
+    {
+        using SparseMatrix = Eigen::SparseMatrix<Scalar, Options, StorageIndex>;
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        std::uint64_t fileBytes = file.is_open() ? std::uint64_t(file.tellg()) : 0;
+        file.seekg(0);
+        BinarySparseHeader header;
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, "FEMSPM", 7) != 0)
+        {
+            std::cerr << "Error: " << filename << " is not a binary sparse matrix file!" << std::endl;
+            return false;
+        }
+        if (header.valueBytes != sizeof(Scalar) || header.indexBytes != sizeof(StorageIndex))
+        {
+            std::cerr << "Error: " << filename << " stores " << header.valueBytes * 8 << "-bit values and "
+                      << header.indexBytes * 8 << "-bit indices" << std::endl;
+            return false;
+        }
+
+        // Размеры из заголовка сверяются с длиной файла до выделения памяти
+        bool columnMajor = header.columnMajor != 0;
+        std::uint64_t outerSize = columnMajor ? header.cols : header.rows;
+        std::uint64_t innerSize = columnMajor ? header.rows : header.cols;
+        std::uint64_t const maxIndex = std::uint64_t(Eigen::NumTraits<StorageIndex>::highest());
+        std::uint64_t dataBytes = fileBytes - sizeof(header);
+        if (header.rows > maxIndex || header.cols > maxIndex || header.nonZeros > maxIndex ||
+            outerSize + 1 > dataBytes / sizeof(StorageIndex) ||
+            header.nonZeros > (dataBytes - (outerSize + 1) * sizeof(StorageIndex)) / (sizeof(StorageIndex) + sizeof(Scalar)) ||
+            dataBytes != (outerSize + 1) * sizeof(StorageIndex) + header.nonZeros * (sizeof(StorageIndex) + sizeof(Scalar)))
+        {
+            std::cerr << "Error: " << filename << " size does not match a " << header.rows << "x" << header.cols
+                      << " matrix with " << header.nonZeros << " non-zeros!" << std::endl;
+            return false;
+        }
+
+        // Индексы проверяются до того, как Eigen начнёт по ним обращаться
+        auto readInto = [&](auto &target)
+        {
+            target.resize(header.rows, header.cols);
+            target.resizeNonZeros(header.nonZeros);
+            StorageIndex *outer = target.outerIndexPtr();
+            StorageIndex *inner = target.innerIndexPtr();
+            file.read(reinterpret_cast<char *>(outer), (outerSize + 1) * sizeof(StorageIndex));
+            file.read(reinterpret_cast<char *>(inner), header.nonZeros * sizeof(StorageIndex));
+            file.read(reinterpret_cast<char *>(target.valuePtr()), header.nonZeros * sizeof(Scalar));
+            if (!file.good())
+                return false;
+            if (outer[0] != 0 || std::uint64_t(outer[outerSize]) != header.nonZeros)
+                return false;
+            for (std::uint64_t j = 0; j < outerSize; ++j)
+            {
+                if (outer[j] > outer[j + 1])
+                    return false;
+            }
+            for (std::uint64_t j = 0; j < outerSize; ++j)
+            {
+                for (StorageIndex k = outer[j]; k < outer[j + 1]; ++k)
+                {
+                    if (inner[k] < 0 || std::uint64_t(inner[k]) >= innerSize || (k > outer[j] && inner[k] <= inner[k - 1]))
+                        return false;
+                }
+            }
+            return true;
+        };
+        bool valid;
+        if (columnMajor == !SparseMatrix::IsRowMajor)
+        {
+            valid = readInto(matrix);
+        }
+        else
+        {
+            Eigen::SparseMatrix<Scalar, SparseMatrix::IsRowMajor ? Eigen::ColMajor : Eigen::RowMajor, StorageIndex> other;
+            valid = readInto(other);
+            if (valid)
+                matrix = other;
+        }
+        if (!valid)
+        {
+            matrix.resize(0, 0);
+            std::cerr << "Error: " << filename << " has corrupt " << (columnMajor ? "CSC" : "CSR") << " index arrays!" << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
@@ -1,12 +1,48 @@
 #pragma once
 
 #include "finite_element.hpp"
+#include "profiler.hpp"
+#include "reduced_precision_cg.hpp"
 #include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 namespace fem
 {
+    // Решатели системы K u = F в порядке убывания требуемой памяти
+    enum class LinearSolver
+    {
+        Dense,
+        SparseDirect,
+        MixedPrecision,
+        ConjugateGradients
+    };
+
+    inline char const *getLinearSolverName(LinearSolver const &solver)
+    {
+        switch (solver)
+        {
+        case LinearSolver::Dense:
+            return "dense";
+        case LinearSolver::SparseDirect:
+            return "sparse direct";
+        case LinearSolver::MixedPrecision:
+            return "mixed-precision";
+        default:
+            return "conjugate gradients";
+        }
+    }
+
     template <typename T>
     class Mesh
     {
@@ -14,10 +50,9 @@ namespace fem
         using Value = T;
         using Size = unsigned long long int;
         using FiniteElement = fem::FiniteElement<Value>;
-        Size const static nElems = 1;
-        Size const static nMeshDofs = nElems * FiniteElement::nElemDofs;
         using Vector = Eigen::VectorX<Value>;
         using Matrix = Eigen::MatrixX<Value>;
+        using SparseMatrix = Eigen::SparseMatrix<Value>;
 
         struct Cond
         {
@@ -34,17 +69,151 @@ namespace fem
         };
 
         using Nodes = Eigen::VectorX<Node>;
+        using Element = Eigen::Vector<Size, FiniteElement::nNodes>; // узлы против часовой стрелки, начиная с левого нижнего
+        using Elements = Eigen::VectorX<Element>;
+        using Indices = Eigen::VectorX<Size>;
+        using NodeSets = std::map<std::string, Indices>;
+
+        struct Constraint
+        {
+            Size node;
+            Indices masters;
+            Vector weights;
+        };
+
+        using Constraints = Eigen::VectorX<Constraint>;
+        using Prescribed = std::vector<std::pair<Size, Value>>; // степень свободы и её значение
+
+        struct Material
+        {
+            Value elasticityModulus;
+            Value poissonRatio;
+            Value density;
+        };
+
+        using Materials = std::vector<Material>;
+        using MaterialId = std::uint16_t;
+        using MaterialIds = Eigen::VectorX<MaterialId>;
+
+        // Память, занятая составляющими сетки, байт
+        struct MemoryUsage
+        {
+            Size nodes = 0, elements = 0, nodeSets = 0, constraints = 0, materials = 0;
+            Size stiffnessMatrix = 0, sparseStiffnessMatrix = 0, sparseMassMatrix = 0, vectors = 0;
+
+            Size total() const
+            {
+                return nodes + elements + nodeSets + constraints + materials + stiffnessMatrix +
+                       sparseStiffnessMatrix + sparseMassMatrix + vectors;
+            }
+        };
+
+        // Дополнительная память, которую займёт решение, байт: сборка ещё не собранной матрицы,
+        // копия матрицы с граничными условиями, разложение и рабочие векторы
+        struct SolveFootprint
+        {
+            Size assembly = 0, matrix = 0, factor = 0, vectors = 0;
+
+            Size total() const
+            {
+                return assembly + matrix + factor + vectors;
+            }
+        };
+
+        Mesh(Nodes const &nodes) : Mesh(nodes, buildElements(nodes))
+        {
+        }
 
-        Mesh(Nodes const &nodes) : nodes(nodes),
-                                   stiffnessMatrix(nodes.size() * FiniteElement::nNodeDofs, nodes.size() * FiniteElement::nNodeDofs),
-                                   forceVector(nodes.size() * FiniteElement::nNodeDofs),
-                                   displacementVector(nodes.size() * FiniteElement::nNodeDofs)
+        Mesh(Nodes nodes, Elements elements, NodeSets nodeSets = NodeSets()) : nodes(std::move(nodes)),
+                                                                              elements(std::move(elements)),
+                                                                              nodeSets(std::move(nodeSets)),
+                                                                              forceVector(this->nodes.size() * FiniteElement::nNodeDofs),
+                                                                              displacementVector(this->nodes.size() * FiniteElement::nNodeDofs)
         {
-            stiffnessMatrix.setZero();
             forceVector.setZero();
             displacementVector.setZero();
         }
 
+        static Nodes buildRegulArea(Value const &x0, Value const &y0,
+                                    Value const &x1, Value const &y1,
+                                    Size const &nx, Size const &ny)
+        {
+            FEM_PROFILE("mesh generation");
+            Nodes nodes((nx + 1) * (ny + 1));
+            for (Size j = 0; j <= ny; ++j)
+            {
+                for (Size i = 0; i <= nx; ++i)
+                {
+                    nodes(j * (nx + 1) + i).coords = {x0 + (x1 - x0) * i / nx, y0 + (y1 - y0) * j / ny};
+                }
+            }
+            return nodes;
+        }
+
+        static Elements buildRegulElements(Size const &nx, Size const &ny)
+        {
+            Elements elements(nx * ny);
+            for (Size j = 0; j < ny; ++j)
+            {
+                for (Size i = 0; i < nx; ++i)
+                {
+                    Size n0 = j * (nx + 1) + i;
+                    elements(j * nx + i) = {n0, n0 + 1, n0 + nx + 2, n0 + nx + 1};
+                }
+            }
+            return elements;
+        }
+
+        // Связность для узлов из buildRegulArea: число узлов в ряду определяется по первой строке.
+        // Четыре узла, заданные против часовой стрелки, образуют один элемент
+        static Elements buildElements(Nodes const &nodes)
+        {
+            FEM_PROFILE("mesh generation");
+            if (nodes.size() == FiniteElement::nNodes && nodes(2).coords(0) != nodes(0).coords(0))
+            {
+                Elements elements(1);
+                elements(0) = {0, 1, 2, 3};
+                return elements;
+            }
+
+            Size nRow = 1;
+            while (nRow < Size(nodes.size()) && nodes(nRow).coords(1) == nodes(0).coords(1))
+            {
+                ++nRow;
+            }
+            if (nRow < 2 || nodes.size() % nRow != 0 || Size(nodes.size()) / nRow < 2)
+            {
+                std::cerr << "Error: nodes do not form a regular area!" << std::endl;
+                return Elements();
+            }
+            return buildRegulElements(nRow - 1, nodes.size() / nRow - 1);
+        }
+
+        Size getNumNodes() const
+        {
+            return nodes.size();
+        }
+
+        Size getNumElements() const
+        {
+            return elements.size();
+        }
+
+        const Nodes &getNodes() const
+        {
+            return nodes;
+        }
+
+        const Elements &getElements() const
+        {
+            return elements;
+        }
+
+        const NodeSets &getNodeSets() const
+        {
+            return nodeSets;
+        }
+
         void printStiffnessMatrix() const
         {
             std::cout << stiffnessMatrix << std::endl;
@@ -52,6 +221,7 @@ namespace fem
 
         void saveStiffnessMatrixToFile(const std::string &filename) const
         {
+            FEM_PROFILE("write stiffness matrix");
             std::ofstream file(filename);
             if (file.is_open())
             {
@@ -72,24 +242,406 @@ namespace fem
             return stiffnessMatrix;
         }
 
-        void calculateStiffnessMatrix(
+        const SparseMatrix &getSparseStiffnessMatrix() const
+        {
+            return sparseStiffnessMatrix;
+        }
+
+        const SparseMatrix &getSparseMassMatrix() const
+        {
+            return sparseMassMatrix;
+        }
+
+        const Vector &getForceVector() const
+        {
+            return forceVector;
+        }
+
+        const Vector &getDisplacementVector() const
+        {
+            return displacementVector;
+        }
+
+        void setDisplacementVector(Eigen::Ref<const Vector> const &displacements)
+        {
+            displacementVector = displacements;
+        }
+
+        // Замена заданных перемещений узла, например перенесённых с глобальной модели
+        void setDisps(Size const &node, Conds disps)
+        {
+            nodes(node).disps = std::move(disps);
+        }
+
+        // Замена узловых сил; вектор сил после этого пересчитывается calculateForceVector
+        void setForces(Size const &node, Conds forces)
+        {
+            nodes(node).forces = std::move(forces);
+        }
+
+        // Связи вида u(node) = sum weights(k) * u(masters(k)), например для висячих узлов.
+        // Ведущие узлы сами не должны быть связанными
+        void setConstraints(Constraints newConstraints)
+        {
+            constraints = std::move(newConstraints);
+            constraintIndices.setConstant(constraints.size() != 0 ? nodes.size() : 0, unconstrained);
+            for (Size c = 0; c < constraints.size(); ++c)
+            {
+                constraintIndices(constraints(c).node) = c;
+            }
+        }
+
+        const Constraints &getConstraints() const
+        {
+            return constraints;
+        }
+
+        // Отметки степеней свободы связанных узлов: собственных уравнений у них нет
+        std::vector<char> getConstrainedDofs() const
+        {
+            std::vector<char> constrained(nodes.size() * FiniteElement::nNodeDofs, 0);
+            for (Size c = 0; c < constraints.size(); ++c)
+            {
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                    constrained[constraints(c).node * FiniteElement::nNodeDofs + d] = 1;
+            }
+            return constrained;
+        }
+
+        // Заданные перемещения узлов в порядке узлов
+        Prescribed getPrescribedDofs() const
+        {
+            Prescribed prescribed;
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                for (Size j = 0; j < nodes(i).disps.size(); ++j)
+                    prescribed.emplace_back(i * FiniteElement::nNodeDofs + nodes(i).disps(j).direction, nodes(i).disps(j).value);
+            }
+            return prescribed;
+        }
+
+        // Нагрузка на связанный узел передаётся его ведущим узлам
+        void transferConstraintLoads(Vector &F) const
+        {
+            for (Size c = 0; c < constraints.size(); ++c)
+            {
+                auto const &constraint = constraints(c);
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                {
+                    Size dof = constraint.node * FiniteElement::nNodeDofs + d;
+                    for (Size k = 0; k < constraint.masters.size(); ++k)
+                    {
+                        F(constraint.masters(k) * FiniteElement::nNodeDofs + d) += constraint.weights(k) * F(dof);
+                    }
+                    F(dof) = 0;
+                }
+            }
+        }
+
+        // Перемещения связанных узлов по перемещениям ведущих; у матрицы, например форм
+        // колебаний, связи применяются к каждому столбцу
+        template <typename Displacements>
+        void applyConstraints(Eigen::MatrixBase<Displacements> &u) const
+        {
+            for (Size c = 0; c < constraints.size(); ++c)
+            {
+                auto const &constraint = constraints(c);
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                {
+                    auto row = u.row(constraint.node * FiniteElement::nNodeDofs + d);
+                    row.setZero();
+                    for (Size k = 0; k < constraint.masters.size(); ++k)
+                    {
+                        row += constraint.weights(k) * u.row(constraint.masters(k) * FiniteElement::nNodeDofs + d);
+                    }
+                }
+            }
+        }
+
+        // Таблица материалов и номера материалов элементов; без номеров у всех элементов материал 0
+        bool setMaterials(Materials newMaterials, MaterialIds newMaterialIds = MaterialIds())
+        {
+            if (newMaterialIds.size() != 0 && newMaterialIds.size() != elements.size())
+            {
+                std::cerr << "Error: number of material IDs differs from number of elements!" << std::endl;
+                return false;
+            }
+            for (Size e = 0; e < newMaterialIds.size(); ++e)
+            {
+                if (newMaterialIds(e) >= newMaterials.size())
+                {
+                    std::cerr << "Error: element " << e << " refers to missing material " << newMaterialIds(e) << std::endl;
+                    return false;
+                }
+            }
+            materials = std::move(newMaterials);
+            materialIds = std::move(newMaterialIds);
+            return true;
+        }
+
+        const Materials &getMaterials() const
+        {
+            return materials;
+        }
+
+        const MaterialIds &getMaterialIds() const
+        {
+            return materialIds;
+        }
+
+        MaterialId getMaterialId(Size const &e) const
+        {
+            return materialIds.size() != 0 ? materialIds(e) : 0;
+        }
+
+        // Материал элемента e; таблица материалов должна быть задана
+        const Material &getElementMaterial(Size const &e) const
+        {
+            return materials[this->getMaterialId(e)];
+        }
+
+        bool checkMaterialTable() const
+        {
+            if (!materials.empty())
+                return true;
+            std::cerr << "Error: material table is empty, call setMaterials first!" << std::endl;
+            return false;
+        }
+
+        // Расчёт с одним материалом (E, nu) на всю сетку неприменим к сетке с несколькими материалами
+        bool checkSingleMaterial(char const *analysis) const
+        {
+            if (materials.size() <= 1)
+                return true;
+            std::cerr << "Error: " << analysis << " with a single material would ignore the " << materials.size()
+                      << " materials of the mesh, use the material table instead!" << std::endl;
+            return false;
+        }
+
+        // Группы элементов с одним материалом и одинаковыми размерами a x b (с относительным
+        // допуском tolerance): их матрицы совпадают и вычисляются один раз на группу.
+        // elementGroups(e) - группа элемента e, representatives(g) - элемент, по которому считается группа g
+        void calculateElementGroups(Indices &elementGroups, Indices &representatives,
+                                    Value const &tolerance = std::sqrt(Eigen::NumTraits<Value>::epsilon())) const
+        {
+            Size nElements = elements.size();
+            FiniteElement fe;
+            typename FiniteElement::Nodes feNodes;
+            typename FiniteElement::Coordinates lsX, lsY;
+            std::vector<Value> widths(nElements), heights(nElements);
+            for (Size e = 0; e < nElements; ++e)
+            {
+                this->getElementNodes(feNodes, e);
+                fe.findLimits(lsX, lsY, feNodes);
+                widths[e] = lsX(1) - lsX(0);
+                heights[e] = lsY(1) - lsY(0);
+            }
+
+            // Классы ширины внутри материала, затем группы высоты внутри класса
+            std::vector<Size> order(nElements), widthClasses(nElements);
+            for (Size e = 0; e < nElements; ++e)
+                order[e] = e;
+            std::sort(order.begin(), order.end(), [&](Size const &l, Size const &r)
+                      { return std::make_tuple(this->getMaterialId(l), widths[l], l) < std::make_tuple(this->getMaterialId(r), widths[r], r); });
+            Value reference = 0;
+            Size widthClass = 0;
+            for (Size k = 0; k < nElements; ++k)
+            {
+                Size e = order[k];
+                if (k == 0 || this->getMaterialId(e) != this->getMaterialId(order[k - 1]) || widths[e] > reference * (1 + tolerance))
+                {
+                    reference = widths[e];
+                    widthClass += k != 0;
+                }
+                widthClasses[e] = widthClass;
+            }
+            std::sort(order.begin(), order.end(), [&](Size const &l, Size const &r)
+                      { return std::make_tuple(widthClasses[l], heights[l], l) < std::make_tuple(widthClasses[r], heights[r], r); });
+
+            elementGroups.resize(nElements);
+            std::vector<Size> firsts;
+            for (Size k = 0; k < nElements; ++k)
+            {
+                Size e = order[k];
+                if (k == 0 || widthClasses[e] != widthClasses[order[k - 1]] || heights[e] > reference * (1 + tolerance))
+                {
+                    reference = heights[e];
+                    firsts.push_back(e);
+                }
+                elementGroups(e) = firsts.size() - 1;
+            }
+            representatives = Eigen::Map<const Indices>(firsts.data(), firsts.size());
+        }
+
+        bool calculateStiffnessMatrix(
+            Value const &elasticityModulus,
+            Value const &poissonRatio)
+        {
+            FEM_PROFILE("stiffness matrix");
+            if (!this->checkSingleMaterial("stiffness matrix assembly"))
+                return false;
+            typename FiniteElement::Nodes feNodes;
+            typename FiniteElement::StiffnessMatrix sm;
+            return this->assembleStiffnessMatrix([&](Size const &e) -> typename FiniteElement::StiffnessMatrix const &
+                                                 {
+                                                     this->getElementNodes(feNodes, e);
+                                                     fe.calculateStiffnessMatrix(sm, feNodes, elasticityModulus, poissonRatio);
+                                                     return sm; });
+        }
+
+        // Сборка по таблице материалов: матрица элемента вычисляется один раз на группу
+        bool calculateStiffnessMatrix()
+        {
+            FEM_PROFILE("stiffness matrix");
+            ElementMatrices groupMatrices;
+            Indices groups;
+            if (!this->calculateGroupStiffnessMatrices(groupMatrices, groups))
+                return false;
+            return this->assembleStiffnessMatrix([&](Size const &e) -> typename FiniteElement::StiffnessMatrix const &
+                                                 { return groupMatrices[groups(e)]; });
+        }
+
+        bool calculateSparseStiffnessMatrix()
+        {
+            FEM_PROFILE("sparse stiffness matrix");
+            ElementMatrices groupMatrices;
+            Indices groups;
+            if (!this->calculateGroupStiffnessMatrices(groupMatrices, groups))
+                return false;
+            return this->assembleSparseStiffnessMatrix([&](Size const &e) -> typename FiniteElement::StiffnessMatrix const &
+                                                       { return groupMatrices[groups(e)]; });
+        }
+
+        // Сборка по таблице материалов в matrix; собственные матрицы сетки не меняются
+        bool calculateSparseStiffnessMatrix(SparseMatrix &matrix) const
+        {
+            FEM_PROFILE("sparse stiffness matrix");
+            FiniteElement fe;
+            ElementMatrices groupMatrices;
+            Indices groups;
+            if (!this->calculateGroupMatrices(groupMatrices, groups, [&](typename FiniteElement::StiffnessMatrix &sm, typename FiniteElement::Nodes const &feNodes, Material const &material)
+                                              { fe.calculateStiffnessMatrix(sm, feNodes, material.elasticityModulus, material.poissonRatio); }))
+                return false;
+            return this->assembleSparseMatrix(matrix, [&](Size const &e) -> typename FiniteElement::StiffnessMatrix const &
+                                              { return groupMatrices[groups(e)]; },
+                                              Value(1));
+        }
+
+        // Разреженная сборка: память и время пропорциональны числу элементов, а не (2N)^2
+        bool calculateSparseStiffnessMatrix(
             Value const &elasticityModulus,
             Value const &poissonRatio)
         {
+            FEM_PROFILE("sparse stiffness matrix");
+            if (!this->checkSingleMaterial("stiffness matrix assembly"))
+                return false;
             typename FiniteElement::Nodes feNodes;
-            for (Size i = 0; i < feNodes.size(); ++i)
+            typename FiniteElement::StiffnessMatrix sm;
+            return this->assembleSparseStiffnessMatrix([&](Size const &e) -> typename FiniteElement::StiffnessMatrix const &
+                                                       {
+                                                           this->getElementNodes(feNodes, e);
+                                                           fe.calculateStiffnessMatrix(sm, feNodes, elasticityModulus, poissonRatio);
+                                                           return sm; });
+        }
+
+        // Части разреженной матрицы жёсткости K(E, nu) = E / (1 - nu^2) (K0 + nu K1) с одинаковой
+        // структурой; связанные степени свободы получают 1 на диагонали K0 и 0 у K1
+        bool calculateAffineStiffnessMatrices(SparseMatrix &K0, SparseMatrix &K1) const
+        {
+            FEM_PROFILE("affine stiffness matrices");
+            FiniteElement fe;
+            typename FiniteElement::Nodes feNodes;
+            typename FiniteElement::StiffnessMatrix sm0, sm1;
+            return this->assembleSparseMatrix(K0, [&](Size const &e) -> typename FiniteElement::StiffnessMatrix const &
+                                              {
+                                                  this->getElementNodes(feNodes, e);
+                                                  fe.calculateAffineStiffnessMatrices(sm0, sm1, feNodes);
+                                                  return sm0; },
+                                              Value(1)) &&
+                   this->assembleSparseMatrix(K1, [&](Size const &e) -> typename FiniteElement::StiffnessMatrix const &
+                                              {
+                                                  this->getElementNodes(feNodes, e);
+                                                  fe.calculateAffineStiffnessMatrices(sm0, sm1, feNodes);
+                                                  return sm1; },
+                                              Value(0));
+        }
+
+        // Сборка из готовых матриц элементов: elementMatrix(e) возвращает матрицу жёсткости элемента e.
+        // Сборка отклоняется, если плотная матрица не помещается в бюджет памяти
+        template <typename ElementMatrix>
+        bool assembleStiffnessMatrix(ElementMatrix const &elementMatrix)
+        {
+            Size nDofs = nodes.size() * FiniteElement::nNodeDofs;
+            if (stiffnessMatrix.size() != Eigen::Index(nDofs * nDofs) &&
+                !this->admitMemory(nDofs * nDofs * sizeof(Value), "dense stiffness matrix assembly"))
+                return false;
+            stiffnessMatrix.setZero(nDofs, nDofs);
+
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                auto const &sm = elementMatrix(e);
+                this->scatterElementMatrix(e, sm, [&](Size const &dofI, Size const &dofJ, Value const &value)
+                                           { stiffnessMatrix(dofI, dofJ) += value; });
+            }
+            for (Size c = 0; c < constraints.size(); ++c)
             {
-                feNodes(i) = nodes(i).coords;
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                {
+                    Size dof = constraints(c).node * FiniteElement::nNodeDofs + d;
+                    stiffnessMatrix(dof, dof) = 1;
+                }
             }
+            return true;
+        }
 
-            typename FiniteElement::StiffnessMatrix sm;
-            fe.calculateStiffnessMatrix(sm, feNodes, elasticityModulus, poissonRatio);
+        template <typename ElementMatrix>
+        bool assembleSparseStiffnessMatrix(ElementMatrix const &elementMatrix)
+        {
+            // Связанные степени свободы исключены из системы: на диагонали остаётся единица
+            return this->assembleSparseMatrix(sparseStiffnessMatrix, elementMatrix, Value(1));
+        }
 
-            stiffnessMatrix = sm;
+        // Разреженная матрица масс (согласованная или сосредоточенная) с той же структурой,
+        // что и матрица жёсткости; у связанных степеней свободы масса нулевая
+        bool calculateSparseMassMatrix(Value const &density, bool const &lumped = false)
+        {
+            FEM_PROFILE("mass matrix");
+            if (!this->checkSingleMaterial("mass matrix assembly"))
+                return false;
+            typename FiniteElement::Nodes feNodes;
+            typename FiniteElement::MassMatrix mm;
+            return this->assembleSparseMatrix(sparseMassMatrix, [&](Size const &e) -> typename FiniteElement::MassMatrix const &
+                                              {
+                                                  this->getElementNodes(feNodes, e);
+                                                  if (lumped)
+                                                      fe.calculateLumpedMassMatrix(mm, feNodes, density);
+                                                  else
+                                                      fe.calculateMassMatrix(mm, feNodes, density);
+                                                  return mm; },
+                                              Value(0));
+        }
+
+        // Матрица масс по плотностям из таблицы материалов
+        bool calculateSparseMassMatrixFromMaterials(bool const &lumped = false)
+        {
+            FEM_PROFILE("mass matrix");
+            ElementMatrices groupMatrices;
+            Indices groups;
+            if (!this->calculateGroupMatrices(groupMatrices, groups, [&](typename FiniteElement::MassMatrix &mm, typename FiniteElement::Nodes const &feNodes, Material const &material)
+                                              {
+                                                  if (lumped)
+                                                      fe.calculateLumpedMassMatrix(mm, feNodes, material.density);
+                                                  else
+                                                      fe.calculateMassMatrix(mm, feNodes, material.density); }))
+                return false;
+            return this->assembleSparseMatrix(sparseMassMatrix, [&](Size const &e) -> typename FiniteElement::MassMatrix const &
+                                              { return groupMatrices[groups(e)]; },
+                                              Value(0));
         }
 
         void calculateForceVector()
         {
+            FEM_PROFILE("force vector");
             forceVector.setZero();
 
             for (Size i = 0; i < nodes.size(); ++i)
@@ -104,10 +656,20 @@ namespace fem
                     }
                 }
             }
+
+            this->transferConstraintLoads(forceVector);
         }
 
-        void calculateDisplacementVector()
+        bool calculateDisplacementVector()
         {
+            FEM_PROFILE("dense solve");
+            if (stiffnessMatrix.rows() != Eigen::Index(nodes.size() * FiniteElement::nNodeDofs))
+            {
+                std::cerr << "Error: dense stiffness matrix is not assembled!" << std::endl;
+                return false;
+            }
+            if (!this->admitSolve(LinearSolver::Dense))
+                return false;
             Matrix K = stiffnessMatrix;
             Vector F = forceVector;
 
@@ -119,6 +681,8 @@ namespace fem
                     for (Size j = 0; j < disps.size(); ++j)
                     {
                         Size dof = i * FiniteElement::nNodeDofs + disps(j).direction;
+                        // Заданное перемещение переносится в правую часть остальных уравнений
+                        F -= K.col(dof) * disps(j).value;
                         K.row(dof).setZero();
                         K.col(dof).setZero();
                         K(dof, dof) = 1.0;
@@ -127,17 +691,386 @@ namespace fem
                 }
             }
 
-            displacementVector = K.lu().solve(F);
+            Eigen::PartialPivLU<Matrix> lu;
+            {
+                FEM_PROFILE("factorization");
+                lu.compute(K);
+            }
+            displacementVector = lu.solve(F);
+            this->applyConstraints(displacementVector);
+            return true;
         }
 
-        void writeParaViewVtk()
+        // Прямое решение по разреженной матрице (разложение LDL^T)
+        bool calculateSparseDisplacementVector()
         {
-            std::ofstream vtk("output.vtk");
+            FEM_PROFILE("sparse direct solve");
+            if (!this->isSparseStiffnessMatrixAssembled() || !this->admitSolve(LinearSolver::SparseDirect))
+                return false;
+            SparseMatrix K = sparseStiffnessMatrix;
+            Vector F = forceVector;
+            this->applyBoundaryConditions(K, F);
+
+            Eigen::SimplicialLDLT<SparseMatrix> solver;
+            {
+                FEM_PROFILE("factorization");
+                solver.compute(K);
+            }
+            if (solver.info() != Eigen::Success)
+            {
+                std::cerr << "Error: stiffness matrix factorization failed!" << std::endl;
+                return false;
+            }
+            {
+                FEM_PROFILE("triangular solves");
+                displacementVector = solver.solve(F);
+            }
+            this->applyConstraints(displacementVector);
+            return true;
+        }
+
+        // Метод сопряжённых градиентов по разреженной матрице с начальным приближением,
+        // например решением на предыдущей сетке
+        bool calculateIterativeDisplacementVector(Eigen::Ref<const Vector> const &initialGuess,
+                                                  Value const &tolerance = std::sqrt(Eigen::NumTraits<Value>::epsilon()))
+        {
+            FEM_PROFILE("conjugate gradients");
+            if (!this->isSparseStiffnessMatrixAssembled() || !this->admitSolve(LinearSolver::ConjugateGradients))
+                return false;
+            SparseMatrix K = sparseStiffnessMatrix;
+            Vector F = forceVector;
+            this->applyBoundaryConditions(K, F);
+
+            Eigen::ConjugateGradient<SparseMatrix, Eigen::Lower | Eigen::Upper> solver(K);
+            solver.setTolerance(tolerance);
+            {
+                FEM_PROFILE("iterations");
+                displacementVector = solver.solveWithGuess(F, initialGuess);
+            }
+            solverIterations = solver.iterations();
+            this->applyConstraints(displacementVector);
+            if (solver.info() != Eigen::Success)
+            {
+                std::cerr << "Warning: conjugate gradients stopped after " << solverIterations
+                          << " iterations with error " << solver.error() << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Сопряжённые градиенты с матрицей, хранимой в precision (bfloat16 или float), и векторами
+        // в double: итерация ограничена трафиком памяти при умножении на матрицу, который сжатое
+        // хранение уменьшает. Невязка проверяется по исходной матрице, и при застое точность
+        // хранения повышается (см. ReducedPrecisionCg)
+        bool calculateReducedPrecisionDisplacementVector(Eigen::Ref<const Vector> const &initialGuess,
+                                                         StoragePrecision const &precision = StoragePrecision::Float,
+                                                         double const &tolerance = std::sqrt(Eigen::NumTraits<Value>::epsilon()))
+        {
+            FEM_PROFILE("reduced-precision conjugate gradients");
+            if (!this->isSparseStiffnessMatrixAssembled())
+                return false;
+            SparseMatrix K = sparseStiffnessMatrix;
+            Vector F = forceVector;
+            this->applyBoundaryConditions(K, F);
+
+            ReducedPrecisionCg<Value> solver(K, precision, FiniteElement::nNodeDofs);
+            Eigen::VectorXd u = initialGuess.template cast<double>();
+            bool converged = solver.solve(u, F.template cast<double>(), tolerance);
+            solverIterations = solver.getIterations();
+            storagePrecision = solver.getPrecision();
+            displacementVector = u.cast<Value>();
+            this->applyConstraints(displacementVector);
+            return converged;
+        }
+
+        // Смешанная точность: LDL^T раскладывается во float (вдвое меньше памяти и трафика),
+        // невязки и поправки считаются в double. Уточнение - сопряжённые градиенты в double с
+        // разложением во float как предобуславливателем: в отличие от простого уточнения
+        // u += (LDL^T)^-1 r они сходятся и при обусловленности K порядка 1 / eps_float.
+        // Итерации идут, пока нормированная обратная погрешность ||F - K u|| / (||K|| ||u|| + ||F||)
+        // выше tolerance; если за stallIterations итераций она не уменьшилась вдвое, матрица
+        // раскладывается в double. Результат округляется до Value
+        bool calculateMixedPrecisionDisplacementVector(double const &tolerance = 4 * Eigen::NumTraits<double>::epsilon(),
+                                                       Size const &maxIterations = 100)
+        {
+            FEM_PROFILE("mixed-precision solve");
+            using HighMatrix = Eigen::SparseMatrix<double>;
+            using HighVector = Eigen::VectorXd;
+            Size const stallIterations = 5;
+            if (!this->isSparseStiffnessMatrixAssembled() || !this->admitSolve(LinearSolver::MixedPrecision))
+                return false;
+            HighMatrix K = sparseStiffnessMatrix.template cast<double>();
+            HighVector F = forceVector.template cast<double>();
+            this->applyBoundaryConditions(K, F);
+
+            // ||K||_inf по строкам; матрица симметрична, поэтому суммы по столбцам те же
+            double matrixNorm = 0;
+            for (Eigen::Index j = 0; j < K.outerSize(); ++j)
+            {
+                double sum = 0;
+                for (typename HighMatrix::InnerIterator it(K, j); it; ++it)
+                    sum += std::abs(it.value());
+                matrixNorm = std::max(matrixNorm, sum);
+            }
+            double forceNorm = F.cwiseAbs().maxCoeff();
+            auto backward = [&](HighVector const &r, HighVector const &u)
+            {
+                double scale = matrixNorm * u.cwiseAbs().maxCoeff() + forceNorm;
+                return scale > 0 ? r.cwiseAbs().maxCoeff() / scale : 0.0;
+            };
+
+            Eigen::SimplicialLDLT<Eigen::SparseMatrix<float>> lowSolver;
+            {
+                FEM_PROFILE("factorization");
+                lowSolver.compute(K.cast<float>());
+            }
+            // Невязка нормируется, чтобы её малые компоненты не терялись во float
+            auto precondition = [&](HighVector const &r)
+            {
+                double norm = r.cwiseAbs().maxCoeff();
+                return norm > 0 ? HighVector(norm * lowSolver.solve((r / norm).cast<float>()).template cast<double>()) : HighVector(HighVector::Zero(r.size()));
+            };
+
+            HighVector u = HighVector::Zero(F.size()), r = F;
+            solverIterations = 0;
+            backwardError = backward(r, u);
+            bool converged = backwardError <= tolerance;
+            if (!converged && lowSolver.info() == Eigen::Success)
+            {
+                HighVector z = precondition(r), p = z, q;
+                double rz = r.dot(z), best = backwardError;
+                Size bestIteration = 0;
+                while (solverIterations < maxIterations && solverIterations - bestIteration < stallIterations)
+                {
+                    FEM_PROFILE("refinement iteration");
+                    q = K * p;
+                    double alpha = rz / p.dot(q);
+                    u += alpha * p;
+                    r = F - K * u;
+                    ++solverIterations;
+                    backwardError = backward(r, u);
+                    if (backwardError <= tolerance)
+                    {
+                        converged = true;
+                        break;
+                    }
+                    if (backwardError <= best / 2)
+                    {
+                        best = backwardError;
+                        bestIteration = solverIterations;
+                    }
+                    z = precondition(r);
+                    double rzNext = r.dot(z);
+                    p = z + (rzNext / rz) * p;
+                    rz = rzNext;
+                }
+            }
+            if (!converged)
+            {
+                std::cerr << "Warning: mixed-precision refinement stagnated at backward error " << backwardError
+                          << ", refactorizing in double precision" << std::endl;
+                Eigen::SimplicialLDLT<HighMatrix> highSolver;
+                {
+                    FEM_PROFILE("factorization");
+                    highSolver.compute(K);
+                }
+                if (highSolver.info() != Eigen::Success)
+                {
+                    std::cerr << "Error: stiffness matrix factorization failed!" << std::endl;
+                    return false;
+                }
+                u = highSolver.solve(F);
+                r = F - K * u;
+                u += highSolver.solve(r);
+                r = F - K * u;
+                backwardError = backward(r, u);
+                ++solverIterations;
+            }
+            displacementVector = u.cast<Value>();
+            this->applyConstraints(displacementVector);
+            return true;
+        }
+
+        Size getSolverIterations() const
+        {
+            return solverIterations;
+        }
+
+        // Обратная погрешность последнего решения в смешанной точности
+        double getBackwardError() const
+        {
+            return backwardError;
+        }
+
+        // Точность хранения матрицы, с которой завершились сопряжённые градиенты пониженной точности
+        StoragePrecision getStoragePrecision() const
+        {
+            return storagePrecision;
+        }
+
+        // Память, занятая сеткой сейчас. Разложения и копии матриц живут только внутри решателей,
+        // их размер предсказывает estimateSolveFootprint
+        MemoryUsage getMemoryUsage() const
+        {
+            MemoryUsage usage;
+            usage.nodes = nodes.size() * sizeof(Node);
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                usage.nodes += (nodes(i).forces.size() + nodes(i).disps.size()) * sizeof(Cond);
+            }
+            usage.elements = elements.size() * sizeof(Element);
+            for (auto const &nodeSet : nodeSets)
+            {
+                // Узел дерева std::map: значение и три указателя с цветом
+                usage.nodeSets += sizeof(nodeSet) + 4 * sizeof(void *) + nodeSet.first.capacity() + nodeSet.second.size() * sizeof(Size);
+            }
+            usage.constraints = constraints.size() * sizeof(Constraint) + constraintIndices.size() * sizeof(Size);
+            for (Size c = 0; c < constraints.size(); ++c)
+            {
+                usage.constraints += constraints(c).masters.size() * sizeof(Size) + constraints(c).weights.size() * sizeof(Value);
+            }
+            usage.materials = materials.capacity() * sizeof(Material) + materialIds.size() * sizeof(MaterialId);
+            usage.stiffnessMatrix = stiffnessMatrix.size() * sizeof(Value);
+            usage.sparseStiffnessMatrix = getSparseMatrixBytes(sparseStiffnessMatrix);
+            usage.sparseMassMatrix = getSparseMatrixBytes(sparseMassMatrix);
+            usage.vectors = (forceVector.size() + displacementVector.size()) * sizeof(Value);
+            return usage;
+        }
+
+        // Оценка памяти решения до выделения. Число ненулевых разреженной матрицы берётся из собранной
+        // матрицы или из графа связей узлов; заполнение разложения LDL^T считается символически по
+        // графу узлов, упорядоченному AMD, как в Eigen::SimplicialLDLT. Для смешанной точности
+        // учитывается только разложение во float, без запасного разложения в double
+        SolveFootprint estimateSolveFootprint(LinearSolver const &solver) const
+        {
+            FEM_PROFILE("solve footprint estimate");
+            using StorageIndex = typename SparseMatrix::StorageIndex;
+            Size nDofs = nodes.size() * FiniteElement::nNodeDofs;
+            SolveFootprint footprint;
+            if (solver == LinearSolver::Dense)
+            {
+                Size matrixBytes = nDofs * nDofs * sizeof(Value);
+                if (stiffnessMatrix.size() != Eigen::Index(nDofs * nDofs))
+                    footprint.assembly = matrixBytes;
+                footprint.matrix = matrixBytes;
+                // PartialPivLU хранит LU на месте копии матрицы и две перестановки
+                footprint.factor = matrixBytes + 2 * nDofs * sizeof(int);
+                footprint.vectors = 3 * nDofs * sizeof(Value);
+                return footprint;
+            }
+
+            Eigen::SparseMatrix<int> nodeGraph;
+            Size nonZeros = sparseStiffnessMatrix.nonZeros();
+            bool direct = solver == LinearSolver::SparseDirect || solver == LinearSolver::MixedPrecision;
+            if (nonZeros == 0 || direct)
+                this->calculateNodeGraph(nodeGraph);
+            if (nonZeros == 0)
+            {
+                Eigen::VectorXi columnSizes = this->getColumnSizes();
+                footprint.assembly = estimateSparseMatrixBytes<Value>(columnSizes.template cast<Size>().sum(), nDofs) + nDofs * sizeof(StorageIndex);
+                nonZeros = Size(nodeGraph.nonZeros()) * FiniteElement::nNodeDofs * FiniteElement::nNodeDofs;
+            }
+
+            switch (solver)
+            {
+            case LinearSolver::SparseDirect:
+                footprint.matrix = estimateSparseMatrixBytes<Value>(nonZeros, nDofs);
+                footprint.factor = estimateFactorBytes<Value>(this->estimateFactorNonZeros(nodeGraph), nonZeros, nDofs);
+                footprint.vectors = 3 * nDofs * sizeof(Value);
+                break;
+            case LinearSolver::MixedPrecision:
+                // Копии в double и во float, разложение во float
+                footprint.matrix = estimateSparseMatrixBytes<double>(nonZeros, nDofs) + estimateSparseMatrixBytes<float>(nonZeros, nDofs);
+                footprint.factor = estimateFactorBytes<float>(this->estimateFactorNonZeros(nodeGraph), nonZeros, nDofs);
+                footprint.vectors = 8 * nDofs * sizeof(double);
+                break;
+            default:
+                // Eigen::ConjugateGradient: невязка, направление, предобусловленная невязка, произведение,
+                // обратная диагональ, решение и правая часть
+                footprint.matrix = estimateSparseMatrixBytes<Value>(nonZeros, nDofs);
+                footprint.vectors = 7 * nDofs * sizeof(Value);
+                break;
+            }
+            return footprint;
+        }
+
+        // Бюджет памяти сетки вместе с решением, байт; 0 - без ограничения. Сборка и решения,
+        // которые выйдут за бюджет, отклоняются до выделения памяти
+        void setMemoryBudget(Size const &bytes)
+        {
+            memoryBudget = bytes;
+        }
+
+        Size getMemoryBudget() const
+        {
+            return memoryBudget;
+        }
+
+        // Заменяет solver первым из более экономных решателей (Dense -> SparseDirect ->
+        // MixedPrecision -> ConjugateGradients), решение которым укладывается в бюджет памяти
+        bool selectSolver(LinearSolver &solver) const
+        {
+            if (memoryBudget == 0)
+                return true;
+            Size inUse = this->getMemoryUsage().total();
+            for (int s = int(solver); s <= int(LinearSolver::ConjugateGradients); ++s)
+            {
+                LinearSolver candidate = LinearSolver(s);
+                Size required = this->estimateSolveFootprint(candidate).total();
+                if (inUse + required <= memoryBudget)
+                {
+                    if (candidate != solver)
+                        std::cerr << "Warning: " << getLinearSolverName(solver) << " solve does not fit the memory budget of "
+                                  << toMegabytes(memoryBudget) << " MB, using " << getLinearSolverName(candidate)
+                                  << " (" << toMegabytes(required) << " MB)" << std::endl;
+                    solver = candidate;
+                    return true;
+                }
+            }
+            std::cerr << "Error: no solver fits the memory budget of " << toMegabytes(memoryBudget) << " MB with "
+                      << toMegabytes(inUse) << " MB in use!" << std::endl;
+            return false;
+        }
+
+        // Решение выбранным решателем или более экономным, если на него не хватает бюджета памяти.
+        // Плотная матрица для прямого решения при необходимости строится из разреженной
+        bool calculateDisplacementVector(LinearSolver solver)
+        {
+            if (!this->selectSolver(solver))
+                return false;
+            Size nDofs = nodes.size() * FiniteElement::nNodeDofs;
+            if (solver == LinearSolver::Dense && stiffnessMatrix.rows() != Eigen::Index(nDofs) && sparseStiffnessMatrix.nonZeros() != 0)
+                stiffnessMatrix = Matrix(sparseStiffnessMatrix);
+            switch (solver)
+            {
+            case LinearSolver::Dense:
+                return this->calculateDisplacementVector();
+            case LinearSolver::SparseDirect:
+                return this->calculateSparseDisplacementVector();
+            case LinearSolver::MixedPrecision:
+                return this->calculateMixedPrecisionDisplacementVector();
+            default:
+                return this->calculateIterativeDisplacementVector(Vector::Zero(nDofs));
+            }
+        }
+
+        void writeParaViewVtk(const std::string &filename = "output.vtk") const
+        {
+            FEM_PROFILE("write VTK");
+            std::ofstream vtk(filename);
             if (!vtk.is_open())
             {
-                std::cerr << "Error: Could not open output.vtk for writing!" << std::endl;
+                std::cerr << "Error: Could not open " << filename << " for writing!" << std::endl;
                 return;
             }
+            this->writeParaViewVtk(vtk);
+            vtk.close();
+            std::cout << "Successfully wrote " << filename << std::endl;
+        }
+
+        // Геометрия и перемещения; после них в поток можно дописать другие поля POINT_DATA
+        void writeParaViewVtk(std::ostream &vtk) const
+        {
             vtk << "# vtk DataFile Version 3.0\n";
             vtk << "Finite Element Solution\n";
             vtk << "ASCII\n";
@@ -149,11 +1082,22 @@ namespace fem
                 vtk << nodes(i).coords(0) << " " << nodes(i).coords(1) << " 0.0\n";
             }
 
-            vtk << "\nCELLS " << nElems << " " << nElems * 5 << "\n";
-            vtk << "4 0 1 2 3\n";
+            vtk << "\nCELLS " << elements.size() << " " << elements.size() * (FiniteElement::nNodes + 1) << "\n";
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                vtk << FiniteElement::nNodes;
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                {
+                    vtk << " " << elements(e)(i);
+                }
+                vtk << "\n";
+            }
 
-            vtk << "\nCELL_TYPES " << nElems << "\n";
-            vtk << "9\n";
+            vtk << "\nCELL_TYPES " << elements.size() << "\n";
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                vtk << "9\n";
+            }
 
             vtk << "\nPOINT_DATA " << nodes.size() << "\n";
             vtk << "VECTORS displacement float\n";
@@ -162,14 +1106,385 @@ namespace fem
                 vtk << displacementVector(FiniteElement::nNodeDofs * i) << " "
                     << displacementVector(FiniteElement::nNodeDofs * i + 1) << " 0.0\n";
             }
-            vtk.close();
-            std::cout << "Successfully wrote output.vtk" << std::endl;
+        }
+
+        void getElementNodes(typename FiniteElement::Nodes &feNodes, Size const &e) const
+        {
+            for (Size i = 0; i < FiniteElement::nNodes; ++i)
+            {
+                feNodes(i) = nodes(elements(e)(i)).coords;
+            }
+        }
+
+        // Смежность узел -> элементы в виде CSR: элементы узла i лежат в adjacentElements[offsets(i), offsets(i + 1))
+        void calculateNodeElements(Indices &offsets, Indices &adjacentElements) const
+        {
+            offsets.setZero(nodes.size() + 1);
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                {
+                    ++offsets(elements(e)(i) + 1);
+                }
+            }
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                offsets(i + 1) += offsets(i);
+            }
+            adjacentElements.resize(offsets(nodes.size()));
+            Indices next = offsets.head(nodes.size());
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                {
+                    adjacentElements(next(elements(e)(i))++) = e;
+                }
+            }
+        }
+
+        // Узлы на рёбрах, принадлежащих только одному элементу, в порядке возрастания номеров
+        void calculateBoundaryNodes(Indices &boundaryNodes) const
+        {
+            std::map<std::pair<Size, Size>, Size> edgeCounts;
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                {
+                    Size a = elements(e)(i), b = elements(e)((i + 1) % FiniteElement::nNodes);
+                    ++edgeCounts[std::make_pair(std::min(a, b), std::max(a, b))];
+                }
+            }
+            std::vector<char> onBoundary(nodes.size(), 0);
+            for (auto const &edge : edgeCounts)
+            {
+                if (edge.second == 1)
+                {
+                    onBoundary[edge.first.first] = 1;
+                    onBoundary[edge.first.second] = 1;
+                }
+            }
+            std::vector<Size> list;
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                if (onBoundary[i])
+                    list.push_back(i);
+            }
+            boundaryNodes = Eigen::Map<Indices>(list.data(), list.size());
+        }
+
+        // Глобальный номер степени свободы i элемента e
+        Size getElementDof(Size const &e, Size const &i) const
+        {
+            return elements(e)(i / FiniteElement::nNodeDofs) * FiniteElement::nNodeDofs + i % FiniteElement::nNodeDofs;
         }
 
     private:
+        static Size const unconstrained = ~Size(0);
+
+        using ElementMatrices = std::vector<typename FiniteElement::StiffnessMatrix, Eigen::aligned_allocator<typename FiniteElement::StiffnessMatrix>>;
+
+        // Матрицы групп элементов: calculate(matrix, nodes, material) для представителя каждой группы
+        template <typename Calculate>
+        bool calculateGroupMatrices(ElementMatrices &groupMatrices, Indices &groups, Calculate const &calculate) const
+        {
+            if (!this->checkMaterialTable())
+                return false;
+            Indices representatives;
+            this->calculateElementGroups(groups, representatives);
+            typename FiniteElement::Nodes feNodes;
+            groupMatrices.resize(representatives.size());
+            for (Size g = 0; g < representatives.size(); ++g)
+            {
+                this->getElementNodes(feNodes, representatives(g));
+                calculate(groupMatrices[g], feNodes, materials[this->getMaterialId(representatives(g))]);
+            }
+            return true;
+        }
+
+        bool calculateGroupStiffnessMatrices(ElementMatrices &groupMatrices, Indices &groups)
+        {
+            return this->calculateGroupMatrices(groupMatrices, groups, [&](typename FiniteElement::StiffnessMatrix &sm, typename FiniteElement::Nodes const &feNodes, Material const &material)
+                                                { fe.calculateStiffnessMatrix(sm, feNodes, material.elasticityModulus, material.poissonRatio); });
+        }
+
+        // Вызывает function(dof, weight) для степеней свободы, через которые выражается
+        // степень свободы i элемента e: для свободного узла это она сама с весом 1
+        template <typename Function>
+        void forEachElementDof(Size const &e, Size const &i, Function const &function) const
+        {
+            Size node = elements(e)(i / FiniteElement::nNodeDofs), direction = i % FiniteElement::nNodeDofs;
+            Size c = constraints.size() != 0 ? constraintIndices(node) : unconstrained;
+            if (c == unconstrained)
+            {
+                function(node * FiniteElement::nNodeDofs + direction, Value(1));
+                return;
+            }
+            auto const &constraint = constraints(c);
+            for (Size k = 0; k < constraint.masters.size(); ++k)
+            {
+                function(constraint.masters(k) * FiniteElement::nNodeDofs + direction, constraint.weights(k));
+            }
+        }
+
+        template <typename ElementMatrix, typename Add>
+        void scatterElementMatrix(Size const &e, ElementMatrix const &sm, Add const &add) const
+        {
+            for (Size j = 0; j < FiniteElement::nElemDofs; ++j)
+            {
+                this->forEachElementDof(e, j, [&](Size const &dofJ, Value const &weightJ)
+                                        {
+                                            for (Size i = 0; i < FiniteElement::nElemDofs; ++i)
+                                            {
+                                                this->forEachElementDof(e, i, [&](Size const &dofI, Value const &weightI)
+                                                                        { add(dofI, dofJ, weightI * weightJ * sm(i, j)); });
+                                            } });
+            }
+        }
+
+        template <typename ElementMatrix>
+        bool assembleSparseMatrix(SparseMatrix &matrix, ElementMatrix const &elementMatrix, Value const &constrainedDiagonal) const
+        {
+            Size nDofs = nodes.size() * FiniteElement::nNodeDofs;
+            Eigen::VectorXi columnSizes = this->getColumnSizes();
+            // Память под ранее собранную матрицу используется повторно
+            if (matrix.nonZeros() == 0 &&
+                !this->admitMemory(estimateSparseMatrixBytes<Value>(columnSizes.template cast<Size>().sum(), nDofs) + nDofs * sizeof(typename SparseMatrix::StorageIndex),
+                                   "sparse matrix assembly"))
+                return false;
+            matrix.resize(nDofs, nDofs);
+            matrix.reserve(columnSizes);
+
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                auto const &em = elementMatrix(e);
+                this->scatterElementMatrix(e, em, [&](Size const &dofI, Size const &dofJ, Value const &value)
+                                           { matrix.coeffRef(dofI, dofJ) += value; });
+            }
+            for (Size c = 0; c < constraints.size(); ++c)
+            {
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                {
+                    Size dof = constraints(c).node * FiniteElement::nNodeDofs + d;
+                    matrix.coeffRef(dof, dof) = constrainedDiagonal;
+                }
+            }
+            matrix.makeCompressed();
+            return true;
+        }
+
+        static double toMegabytes(Size const &bytes)
+        {
+            return bytes / double(1 << 20);
+        }
+
+        // Разреженные решатели требуют собранной матрицы: сборка могла быть отклонена бюджетом памяти
+        bool isSparseStiffnessMatrixAssembled() const
+        {
+            if (sparseStiffnessMatrix.rows() == Eigen::Index(nodes.size() * FiniteElement::nNodeDofs))
+                return true;
+            std::cerr << "Error: sparse stiffness matrix is not assembled!" << std::endl;
+            return false;
+        }
+
+        // Проверка бюджета памяти перед выделением bytes байт
+        bool admitMemory(Size const &bytes, char const *what) const
+        {
+            if (memoryBudget == 0)
+                return true;
+            Size inUse = this->getMemoryUsage().total();
+            if (inUse + bytes <= memoryBudget)
+                return true;
+            std::cerr << "Error: " << what << " needs " << toMegabytes(bytes) << " MB on top of " << toMegabytes(inUse)
+                      << " MB in use, exceeding the memory budget of " << toMegabytes(memoryBudget) << " MB!" << std::endl;
+            return false;
+        }
+
+        // Оценка решения строится только при заданном бюджете
+        bool admitSolve(LinearSolver const &solver) const
+        {
+            if (memoryBudget == 0)
+                return true;
+            std::string what = std::string(getLinearSolverName(solver)) + " solve";
+            return this->admitMemory(this->estimateSolveFootprint(solver).total(), what.c_str());
+        }
+
+        template <typename Scalar>
+        static Size getSparseMatrixBytes(Eigen::SparseMatrix<Scalar> const &matrix)
+        {
+            using StorageIndex = typename Eigen::SparseMatrix<Scalar>::StorageIndex;
+            Size bytes = matrix.data().allocatedSize() * (sizeof(Scalar) + sizeof(StorageIndex)) + (matrix.outerSize() + 1) * sizeof(StorageIndex);
+            if (!matrix.isCompressed())
+                bytes += matrix.outerSize() * sizeof(StorageIndex);
+            return bytes;
+        }
+
+        // Сжатая матрица CSC с nonZeros ненулевыми и n столбцами
+        template <typename Scalar>
+        static Size estimateSparseMatrixBytes(Size const &nonZeros, Size const &n)
+        {
+            using StorageIndex = typename Eigen::SparseMatrix<Scalar>::StorageIndex;
+            return nonZeros * (sizeof(Scalar) + sizeof(StorageIndex)) + (n + 1) * sizeof(StorageIndex);
+        }
+
+        // Eigen::SimplicialLDLT: L без диагонали, верхняя половина переставленной матрицы, D,
+        // рабочий вектор, две перестановки и четыре целочисленных рабочих массива
+        template <typename Scalar>
+        static Size estimateFactorBytes(Size const &factorNonZeros, Size const &matrixNonZeros, Size const &n)
+        {
+            using StorageIndex = typename Eigen::SparseMatrix<Scalar>::StorageIndex;
+            return estimateSparseMatrixBytes<Scalar>(factorNonZeros, n) + estimateSparseMatrixBytes<Scalar>((matrixNonZeros + n) / 2, n) +
+                   n * (2 * sizeof(Scalar) + 6 * sizeof(StorageIndex));
+        }
+
+        // Граф связей узлов через элементы после подстановки связей, с диагональю
+        void calculateNodeGraph(Eigen::SparseMatrix<int> &nodeGraph) const
+        {
+            nodeGraph.resize(nodes.size(), nodes.size());
+            nodeGraph.reserve(this->getNodeLinks());
+            std::vector<Size> expanded;
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                this->getExpandedElementNodes(expanded, e);
+                for (Size j : expanded)
+                {
+                    for (Size i : expanded)
+                    {
+                        nodeGraph.coeffRef(i, j) = 1;
+                    }
+                }
+            }
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                nodeGraph.coeffRef(i, i) = 1;
+            }
+            nodeGraph.makeCompressed();
+        }
+
+        // Число ненулевых под диагональю L в разложении LDL^T матрицы жёсткости. Столбцы L графа
+        // узлов, переставленного AMD, считаются по дереву исключения (как в SimplicialLDLT::analyzePattern);
+        // связь двух узлов даёт блок nNodeDofs x nNodeDofs, узел - нижний треугольник своего блока
+        Size estimateFactorNonZeros(Eigen::SparseMatrix<int> const &nodeGraph) const
+        {
+            Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> inverseOrdering;
+            Eigen::AMDOrdering<int>()(nodeGraph, inverseOrdering);
+            Eigen::VectorXi const &oldOf = inverseOrdering.indices();
+            int n = int(oldOf.size());
+            Eigen::VectorXi newOf(n), parent(n), tags(n);
+            for (int k = 0; k < n; ++k)
+            {
+                newOf(oldOf(k)) = k;
+            }
+            Size strictNonZeros = 0;
+            for (int k = 0; k < n; ++k)
+            {
+                parent(k) = -1;
+                tags(k) = k;
+                for (Eigen::SparseMatrix<int>::InnerIterator it(nodeGraph, oldOf(k)); it; ++it)
+                {
+                    int i = newOf(it.row());
+                    if (i >= k)
+                        continue;
+                    // Подъём по дереву исключения до уже отмеченного на шаге k узла
+                    for (; tags(i) != k; i = parent(i))
+                    {
+                        if (parent(i) == -1)
+                            parent(i) = k;
+                        ++strictNonZeros;
+                        tags(i) = k;
+                    }
+                }
+            }
+            Size blockDofs = FiniteElement::nNodeDofs;
+            return strictNonZeros * blockDofs * blockDofs + Size(n) * blockDofs * (blockDofs - 1) / 2;
+        }
+
+        // Заданные перемещения: перенос в правую часть, затем строка и столбец заменяются единицей на диагонали
+        template <typename Matrix, typename RightHandSide>
+        void applyBoundaryConditions(Matrix &K, RightHandSide &F) const
+        {
+            FEM_PROFILE("boundary conditions");
+            std::vector<char> prescribed(K.rows(), 0);
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                auto const &disps = nodes(i).disps;
+                for (Size j = 0; j < disps.size(); ++j)
+                {
+                    Size dof = i * FiniteElement::nNodeDofs + disps(j).direction;
+                    prescribed[dof] = 1;
+                    F -= K.col(dof) * typename Matrix::Scalar(disps(j).value);
+                }
+            }
+            K.prune([&](Eigen::Index const &row, Eigen::Index const &col, typename Matrix::Scalar const &)
+                    { return row == col || (!prescribed[row] && !prescribed[col]); });
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                auto const &disps = nodes(i).disps;
+                for (Size j = 0; j < disps.size(); ++j)
+                {
+                    Size dof = i * FiniteElement::nNodeDofs + disps(j).direction;
+                    K.coeffRef(dof, dof) = 1;
+                    F(dof) = disps(j).value;
+                }
+            }
+        }
+
+        // Узлы элемента e после подстановки связей
+        void getExpandedElementNodes(std::vector<Size> &expanded, Size const &e) const
+        {
+            expanded.clear();
+            for (Size i = 0; i < FiniteElement::nNodes; ++i)
+            {
+                this->forEachElementDof(e, i * FiniteElement::nNodeDofs, [&](Size const &dof, Value const &)
+                                        { expanded.push_back(dof / FiniteElement::nNodeDofs); });
+            }
+        }
+
+        // Оценка сверху числа связей узла: не более 1 + sum(m - 1) узлов его элементов, где m - число
+        // узлов элемента после подстановки связей (без связей m = 4, 3k + 1)
+        Eigen::VectorXi getNodeLinks() const
+        {
+            Eigen::VectorXi nodeLinks = Eigen::VectorXi::Ones(nodes.size());
+            std::vector<Size> expanded;
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                this->getExpandedElementNodes(expanded, e);
+                for (Size n : expanded)
+                {
+                    nodeLinks(n) += int(expanded.size()) - 1;
+                }
+            }
+            return nodeLinks;
+        }
+
+        // Оценка сверху числа ненулевых в столбце по числу связей узла
+        Eigen::VectorXi getColumnSizes() const
+        {
+            Eigen::VectorXi nodeLinks = this->getNodeLinks();
+            Eigen::VectorXi sizes(nodes.size() * FiniteElement::nNodeDofs);
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                sizes.segment<FiniteElement::nNodeDofs>(i * FiniteElement::nNodeDofs).setConstant(int(FiniteElement::nNodeDofs) * nodeLinks(i));
+            }
+            return sizes;
+        }
+
         Nodes nodes;
+        Elements elements;
+        NodeSets nodeSets;
         FiniteElement fe;
         Matrix stiffnessMatrix;
+        SparseMatrix sparseStiffnessMatrix, sparseMassMatrix;
         Vector forceVector, displacementVector;
+        Constraints constraints;
+        Indices constraintIndices;
+        Materials materials;
+        MaterialIds materialIds;
+        Size solverIterations = 0;
+        double backwardError = 0;
+        StoragePrecision storagePrecision = StoragePrecision::Full;
+        Size memoryBudget = 0;
     };
-}
\ No newline at end of file
+
+    template <typename T>
+    typename Mesh<T>::Size const Mesh<T>::unconstrained;
+}
@@ -0,0 +1,471 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fem
+{
+    // Двоичный контейнер сетки и решения. Каждая секция выровнена на 64 байта и хранится
+    // в собственном порядке байт, поэтому после отображения файла в память данные
+    // оборачиваются в Eigen::Map без разбора:
+    //
+    //   Header | Section[nSections] | данные секций
+    template <typename T>
+    class MeshFile
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using Coordinates = Eigen::Matrix<Value, Eigen::Dynamic, FiniteElement::nNodeDofs, Eigen::RowMajor>;
+        using Connectivity = Eigen::Matrix<Size, Eigen::Dynamic, FiniteElement::nNodes, Eigen::RowMajor>;
+        using Stresses = Eigen::Matrix<Value, Eigen::Dynamic, FiniteElement::nVoigt, Eigen::RowMajor>;
+
+        static std::uint32_t const version = 1;
+
+        enum SectionId : std::uint32_t
+        {
+            CoordinatesSection = 1,
+            ConnectivitySection = 2,
+            ForcesSection = 3,
+            DispsSection = 4,
+            DisplacementsSection = 5,
+            StressesSection = 6,
+            MaterialsSection = 7,
+            MaterialIdsSection = 8
+        };
+
+        // Граничное условие: узел, направление, значение
+        struct CondRecord
+        {
+            Size node;
+            Size direction;
+            Value value;
+        };
+
+        static bool write(const std::string &filename, Mesh const &mesh,
+                          bool withDisplacements = true, Stresses const *stresses = nullptr)
+        {
+            FEM_PROFILE("write mesh file");
+            std::vector<Section> sections;
+            std::vector<char const *> sources;
+            auto const &nodes = mesh.getNodes();
+
+            Coordinates coords(nodes.size(), FiniteElement::nNodeDofs);
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                coords.row(i) = nodes(i).coords.transpose();
+            }
+            Connectivity connectivity(mesh.getNumElements(), FiniteElement::nNodes);
+            for (Size e = 0; e < mesh.getNumElements(); ++e)
+            {
+                connectivity.row(e) = mesh.getElements()(e).transpose();
+            }
+            std::vector<CondRecord> forces, disps;
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                for (Size j = 0; j < nodes(i).forces.size(); ++j)
+                    forces.push_back({i, nodes(i).forces(j).direction, nodes(i).forces(j).value});
+                for (Size j = 0; j < nodes(i).disps.size(); ++j)
+                    disps.push_back({i, nodes(i).disps(j).direction, nodes(i).disps(j).value});
+            }
+
+            auto add = [&](SectionId id, void const *data, Size count, Size itemBytes)
+            {
+                sections.push_back({id, 0, 0, count * itemBytes, count});
+                sources.push_back(static_cast<char const *>(data));
+            };
+            add(CoordinatesSection, coords.data(), coords.rows(), sizeof(Value) * FiniteElement::nNodeDofs);
+            add(ConnectivitySection, connectivity.data(), connectivity.rows(), sizeof(Size) * FiniteElement::nNodes);
+            add(ForcesSection, forces.data(), forces.size(), sizeof(CondRecord));
+            add(DispsSection, disps.data(), disps.size(), sizeof(CondRecord));
+            if (withDisplacements)
+            {
+                auto const &u = mesh.getDisplacementVector();
+                add(DisplacementsSection, u.data(), u.size(), sizeof(Value));
+            }
+            auto const &materials = mesh.getMaterials();
+            auto const &materialIds = mesh.getMaterialIds();
+            if (!materials.empty())
+            {
+                add(MaterialsSection, materials.data(), materials.size(), sizeof(typename Mesh::Material));
+                add(MaterialIdsSection, materialIds.data(), materialIds.size(), sizeof(typename Mesh::MaterialId));
+            }
+            if (stresses != nullptr)
+            {
+                add(StressesSection, stresses->data(), stresses->rows(), sizeof(Value) * FiniteElement::nVoigt);
+            }
+
+            Header header = {};
+            std::memcpy(header.magic, "FEMMESH", 8);
+            header.version = version;
+            header.byteOrder = byteOrderMark;
+            header.valueBytes = sizeof(Value);
+            header.sizeBytes = sizeof(Size);
+            header.nNodes = nodes.size();
+            header.nElements = mesh.getNumElements();
+            header.nSections = sections.size();
+
+            Size offset = align(sizeof(Header) + sections.size() * sizeof(Section));
+            for (auto &section : sections)
+            {
+                section.offset = offset;
+                offset = align(offset + section.bytes);
+            }
+
+            std::ofstream file(filename, std::ios::binary);
+            if (!file.is_open())
+            {
+                std::cerr << "Error: Could not open " << filename << " for writing!" << std::endl;
+                return false;
+            }
+            file.write(reinterpret_cast<char const *>(&header), sizeof(Header));
+            file.write(reinterpret_cast<char const *>(sections.data()), sections.size() * sizeof(Section));
+            Size written = sizeof(Header) + sections.size() * sizeof(Section);
+            char const zeros[alignment] = {};
+            for (Size s = 0; s < sections.size(); ++s)
+            {
+                file.write(zeros, sections[s].offset - written);
+                file.write(sources[s], sections[s].bytes);
+                written = sections[s].offset + sections[s].bytes;
+            }
+            file.write(zeros, offset - written);
+            if (!file.good())
+            {
+                std::cerr << "Error: Could not write " << filename << std::endl;
+                return false;
+            }
+            std::cout << "Mesh saved to " << filename << std::endl;
+            return true;
+        }
+
+        bool open(const std::string &filename)
+        {
+            header = nullptr;
+            sections = nullptr;
+            if (!file.open(filename))
+                return false;
+            if (file.size() < sizeof(Header))
+            {
+                std::cerr << "Error: " << filename << " is not a mesh file!" << std::endl;
+                return false;
+            }
+            Header const *h = reinterpret_cast<Header const *>(file.data());
+            if (std::memcmp(h->magic, "FEMMESH", 8) != 0 || h->byteOrder != byteOrderMark)
+            {
+                std::cerr << "Error: " << filename << " is not a mesh file or has a different byte order!" << std::endl;
+                return false;
+            }
+            if (h->version > version)
+            {
+                std::cerr << "Error: " << filename << " has unsupported version " << h->version << std::endl;
+                return false;
+            }
+            if (h->valueBytes != sizeof(Value) || h->sizeBytes != sizeof(Size))
+            {
+                std::cerr << "Error: " << filename << " stores " << h->valueBytes * 8
+                          << "-bit values, expected " << sizeof(Value) * 8 << std::endl;
+                return false;
+            }
+            Section const *s = reinterpret_cast<Section const *>(file.data() + sizeof(Header));
+            // Размеры сравниваются вычитанием, чтобы испорченные смещения не переполняли сумму
+            bool truncated = h->nSections > (file.size() - sizeof(Header)) / sizeof(Section);
+            for (Size i = 0; !truncated && i < h->nSections; ++i)
+                truncated = s[i].offset > file.size() || s[i].bytes > file.size() - s[i].offset;
+            if (truncated)
+            {
+                std::cerr << "Error: " << filename << " is truncated!" << std::endl;
+                return false;
+            }
+            header = h;
+            sections = s;
+            if (!this->validate(filename))
+            {
+                header = nullptr;
+                sections = nullptr;
+                return false;
+            }
+            return true;
+        }
+
+        Size getNumNodes() const
+        {
+            return header->nNodes;
+        }
+
+        Size getNumElements() const
+        {
+            return header->nElements;
+        }
+
+        bool hasSection(SectionId id) const
+        {
+            return this->findSection(id) != nullptr;
+        }
+
+        Eigen::Map<const Coordinates> getCoordinates() const
+        {
+            return this->map<Coordinates>(CoordinatesSection, FiniteElement::nNodeDofs);
+        }
+
+        Eigen::Map<const Connectivity> getConnectivity() const
+        {
+            return this->map<Connectivity>(ConnectivitySection, FiniteElement::nNodes);
+        }
+
+        Eigen::Map<const Vector> getDisplacements() const
+        {
+            return this->map<Vector>(DisplacementsSection, 1);
+        }
+
+        Eigen::Map<const Stresses> getStresses() const
+        {
+            return this->map<Stresses>(StressesSection, FiniteElement::nVoigt);
+        }
+
+        CondRecord const *getConds(SectionId id, Size &count) const
+        {
+            Section const *section = this->findSection(id);
+            count = section != nullptr ? section->count : 0;
+            return section != nullptr ? reinterpret_cast<CondRecord const *>(file.data() + section->offset) : nullptr;
+        }
+
+        // Восстанавливает сетку с граничными условиями и, если есть, материалами и перемещениями
+        Mesh createMesh() const
+        {
+            auto coords = this->getCoordinates();
+            auto connectivity = this->getConnectivity();
+            typename Mesh::Nodes nodes(coords.rows());
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                nodes(i).coords = coords.row(i).transpose();
+            }
+            typename Mesh::Elements elements(connectivity.rows());
+            for (Size e = 0; e < elements.size(); ++e)
+            {
+                elements(e) = connectivity.row(e).transpose();
+            }
+            this->fillConds(nodes, ForcesSection);
+            this->fillConds(nodes, DispsSection);
+
+            Mesh mesh(std::move(nodes), std::move(elements));
+            if (Section const *section = this->findSection(MaterialsSection))
+            {
+                auto const *first = reinterpret_cast<typename Mesh::Material const *>(file.data() + section->offset);
+                typename Mesh::MaterialIds materialIds;
+                if (Section const *ids = this->findSection(MaterialIdsSection))
+                {
+                    materialIds = Eigen::Map<const typename Mesh::MaterialIds>(
+                        reinterpret_cast<typename Mesh::MaterialId const *>(file.data() + ids->offset), ids->count);
+                }
+                // Номера материалов проверены в validate, поэтому таблица принимается
+                mesh.setMaterials(typename Mesh::Materials(first, first + section->count), std::move(materialIds));
+            }
+            if (this->hasSection(DisplacementsSection))
+            {
+                mesh.setDisplacementVector(this->getDisplacements());
+            }
+            return mesh;
+        }
+
+    private:
+        static Size const alignment = 64;
+        static std::uint32_t const byteOrderMark = 0x01020304;
+
+        struct Header
+        {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byteOrder;
+            std::uint32_t valueBytes;
+            std::uint32_t sizeBytes;
+            Size nNodes;
+            Size nElements;
+            Size nSections;
+            Size reserved[2];
+        };
+
+        struct Section
+        {
+            std::uint32_t id;
+            std::uint32_t reserved;
+            Size offset;
+            Size bytes;
+            Size count;
+        };
+
+        static Size align(Size offset)
+        {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        // Размер записи известной секции; 0 для секций, которые читатель не разбирает
+        static Size itemBytes(std::uint32_t const &id)
+        {
+            switch (id)
+            {
+            case CoordinatesSection:
+                return sizeof(Value) * FiniteElement::nNodeDofs;
+            case ConnectivitySection:
+                return sizeof(Size) * FiniteElement::nNodes;
+            case ForcesSection:
+            case DispsSection:
+                return sizeof(CondRecord);
+            case DisplacementsSection:
+                return sizeof(Value);
+            case StressesSection:
+                return sizeof(Value) * FiniteElement::nVoigt;
+            case MaterialsSection:
+                return sizeof(typename Mesh::Material);
+            case MaterialIdsSection:
+                return sizeof(typename Mesh::MaterialId);
+            default:
+                return 0;
+            }
+        }
+
+        // Содержимое секций проверяется при открытии, поэтому createMesh и fillConds
+        // индексируют узлы по данным файла без проверок
+        bool validate(const std::string &filename) const
+        {
+            for (Size i = 0; i < header->nSections; ++i)
+            {
+                Size bytes = itemBytes(sections[i].id);
+                if (bytes != 0 && (sections[i].offset % alignment != 0 || sections[i].count > sections[i].bytes / bytes ||
+                                   sections[i].count * bytes != sections[i].bytes))
+                {
+                    std::cerr << "Error: " << filename << " has a malformed section " << sections[i].id << "!" << std::endl;
+                    return false;
+                }
+            }
+            Section const *coords = this->findSection(CoordinatesSection);
+            Section const *connectivity = this->findSection(ConnectivitySection);
+            Section const *displacements = this->findSection(DisplacementsSection);
+            Size nNodes = coords != nullptr ? coords->count : 0;
+            if (nNodes != header->nNodes || (connectivity != nullptr ? connectivity->count : 0) != header->nElements)
+            {
+                std::cerr << "Error: " << filename << " holds " << nNodes << " nodes and "
+                          << (connectivity != nullptr ? connectivity->count : 0) << " elements, header declares "
+                          << header->nNodes << " and " << header->nElements << "!" << std::endl;
+                return false;
+            }
+            auto elements = this->getConnectivity();
+            for (Size e = 0; e < elements.rows(); ++e)
+            {
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                {
+                    if (elements(e, i) >= nNodes)
+                    {
+                        std::cerr << "Error: " << filename << ": element " << e << " refers to missing node " << elements(e, i) << "!" << std::endl;
+                        return false;
+                    }
+                }
+            }
+            for (SectionId id : {ForcesSection, DispsSection})
+            {
+                Size count;
+                CondRecord const *records = this->getConds(id, count);
+                for (Size k = 0; k < count; ++k)
+                {
+                    if (records[k].node >= nNodes || records[k].direction >= FiniteElement::nNodeDofs)
+                    {
+                        std::cerr << "Error: " << filename << ": condition on node " << records[k].node << ", direction "
+                                  << records[k].direction << " is out of range!" << std::endl;
+                        return false;
+                    }
+                }
+            }
+            if (displacements != nullptr && displacements->count != nNodes * FiniteElement::nNodeDofs)
+            {
+                std::cerr << "Error: " << filename << " stores " << displacements->count << " displacements for "
+                          << nNodes * FiniteElement::nNodeDofs << " degrees of freedom!" << std::endl;
+                return false;
+            }
+            // Без номеров материалов у всех элементов материал 0, как в Mesh::setMaterials
+            Section const *materials = this->findSection(MaterialsSection);
+            Section const *ids = this->findSection(MaterialIdsSection);
+            Size nMaterials = materials != nullptr ? materials->count : 0;
+            if (ids != nullptr && ids->count != 0)
+            {
+                if (ids->count != header->nElements)
+                {
+                    std::cerr << "Error: " << filename << " stores " << ids->count << " material IDs for "
+                              << header->nElements << " elements!" << std::endl;
+                    return false;
+                }
+                auto const *first = reinterpret_cast<typename Mesh::MaterialId const *>(file.data() + ids->offset);
+                for (Size e = 0; e < ids->count; ++e)
+                {
+                    if (first[e] >= nMaterials)
+                    {
+                        std::cerr << "Error: " << filename << ": element " << e << " refers to missing material " << first[e] << "!" << std::endl;
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        Section const *findSection(SectionId id) const
+        {
+            for (Size i = 0; header != nullptr && i < header->nSections; ++i)
+            {
+                if (sections[i].id == id)
+                    return &sections[i];
+            }
+            return nullptr;
+        }
+
+        template <typename Matrix>
+        Eigen::Map<const Matrix> map(SectionId id, Size nCols) const
+        {
+            Section const *section = this->findSection(id);
+            if (section == nullptr)
+                return Eigen::Map<const Matrix>(nullptr, 0, nCols);
+            return Eigen::Map<const Matrix>(reinterpret_cast<typename Matrix::Scalar const *>(file.data() + section->offset),
+                                            section->count, nCols);
+        }
+
+        void fillConds(typename Mesh::Nodes &nodes, SectionId id) const
+        {
+            Size count;
+            CondRecord const *records = this->getConds(id, count);
+            std::vector<Size> perNode(nodes.size(), 0);
+            for (Size k = 0; k < count; ++k)
+                ++perNode[records[k].node];
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                auto &conds = id == ForcesSection ? nodes(i).forces : nodes(i).disps;
+                conds.resize(perNode[i]);
+                perNode[i] = 0;
+            }
+            for (Size k = 0; k < count; ++k)
+            {
+                auto &conds = id == ForcesSection ? nodes(records[k].node).forces : nodes(records[k].node).disps;
+                conds(perNode[records[k].node]++) = {records[k].direction, records[k].value};
+            }
+        }
+
+        MappedFile file;
+        Header const *header = nullptr;
+        Section const *sections = nullptr;
+    };
+
+    template <typename T>
+    std::uint32_t const MeshFile<T>::version;
+
+    template <typename T>
+    typename MeshFile<T>::Size const MeshFile<T>::alignment;
+
+    template <typename T>
+    std::uint32_t const MeshFile<T>::byteOrderMark;
+}
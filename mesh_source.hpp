@@ -0,0 +1,56 @@
+#pragma once
+
+#include "gmsh_reader.hpp"
+#include "mesh.hpp"
+#include "mesh_file.hpp"
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+namespace fem
+{
+    // Сетка по текстовому описанию:
+    //   grid x0 y0 x1 y1 nx ny - прямоугольник из nx x ny элементов (Mesh::buildRegulArea)
+    //   gmsh file.msh          - сетка Gmsh
+    //   file file.fem          - файл MeshFile с граничными условиями и материалами
+    template <typename T>
+    bool loadMesh(std::string const &description, std::unique_ptr<Mesh<T>> &mesh)
+    {
+        using Size = typename Mesh<T>::Size;
+        std::istringstream tokens(description);
+        std::string kind, filename;
+        tokens >> kind;
+        if (kind == "grid")
+        {
+            T x0, y0, x1, y1;
+            Size nx, ny;
+            if (!(tokens >> x0 >> y0 >> x1 >> y1 >> nx >> ny) || nx == 0 || ny == 0)
+            {
+                std::cerr << "Error: mesh grid expects x0 y0 x1 y1 nx ny!" << std::endl;
+                return false;
+            }
+            mesh.reset(new Mesh<T>(Mesh<T>::buildRegulArea(x0, y0, x1, y1, nx, ny)));
+            return true;
+        }
+        if (kind != "gmsh" && kind != "file")
+        {
+            std::cerr << "Error: unknown mesh kind '" << kind << "', expected grid, gmsh or file!" << std::endl;
+            return false;
+        }
+        tokens >> filename;
+        if (kind == "gmsh")
+        {
+            GmshReader<T> reader;
+            if (!reader.read(filename))
+                return false;
+            mesh.reset(new Mesh<T>(reader.createMesh()));
+            return true;
+        }
+        MeshFile<T> file;
+        if (!file.open(filename))
+            return false;
+        mesh.reset(new Mesh<T>(file.createMesh()));
+        return true;
+    }
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include "mesh.hpp"
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fem
+{
+    // Собственные частоты и формы: K x = lambda M x, lambda = omega^2. Метод Ланцоша со сдвигом
+    // и обращением: оператор (K - shift M)^-1 M самосопряжён в M-скалярном произведении, его
+    // наибольшие по модулю собственные значения 1 / (lambda - shift) отвечают ближайшим к сдвигу
+    // частотам. Разложение K - shift M выполняется один раз, каждый шаг - прямой и обратный ход.
+    // Базис полностью переортогонализуется. Закреплённые и связанные степени свободы получают
+    // нулевую массу и бесконечные собственные значения, которые оператор отбрасывает сам.
+    // Вычисления ведутся не ниже чем в double: погрешность разложения во float умножается на
+    // отношение частот и портит высшие формы.
+    template <typename T>
+    class ModalAnalysis
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using Matrix = typename Mesh::Matrix;
+        using SparseMatrix = typename Mesh::SparseMatrix;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using Real = decltype(Value() + double());
+        using RealVector = Eigen::VectorX<Real>;
+        using RealMatrix = Eigen::MatrixX<Real>;
+        using RealSparseMatrix = Eigen::SparseMatrix<Real>;
+
+        // Матрицы жёсткости и масс сетки должны быть собраны (calculateSparse*Matrix)
+        ModalAnalysis(Mesh const &mesh) : mesh(mesh)
+        {
+        }
+
+        // nModes собственных пар, ближайших к shift сверху; для незакреплённой конструкции
+        // shift берётся отрицательным, чтобы K - shift M не была вырожденной
+        bool solve(Size nModes, Value const &shift = 0,
+                   Value const &tolerance = std::sqrt(Eigen::NumTraits<Value>::epsilon()))
+        {
+            FEM_PROFILE("modal analysis");
+            RealSparseMatrix K = mesh.getSparseStiffnessMatrix().template cast<Real>();
+            RealSparseMatrix M = mesh.getSparseMassMatrix().template cast<Real>();
+            Size nDofs = K.rows();
+            if (nDofs == 0 || Size(M.rows()) != nDofs)
+            {
+                std::cerr << "Error: stiffness and mass matrices must be assembled before modal analysis!" << std::endl;
+                return false;
+            }
+            this->applySupports(K, M);
+
+            Size nMassive = 0;
+            for (Size dof = 0; dof < nDofs; ++dof)
+            {
+                if (M.coeff(dof, dof) > 0)
+                    ++nMassive;
+            }
+            nModes = std::min(nModes, nMassive);
+            eigenvalues.resize(0);
+            modeShapes.resize(nDofs, 0);
+            iterations = 0;
+            if (nModes == 0)
+                return true;
+
+            RealSparseMatrix A = K - Real(shift) * M;
+            solver.compute(A);
+            if (solver.info() != Eigen::Success)
+            {
+                std::cerr << "Error: factorization of K - shift M failed, try another shift!" << std::endl;
+                return false;
+            }
+
+            // Начальный вектор пропускается через оператор, чтобы убрать компоненты без массы
+            std::mt19937 generator(12345);
+            std::uniform_real_distribution<double> distribution(-1, 1);
+            RealVector q(nDofs);
+            for (Size dof = 0; dof < nDofs; ++dof)
+                q(dof) = distribution(generator);
+            q = solver.solve(M * q);
+            Real norm = std::sqrt(q.dot(M * q));
+            if (!(norm > 0))
+            {
+                std::cerr << "Error: mass matrix is zero on the free DOFs!" << std::endl;
+                return false;
+            }
+            q /= norm;
+
+            Size capacity = std::min(nMassive, std::max(2 * nModes, nModes + 20));
+            RealMatrix Q(nDofs, capacity);
+            std::vector<Real> alpha, beta;
+            Size const checkInterval = 10;
+            Eigen::SelfAdjointEigenSolver<RealMatrix> ritz;
+            bool converged = false;
+
+            for (Size j = 0; j < nMassive; ++j)
+            {
+                if (j == capacity)
+                {
+                    capacity = std::min(nMassive, capacity + capacity / 2 + 1);
+                    Q.conservativeResize(Eigen::NoChange, capacity);
+                }
+                Q.col(j) = q;
+                RealVector Mq = M * q;
+                RealVector w = solver.solve(Mq);
+                alpha.push_back(w.dot(Mq));
+                w -= alpha.back() * q;
+                if (j > 0)
+                    w -= beta.back() * Q.col(j - 1);
+                for (int pass = 0; pass < 2; ++pass)
+                {
+                    RealVector h = Q.leftCols(j + 1).transpose() * (M * w);
+                    w -= Q.leftCols(j + 1) * h;
+                }
+                Real b = std::sqrt(std::max<Real>(w.dot(M * w), 0));
+                iterations = j + 1;
+
+                bool last = j + 1 == nMassive;
+                if (last || b == 0 || (j + 1 >= nModes && (j + 1) % checkInterval == 0))
+                {
+                    this->computeRitzPairs(ritz, alpha, beta);
+                    Real largest = ritz.eigenvalues().cwiseAbs().maxCoeff();
+                    converged = true;
+                    for (Size k : this->selectRitzValues(ritz, nModes))
+                    {
+                        if (std::abs(b * ritz.eigenvectors()(j, k)) > Real(tolerance) * std::abs(ritz.eigenvalues()(k)))
+                            converged = false;
+                    }
+                    // Инвариантное подпространство: все пары базиса точные
+                    if (b <= Eigen::NumTraits<Real>::epsilon() * largest)
+                        converged = true;
+                    if (converged || last)
+                        break;
+                }
+                beta.push_back(b);
+                q = w / b;
+            }
+            if (!converged)
+                std::cerr << "Warning: Lanczos iterations exhausted before all modes converged" << std::endl;
+
+            std::vector<Size> selected = this->selectRitzValues(ritz, nModes);
+            std::sort(selected.begin(), selected.end(), [&](Size const &a, Size const &b)
+                      { return shift + 1 / ritz.eigenvalues()(a) < shift + 1 / ritz.eigenvalues()(b); });
+            eigenvalues.resize(selected.size());
+            modeShapes.resize(nDofs, selected.size());
+            for (Size k = 0; k < selected.size(); ++k)
+            {
+                eigenvalues(k) = Value(shift + 1 / ritz.eigenvalues()(selected[k]));
+                modeShapes.col(k) = (Q.leftCols(iterations) * ritz.eigenvectors().col(selected[k])).template cast<Value>();
+            }
+            mesh.applyConstraints(modeShapes);
+            return converged;
+        }
+
+        // omega^2
+        const Vector &getEigenvalues() const
+        {
+            return eigenvalues;
+        }
+
+        // Частоты в герцах
+        Vector getFrequencies() const
+        {
+            Vector frequencies(eigenvalues.size());
+            for (Size k = 0; k < eigenvalues.size(); ++k)
+                frequencies(k) = std::sqrt(std::max<Value>(eigenvalues(k), 0)) / (2 * std::acos(Value(-1)));
+            return frequencies;
+        }
+
+        // Формы по столбцам, нормированные по массе: x^T M x = 1
+        const Matrix &getModeShapes() const
+        {
+            return modeShapes;
+        }
+
+        Size getIterations() const
+        {
+            return iterations;
+        }
+
+        void writeModes(std::ostream &out) const
+        {
+            Vector frequencies = this->getFrequencies();
+            out << "Mode\tOmega^2\tFrequency, Hz\n";
+            for (Size k = 0; k < eigenvalues.size(); ++k)
+                out << k + 1 << "\t" << eigenvalues(k) << "\t" << frequencies(k) << "\n";
+        }
+
+        // Геометрия сетки и формы колебаний mode_1, mode_2, ...
+        void writeParaViewVtk(const std::string &filename) const
+        {
+            std::ofstream vtk(filename);
+            if (!vtk.is_open())
+            {
+                std::cerr << "Error: Could not open " << filename << " for writing!" << std::endl;
+                return;
+            }
+            mesh.writeParaViewVtk(vtk);
+            for (Size k = 0; k < modeShapes.cols(); ++k)
+            {
+                vtk << "VECTORS mode_" << k + 1 << " float\n";
+                for (Size i = 0; i < mesh.getNumNodes(); ++i)
+                {
+                    vtk << modeShapes(FiniteElement::nNodeDofs * i, k) << " "
+                        << modeShapes(FiniteElement::nNodeDofs * i + 1, k) << " 0.0\n";
+                }
+            }
+            vtk.close();
+            std::cout << "Successfully wrote " << filename << std::endl;
+        }
+
+    private:
+        // Закреплённые степени свободы неподвижны: в K единица на диагонали, в M нули
+        void applySupports(RealSparseMatrix &K, RealSparseMatrix &M) const
+        {
+            std::vector<char> prescribed(K.rows(), 0);
+            for (auto const &p : mesh.getPrescribedDofs())
+                prescribed[p.first] = 1;
+            K.prune([&](Eigen::Index const &row, Eigen::Index const &col, Real const &)
+                    { return row == col || (!prescribed[row] && !prescribed[col]); });
+            M.prune([&](Eigen::Index const &row, Eigen::Index const &col, Real const &)
+                    { return !prescribed[row] && !prescribed[col]; });
+            for (Size dof = 0; dof < prescribed.size(); ++dof)
+            {
+                if (prescribed[dof])
+                    K.coeffRef(dof, dof) = 1;
+            }
+        }
+
+        void computeRitzPairs(Eigen::SelfAdjointEigenSolver<RealMatrix> &ritz,
+                              std::vector<Real> const &alpha, std::vector<Real> const &beta) const
+        {
+            Size m = alpha.size();
+            RealVector diagonal = Eigen::Map<const RealVector>(alpha.data(), m);
+            RealVector subdiagonal = m > 1 ? RealVector(Eigen::Map<const RealVector>(beta.data(), m - 1)) : RealVector();
+            ritz.computeFromTridiagonal(diagonal, subdiagonal, Eigen::ComputeEigenvectors);
+        }
+
+        // Номера nModes значений Ритца, наибольших по модулю
+        std::vector<Size> selectRitzValues(Eigen::SelfAdjointEigenSolver<RealMatrix> const &ritz, Size const &nModes) const
+        {
+            std::vector<Size> order(ritz.eigenvalues().size());
+            for (Size k = 0; k < order.size(); ++k)
+                order[k] = k;
+            std::sort(order.begin(), order.end(), [&](Size const &a, Size const &b)
+                      { return std::abs(ritz.eigenvalues()(a)) > std::abs(ritz.eigenvalues()(b)); });
+            order.resize(std::min<Size>(nModes, order.size()));
+            return order;
+        }
+
+        Mesh const &mesh;
+        Eigen::SimplicialLDLT<RealSparseMatrix> solver;
+        Vector eigenvalues;
+        Matrix modeShapes;
+        Size iterations = 0;
+    };
+}
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fem
+{
+    inline unsigned hardwareThreads()
+    {
+        unsigned n = std::thread::hardware_concurrency();
+        return n != 0 ? n : 1;
+    }
+
+    // Вызывает function(i) для i из [begin, end); индексы раздаются потокам порциями по grain
+    template <typename Function>
+    void parallelFor(std::size_t begin, std::size_t end, Function const &function,
+                     unsigned nThreads = 0, std::size_t grain = 1)
+    {
+        if (end <= begin)
+            return;
+        if (nThreads == 0)
+            nThreads = hardwareThreads();
+        grain = std::max<std::size_t>(grain, 1);
+        std::size_t nChunks = (end - begin + grain - 1) / grain;
+        nThreads = unsigned(std::min<std::size_t>(nThreads, nChunks));
+
+        std::atomic<std::size_t> next(begin);
+        auto worker = [&]()
+        {
+            for (std::size_t first = next.fetch_add(grain); first < end; first = next.fetch_add(grain))
+            {
+                std::size_t last = std::min(first + grain, end);
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    function(i);
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(nThreads - 1);
+        for (unsigned t = 1; t < nThreads; ++t)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    // Барьер для постоянной группы потоков: wait() возвращается, когда его вызвали все count
+    // потоков; барьер многоразовый
+    class Barrier
+    {
+    public:
+        explicit Barrier(unsigned count) : count(count)
+        {
+        }
+
+        void wait()
+        {
+            if (count <= 1)
+                return;
+            std::unique_lock<std::mutex> lock(mutex);
+            std::size_t arrivedGeneration = generation;
+            if (++arrived == count)
+            {
+                arrived = 0;
+                ++generation;
+                condition.notify_all();
+                return;
+            }
+            condition.wait(lock, [&]()
+                           { return generation != arrivedGeneration; });
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable condition;
+        unsigned count, arrived = 0;
+        std::size_t generation = 0;
+    };
+
+    // Пул потоков с перехватом задач. У каждого потока своя очередь: он берёт из неё последние
+    // поставленные задачи, а простаивающий поток забирает самые старые задачи из чужих очередей,
+    // так что короткие задачи заполняют простои рядом с длинными. Задача может ставить новые
+    // задачи - они попадают в очередь её потока. bytes - оценка памяти задачи: задача запускается,
+    // когда сумма оценок выполняющихся задач вместе с ней не превышает memoryBudget (0 - без
+    // ограничения) или когда других задач не выполняется; до тех пор её поток ждёт
+    class WorkStealingPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        explicit WorkStealingPool(unsigned nThreads = 0, std::size_t memoryBudget = 0) : memoryBudget(memoryBudget)
+        {
+            if (nThreads == 0)
+                nThreads = hardwareThreads();
+            for (unsigned t = 0; t < nThreads; ++t)
+            {
+                queues.emplace_back(new Queue);
+            }
+            for (unsigned t = 0; t < nThreads; ++t)
+            {
+                threads.emplace_back([this, t]()
+                                     { this->work(t); });
+            }
+        }
+
+        ~WorkStealingPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_all();
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        WorkStealingPool(WorkStealingPool const &) = delete;
+        WorkStealingPool &operator=(WorkStealingPool const &) = delete;
+
+        void submit(Task task, std::size_t bytes = 0)
+        {
+            // Задача из потока пула остаётся у него, остальные раздаются по кругу
+            std::size_t q = currentPool() == this ? currentWorker() : nextQueue++ % queues.size();
+            // Счётчик растёт раньше очереди, поэтому он не меньше числа задач в очередях
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++unfinished;
+                ++queued;
+            }
+            {
+                std::lock_guard<std::mutex> lock(queues[q]->mutex);
+                queues[q]->items.push_back(Item{std::move(task), bytes});
+            }
+            wakeup.notify_one();
+        }
+
+        // Ожидание всех поставленных задач, включая поставленные из задач
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&]()
+                          { return unfinished == 0; });
+        }
+
+        unsigned getNumThreads() const
+        {
+            return unsigned(threads.size());
+        }
+
+        // Число задач, перехваченных из чужих очередей
+        std::size_t getNumSteals() const
+        {
+            return steals;
+        }
+
+        // Наибольшая сумма оценок памяти одновременно выполнявшихся задач
+        std::size_t getPeakBytes() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return peakBytes;
+        }
+
+    private:
+        struct Item
+        {
+            Task task;
+            std::size_t bytes;
+        };
+
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Item> items;
+        };
+
+        static WorkStealingPool *&currentPool()
+        {
+            thread_local WorkStealingPool *pool = nullptr;
+            return pool;
+        }
+
+        static std::size_t &currentWorker()
+        {
+            thread_local std::size_t worker = 0;
+            return worker;
+        }
+
+        bool take(std::size_t const &worker, Item &item)
+        {
+            {
+                Queue &own = *queues[worker];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.items.empty())
+                {
+                    item = std::move(own.items.back());
+                    own.items.pop_back();
+                    return true;
+                }
+            }
+            for (std::size_t k = 1; k < queues.size(); ++k)
+            {
+                Queue &victim = *queues[(worker + k) % queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.items.empty())
+                {
+                    item = std::move(victim.items.front());
+                    victim.items.pop_front();
+                    ++steals;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void work(std::size_t const &worker)
+        {
+            currentPool() = this;
+            currentWorker() = worker;
+            Item item;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wakeup.wait(lock, [&]()
+                                { return stopping || queued != 0; });
+                    if (queued == 0)
+                        return;
+                }
+                if (!this->take(worker, item))
+                    continue;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    --queued;
+                    admitted.wait(lock, [&]()
+                                  { return memoryBudget == 0 || runningBytes == 0 || runningBytes + item.bytes <= memoryBudget; });
+                    runningBytes += item.bytes;
+                    peakBytes = std::max(peakBytes, runningBytes);
+                }
+                item.task();
+                item.task = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    runningBytes -= item.bytes;
+                    if (--unfinished == 0)
+                        finished.notify_all();
+                }
+                admitted.notify_all();
+            }
+        }
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> threads;
+        mutable std::mutex mutex;
+        std::condition_variable wakeup, admitted, finished;
+        std::size_t memoryBudget, runningBytes = 0, peakBytes = 0;
+        std::size_t queued = 0, unfinished = 0;
+        std::atomic<std::size_t> nextQueue{0}, steals{0};
+        bool stopping = false;
+    };
+}
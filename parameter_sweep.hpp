@@ -0,0 +1,170 @@
+#pragma once
+
+#include "mesh.hpp"
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace fem
+{
+    // Серии статических расчётов по модулю упругости E и коэффициенту Пуассона nu. Матрица
+    // жёсткости аффинна по материалу: K(E, nu) = E / (1 - nu^2) A(nu), A = K0 + nu K1, и K0, K1
+    // собираются один раз. Решение с заданными перемещениями g раскладывается на две части:
+    // u = (1 - nu^2) / E * uF + uG, где A uF = F при нулевых g и A uG = 0 при uG = g.
+    // Обе части зависят только от nu, поэтому смена E - это масштабирование без решения, а смена
+    // nu - численное разложение A на сохранённой структуре с готовым символьным разложением
+    template <typename T>
+    class ParameterSweep
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using SparseMatrix = typename Mesh::SparseMatrix;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using Parameters = std::pair<Value, Value>; // модуль упругости и коэффициент Пуассона
+
+        // Вектор сил сетки должен быть вычислен. Если в сетке несколько материалов или сборку
+        // отклонил бюджет памяти сетки, solve возвращает false
+        ParameterSweep(Mesh const &mesh) : mesh(mesh)
+        {
+            if (!mesh.checkSingleMaterial("parameter sweep") || !mesh.calculateAffineStiffnessMatrices(K0, K1))
+                return;
+            Size nDofs = K0.rows();
+            fixedDofs.assign(nDofs, 0);
+            Vector prescribedDisplacements = Vector::Zero(nDofs);
+            prescribed = mesh.getPrescribedDofs();
+            for (auto const &p : prescribed)
+            {
+                prescribedDisplacements(p.first) = p.second;
+                fixedDofs[p.first] = 1;
+            }
+            // Вклад заданных перемещений в правую часть: -(K0 + nu K1) g
+            lift0 = K0 * prescribedDisplacements;
+            lift1 = K1 * prescribedDisplacements;
+
+            // Строки и столбцы заданных перемещений исключаются одинаково в K0 и K1, так что
+            // структуры совпадают и A(nu) собирается сложением массивов значений
+            auto keep = [&](Eigen::Index const &row, Eigen::Index const &col, Value const &)
+            { return row == col || (!fixedDofs[row] && !fixedDofs[col]); };
+            K0.prune(keep);
+            K1.prune(keep);
+            for (auto const &p : prescribed)
+            {
+                K0.coeffRef(p.first, p.first) = 1;
+                K1.coeffRef(p.first, p.first) = 0;
+            }
+            K0.makeCompressed();
+            K1.makeCompressed();
+
+            forces = mesh.getForceVector();
+            for (auto const &p : prescribed)
+                forces(p.first) = 0;
+
+            A = K0;
+            solver.analyzePattern(A);
+            assembled = true;
+        }
+
+        // Перемещения при модуле E и коэффициенте nu; разложение выполняется только при новом nu
+        bool solve(Vector &u, Value const &elasticityModulus, Value const &poissonRatio)
+        {
+            if (!assembled)
+            {
+                std::cerr << "Error: stiffness matrices are not assembled!" << std::endl;
+                return false;
+            }
+            if (!(elasticityModulus > 0))
+            {
+                std::cerr << "Error: elasticity modulus must be positive!" << std::endl;
+                return false;
+            }
+            if (!this->factorize(poissonRatio))
+                return false;
+            u = (1 - poissonRatio * poissonRatio) / elasticityModulus * forceSolution + displacementSolution;
+            ++nSolutions;
+            return true;
+        }
+
+        // Расчёт для каждой пары (E, nu); onResult(k, u) получает номер пары в исходном списке.
+        // Пары обходятся по возрастанию nu, чтобы каждое значение nu раскладывалось один раз
+        template <typename OnResult>
+        bool sweep(std::vector<Parameters> const &parameters, OnResult const &onResult)
+        {
+            std::vector<Size> order(parameters.size());
+            for (Size k = 0; k < order.size(); ++k)
+                order[k] = k;
+            std::stable_sort(order.begin(), order.end(), [&](Size const &a, Size const &b)
+                             { return parameters[a].second < parameters[b].second; });
+            Vector u;
+            for (Size k : order)
+            {
+                if (!this->solve(u, parameters[k].first, parameters[k].second))
+                    return false;
+                onResult(k, static_cast<Vector const &>(u));
+            }
+            return true;
+        }
+
+        Size getNumFactorizations() const
+        {
+            return nFactorizations;
+        }
+
+        Size getNumSolutions() const
+        {
+            return nSolutions;
+        }
+
+    private:
+        bool factorize(Value const &poissonRatio)
+        {
+            if (factorized && poissonRatio == factorizedRatio)
+                return true;
+            if (!(poissonRatio > -1 && poissonRatio < 1))
+            {
+                std::cerr << "Error: Poisson's ratio must lie in (-1, 1)!" << std::endl;
+                return false;
+            }
+
+            Eigen::Map<Vector>(A.valuePtr(), A.nonZeros()) =
+                Eigen::Map<const Vector>(K0.valuePtr(), K0.nonZeros()) +
+                poissonRatio * Eigen::Map<const Vector>(K1.valuePtr(), K1.nonZeros());
+            factorized = false;
+            solver.factorize(A);
+            if (solver.info() != Eigen::Success)
+            {
+                std::cerr << "Error: stiffness matrix factorization failed!" << std::endl;
+                return false;
+            }
+
+            forceSolution = solver.solve(forces);
+            Vector rhs = -(lift0 + poissonRatio * lift1);
+            for (auto const &p : prescribed)
+                rhs(p.first) = p.second;
+            displacementSolution = solver.solve(rhs);
+            mesh.applyConstraints(forceSolution);
+            mesh.applyConstraints(displacementSolution);
+
+            factorized = true;
+            factorizedRatio = poissonRatio;
+            ++nFactorizations;
+            return true;
+        }
+
+        Mesh const &mesh;
+        SparseMatrix K0, K1, A;
+        Vector lift0, lift1, forces;
+        std::vector<std::pair<Size, Value>> prescribed; // степень свободы и её значение
+        std::vector<char> fixedDofs;
+        Eigen::SimplicialLDLT<SparseMatrix> solver;
+        Vector forceSolution, displacementSolution;
+        bool assembled = false, factorized = false;
+        Value factorizedRatio = 0;
+        Size nFactorizations = 0, nSolutions = 0;
+    };
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include <Eigen/Dense>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace fem
+{
+    // Восстановление деформаций и напряжений по перемещениям сетки: значения в точках Гаусса,
+    // экстраполяция в узлы элемента и осреднение по смежным элементам, эквивалентные
+    // напряжения по Мизесу и главные напряжения. Элементы и узлы обрабатываются параллельно.
+    template <typename T>
+    class PostProcessor
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using Indices = typename Mesh::Indices;
+        using FiniteElement = typename Mesh::FiniteElement;
+        // Строки: элемент * nGaussPoints + точка (или узел), столбцы: xx, yy, xy
+        using Values = Eigen::Matrix<Value, Eigen::Dynamic, FiniteElement::nVoigt, Eigen::RowMajor>;
+        using PrincipalValues = Eigen::Matrix<Value, Eigen::Dynamic, 2, Eigen::RowMajor>;
+
+        PostProcessor(Mesh const &mesh, unsigned nThreads = 0) : mesh(mesh),
+                                                                 nThreads(nThreads != 0 ? nThreads : hardwareThreads())
+        {
+            mesh.calculateNodeElements(nodeOffsets, nodeElements);
+
+            // Билинейная экстраполяция из точек Гаусса (+-1/sqrt(3)) в углы (+-1)
+            Value const r = std::sqrt(Value(3));
+            Value const signX[4] = {-1, 1, 1, -1}, signY[4] = {-1, -1, 1, 1};
+            for (Size i = 0; i < FiniteElement::nNodes; ++i)
+            {
+                for (Size k = 0; k < FiniteElement::nGaussPoints; ++k)
+                {
+                    extrapolationMatrix(i, k) = (1 + signX[k] * signX[i] * r) * (1 + signY[k] * signY[i] * r) / 4;
+                }
+            }
+        }
+
+        // Один материал на всю сетку
+        bool calculateFields(Value const &elasticityModulus, Value const &poissonRatio)
+        {
+            if (!mesh.checkSingleMaterial("stress recovery"))
+                return false;
+            typename Mesh::Material const material{elasticityModulus, poissonRatio, 0};
+            this->recoverFields([&](Size const &) -> typename Mesh::Material const &
+                                { return material; });
+            return true;
+        }
+
+        // Материалы элементов из таблицы сетки
+        bool calculateFields()
+        {
+            if (!mesh.checkMaterialTable())
+                return false;
+            this->recoverFields([&](Size const &e) -> typename Mesh::Material const &
+                                { return mesh.getElementMaterial(e); });
+            return true;
+        }
+
+        const Values &getGaussStrains() const
+        {
+            return gaussStrains;
+        }
+
+        const Values &getGaussStresses() const
+        {
+            return gaussStresses;
+        }
+
+        const Values &getNodalStrains() const
+        {
+            return nodalStrains;
+        }
+
+        const Values &getNodalStresses() const
+        {
+            return nodalStresses;
+        }
+
+        const Vector &getVonMisesStresses() const
+        {
+            return vonMisesStresses;
+        }
+
+        const PrincipalValues &getPrincipalStresses() const
+        {
+            return principalStresses;
+        }
+
+        const Indices &getNodeOffsets() const
+        {
+            return nodeOffsets;
+        }
+
+        const Indices &getNodeElements() const
+        {
+            return nodeElements;
+        }
+
+        // Плоское напряжённое состояние
+        static Value calculateVonMises(Value const &sxx, Value const &syy, Value const &sxy)
+        {
+            return std::sqrt(sxx * sxx - sxx * syy + syy * syy + 3 * sxy * sxy);
+        }
+
+        static void calculatePrincipal(Value &s1, Value &s2, Value const &sxx, Value const &syy, Value const &sxy)
+        {
+            Value center = (sxx + syy) / 2;
+            Value radius = std::sqrt((sxx - syy) * (sxx - syy) / 4 + sxy * sxy);
+            s1 = center + radius;
+            s2 = center - radius;
+        }
+
+        void writeParaViewVtk(const std::string &filename) const
+        {
+            FEM_PROFILE("write VTK fields");
+            std::ofstream vtk(filename);
+            if (!vtk.is_open())
+            {
+                std::cerr << "Error: Could not open " << filename << " for writing!" << std::endl;
+                return;
+            }
+            mesh.writeParaViewVtk(vtk);
+
+            static char const *const components[] = {"xx", "yy", "xy"};
+            for (Size c = 0; c < FiniteElement::nVoigt; ++c)
+            {
+                this->writeScalars(vtk, std::string("stress_") + components[c], nodalStresses.col(c));
+            }
+            for (Size c = 0; c < FiniteElement::nVoigt; ++c)
+            {
+                this->writeScalars(vtk, std::string("strain_") + components[c], nodalStrains.col(c));
+            }
+            this->writeScalars(vtk, "von_mises", vonMisesStresses);
+            this->writeScalars(vtk, "principal_1", principalStresses.col(0));
+            this->writeScalars(vtk, "principal_2", principalStresses.col(1));
+
+            Size nElements = mesh.getNumElements();
+            Vector elementVonMises(nElements);
+            for (Size e = 0; e < nElements; ++e)
+            {
+                auto stress = gaussStresses.middleRows(e * FiniteElement::nGaussPoints, FiniteElement::nGaussPoints).colwise().mean();
+                elementVonMises(e) = calculateVonMises(stress(0), stress(1), stress(2));
+            }
+            vtk << "\nCELL_DATA " << nElements << "\n";
+            vtk << "SCALARS von_mises_element float 1\nLOOKUP_TABLE default\n";
+            for (Size e = 0; e < nElements; ++e)
+            {
+                vtk << elementVonMises(e) << "\n";
+            }
+            vtk.close();
+            std::cout << "Successfully wrote " << filename << std::endl;
+        }
+
+    private:
+        // materialOf(e) - материал элемента e
+        template <typename MaterialOf>
+        void recoverFields(MaterialOf const &materialOf)
+        {
+            FEM_PROFILE("stress recovery");
+            Size nElements = mesh.getNumElements(), nNodes = mesh.getNumNodes();
+            Size const nGauss = FiniteElement::nGaussPoints, nElemNodes = FiniteElement::nNodes;
+            gaussStrains.resize(nElements * nGauss, FiniteElement::nVoigt);
+            gaussStresses.resize(nElements * nGauss, FiniteElement::nVoigt);
+            Values cornerStrains(nElements * nElemNodes, FiniteElement::nVoigt);
+            Values cornerStresses(nElements * nElemNodes, FiniteElement::nVoigt);
+            auto const &u = mesh.getDisplacementVector();
+
+            parallelFor(0, nElements, [&](std::size_t e)
+                        {
+                            FiniteElement fe;
+                            typename FiniteElement::Nodes feNodes;
+                            typename FiniteElement::Displacements feDisplacements;
+                            typename FiniteElement::GaussValues strains, stresses;
+                            mesh.getElementNodes(feNodes, e);
+                            for (Size i = 0; i < FiniteElement::nElemDofs; ++i)
+                            {
+                                feDisplacements(i) = u(mesh.getElementDof(e, i));
+                            }
+                            auto const &material = materialOf(e);
+                            fe.calculateStrainsAndStresses(strains, stresses, feNodes, feDisplacements,
+                                                           material.elasticityModulus, material.poissonRatio);
+                            gaussStrains.middleRows(e * nGauss, nGauss) = strains.transpose();
+                            gaussStresses.middleRows(e * nGauss, nGauss) = stresses.transpose();
+                            cornerStrains.middleRows(e * nElemNodes, nElemNodes) = extrapolationMatrix * strains.transpose();
+                            cornerStresses.middleRows(e * nElemNodes, nElemNodes) = extrapolationMatrix * stresses.transpose(); },
+                        nThreads, 256);
+
+            nodalStrains.resize(nNodes, FiniteElement::nVoigt);
+            nodalStresses.resize(nNodes, FiniteElement::nVoigt);
+            vonMisesStresses.resize(nNodes);
+            principalStresses.resize(nNodes, 2);
+            auto const &elements = mesh.getElements();
+
+            parallelFor(0, nNodes, [&](std::size_t n)
+                        {
+                            Eigen::Matrix<Value, 1, FiniteElement::nVoigt> strain, stress;
+                            strain.setZero();
+                            stress.setZero();
+                            Size first = nodeOffsets(n), last = nodeOffsets(n + 1);
+                            for (Size k = first; k < last; ++k)
+                            {
+                                Size e = nodeElements(k), i = 0;
+                                while (elements(e)(i) != n)
+                                    ++i;
+                                strain += cornerStrains.row(e * nElemNodes + i);
+                                stress += cornerStresses.row(e * nElemNodes + i);
+                            }
+                            if (last > first)
+                            {
+                                strain /= Value(last - first);
+                                stress /= Value(last - first);
+                            }
+                            nodalStrains.row(n) = strain;
+                            nodalStresses.row(n) = stress;
+                            vonMisesStresses(n) = calculateVonMises(stress(0), stress(1), stress(2));
+                            calculatePrincipal(principalStresses(n, 0), principalStresses(n, 1),
+                                               stress(0), stress(1), stress(2)); },
+                        nThreads, 1024);
+        }
+
+        template <typename Column>
+        void writeScalars(std::ostream &vtk, std::string const &name, Column const &values) const
+        {
+            vtk << "SCALARS " << name << " float 1\nLOOKUP_TABLE default\n";
+            for (Eigen::Index i = 0; i < values.size(); ++i)
+            {
+                vtk << values(i) << "\n";
+            }
+        }
+
+        Mesh const &mesh;
+        unsigned nThreads;
+        Indices nodeOffsets, nodeElements;
+        Eigen::Matrix<Value, FiniteElement::nNodes, FiniteElement::nGaussPoints> extrapolationMatrix;
+        Values gaussStrains, gaussStresses;
+        Values nodalStrains, nodalStresses;
+        Vector vonMisesStresses;
+        PrincipalValues principalStresses;
+    };
+}
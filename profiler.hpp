@@ -0,0 +1,304 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// FEM_PROFILE("name") - замер до конца текущей области видимости; имя - строковый литерал.
+// С FEM_DISABLE_PROFILER замеры не компилируются вовсе
+#define FEM_PROFILE_CONCAT_IMPL(a, b) a##b
+#define FEM_PROFILE_CONCAT(a, b) FEM_PROFILE_CONCAT_IMPL(a, b)
+#ifdef FEM_DISABLE_PROFILER
+#define FEM_PROFILE(name) ((void)0)
+#else
+#define FEM_PROFILE(name) ::fem::ProfileScope FEM_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
+
+namespace fem
+{
+    // Иерархический профилировщик. Пока он не включён, замер стоит одной атомарной загрузки.
+    // Включённый профилировщик пишет завершённые области в кольцевой буфер своего потока без
+    // блокировок; при переполнении затираются самые старые записи. При выходе из программы
+    // печатается дерево областей (полное и собственное время, число вызовов) и, если задан файл,
+    // записывается трасса в формате Chrome trace_event (chrome://tracing, Perfetto).
+    // Сводку и трассу следует получать, когда рабочие потоки уже завершились
+    class Profiler
+    {
+    public:
+        using Size = unsigned long long int;
+        using Clock = std::chrono::steady_clock;
+
+        static Size const defaultCapacity = Size(1) << 16;
+
+        struct Event
+        {
+            char const *name;
+            std::int64_t start, duration; // нс от включения профилировщика
+            std::uint32_t depth;
+        };
+
+        static Profiler &instance()
+        {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        // traceFilename - трасса Chrome при выходе (пустое имя - только сводка);
+        // capacity - число записей в буфере каждого потока
+        void enable(std::string const &traceFilename = "", Size capacity = defaultCapacity)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            traceFile = traceFilename;
+            bufferCapacity = std::max<Size>(capacity, 1);
+            origin = Clock::now();
+            enabled.store(true, std::memory_order_release);
+        }
+
+        void disable()
+        {
+            enabled.store(false, std::memory_order_release);
+        }
+
+        bool isEnabled() const
+        {
+            return enabled.load(std::memory_order_relaxed);
+        }
+
+        // Печатать ли сводку при выходе (по умолчанию да, если профилировщик включался)
+        void setReportAtExit(bool report)
+        {
+            reportAtExit = report;
+        }
+
+        void reset()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &buffer : buffers)
+            {
+                buffer->events.clear();
+                buffer->next = 0;
+                buffer->dropped = 0;
+            }
+            origin = Clock::now();
+        }
+
+        void begin(std::int64_t &start)
+        {
+            ThreadBuffer &buffer = this->threadBuffer();
+            ++buffer.depth;
+            start = this->now();
+        }
+
+        void end(char const *name, std::int64_t const &start)
+        {
+            std::int64_t finish = this->now();
+            ThreadBuffer &buffer = this->threadBuffer();
+            --buffer.depth;
+            Event event{name, start, finish - start, buffer.depth};
+            if (buffer.events.size() < bufferCapacity)
+            {
+                buffer.events.push_back(event);
+                return;
+            }
+            buffer.events[buffer.next] = event;
+            buffer.next = (buffer.next + 1) % buffer.events.size();
+            ++buffer.dropped;
+        }
+
+        // Дерево областей всех потоков; области с одинаковым путём от корня объединяются
+        void printSummary(std::ostream &out) const
+        {
+            std::vector<SummaryNode> nodes(1);
+            Size dropped = 0;
+            for (auto const &buffer : this->snapshot(dropped))
+            {
+                std::vector<Size> stack;
+                for (auto const &event : buffer.second)
+                {
+                    while (stack.size() > event.depth)
+                        stack.pop_back();
+                    Size parent = stack.empty() ? 0 : stack.back();
+                    auto found = nodes[parent].children.find(event.name);
+                    Size node;
+                    if (found == nodes[parent].children.end())
+                    {
+                        node = nodes.size();
+                        nodes[parent].children.emplace(event.name, node);
+                        nodes[parent].order.push_back(node);
+                        nodes.emplace_back(event.name);
+                    }
+                    else
+                        node = found->second;
+                    nodes[node].total += event.duration;
+                    ++nodes[node].calls;
+                    stack.push_back(node);
+                }
+            }
+
+            out << "Profile (wall time, ms):" << std::endl;
+            out << std::setw(12) << "total" << std::setw(12) << "self" << std::setw(10) << "calls"
+                << std::setw(9) << "parent" << "  scope" << std::endl;
+            for (Size child : nodes[0].order)
+                this->printNode(out, nodes, child, 0, 0);
+            if (dropped != 0)
+                out << "Warning: " << dropped << " oldest profile records were overwritten; increase the buffer capacity" << std::endl;
+        }
+
+        bool writeChromeTrace(std::string const &filename) const
+        {
+            std::ofstream trace(filename);
+            if (!trace.is_open())
+            {
+                std::cerr << "Error: Could not open " << filename << " for writing!" << std::endl;
+                return false;
+            }
+            Size dropped = 0;
+            bool first = true;
+            trace << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+            for (auto const &buffer : this->snapshot(dropped))
+            {
+                for (auto const &event : buffer.second)
+                {
+                    trace << (first ? "\n" : ",\n") << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                          << buffer.first << ", \"ts\": " << event.start * 1e-3 << ", \"dur\": " << event.duration * 1e-3 << "}";
+                    first = false;
+                }
+            }
+            trace << "\n]}\n";
+            std::cout << "Profile trace written to " << filename << std::endl;
+            return true;
+        }
+
+        ~Profiler()
+        {
+            bool used = false;
+            for (auto const &buffer : buffers)
+                used = used || !buffer->events.empty();
+            if (!used)
+                return;
+            if (reportAtExit)
+                this->printSummary(std::cerr);
+            if (!traceFile.empty())
+                this->writeChromeTrace(traceFile);
+        }
+
+    private:
+        struct ThreadBuffer
+        {
+            std::vector<Event> events;
+            Size next = 0, dropped = 0; // next - самая старая запись заполненного буфера
+            std::uint32_t depth = 0, id = 0;
+        };
+
+        struct SummaryNode
+        {
+            explicit SummaryNode(char const *name = nullptr) : name(name) {}
+
+            char const *name;
+            std::int64_t total = 0;
+            Size calls = 0;
+            std::map<std::string, Size> children;
+            std::vector<Size> order; // дети в порядке первого завершения
+        };
+
+        Profiler() = default;
+
+        std::int64_t now() const
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+        }
+
+        ThreadBuffer &threadBuffer()
+        {
+            thread_local ThreadBuffer *buffer = nullptr;
+            if (buffer == nullptr)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                buffers.emplace_back(new ThreadBuffer);
+                buffer = buffers.back().get();
+                buffer->id = std::uint32_t(buffers.size());
+            }
+            return *buffer;
+        }
+
+        // Записи каждого потока по возрастанию начала; объемлющая область раньше вложенной
+        std::vector<std::pair<std::uint32_t, std::vector<Event>>> snapshot(Size &dropped) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<std::pair<std::uint32_t, std::vector<Event>>> result;
+            for (auto const &buffer : buffers)
+            {
+                std::vector<Event> events(buffer->events.begin() + buffer->next, buffer->events.end());
+                events.insert(events.end(), buffer->events.begin(), buffer->events.begin() + buffer->next);
+                std::stable_sort(events.begin(), events.end(), [](Event const &a, Event const &b)
+                                 { return a.start != b.start ? a.start < b.start : a.depth < b.depth; });
+                dropped += buffer->dropped;
+                result.emplace_back(buffer->id, std::move(events));
+            }
+            return result;
+        }
+
+        void printNode(std::ostream &out, std::vector<SummaryNode> const &nodes, Size const &node,
+                       std::int64_t const &parentTotal, Size const &level) const
+        {
+            SummaryNode const &n = nodes[node];
+            std::int64_t children = 0;
+            for (Size child : n.order)
+                children += nodes[child].total;
+            double self = std::max<std::int64_t>(n.total - children, 0) * 1e-6;
+            out << std::fixed << std::setprecision(3) << std::setw(12) << n.total * 1e-6 << std::setw(12) << self
+                << std::setw(10) << n.calls;
+            if (parentTotal > 0)
+                out << std::setw(8) << std::setprecision(1) << 100.0 * n.total / parentTotal << "%";
+            else
+                out << std::setw(9) << "";
+            out << "  " << std::string(2 * level, ' ') << n.name << std::endl;
+            out.unsetf(std::ios::floatfield);
+            for (Size child : n.order)
+                this->printNode(out, nodes, child, n.total, level + 1);
+        }
+
+        std::atomic<bool> enabled{false};
+        bool reportAtExit = true;
+        Size bufferCapacity = defaultCapacity;
+        std::string traceFile;
+        Clock::time_point origin = Clock::now();
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    };
+
+    // Замер области видимости; выключенный профилировщик ничего не записывает
+    class ProfileScope
+    {
+    public:
+        explicit ProfileScope(char const *name) : name(name),
+                                                  active(Profiler::instance().isEnabled())
+        {
+            if (active)
+                Profiler::instance().begin(start);
+        }
+
+        ~ProfileScope()
+        {
+            if (active)
+                Profiler::instance().end(name, start);
+        }
+
+        ProfileScope(ProfileScope const &) = delete;
+        ProfileScope &operator=(ProfileScope const &) = delete;
+
+    private:
+        char const *name;
+        bool active;
+        std::int64_t start = 0;
+    };
+}
@@ -0,0 +1,421 @@
+#pragma once
+
+#include "mesh.hpp"
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace fem
+{
+    // Повторный расчёт после локальных изменений: смены материала нескольких элементов
+    // (в том числе повреждения с понижением жёсткости) и добавления или снятия опор.
+    // Изменённая матрица A' отличается от разложенной базовой A лишь в строках и столбцах
+    // множества D затронутых степеней свободы: A' - A = E_D M E_D^T + G E_D^T + E_D G^T, где
+    // M - блок D x D разности, G - её столбцы D вне D. Это поправка ранга k = |D| (2|D| при
+    // смене опор), и решение получается по формуле Вудбери без нового разложения:
+    // u = x - W (I + C U^T W)^-1 C U^T x, x = A^-1 b, W = A^-1 U, A' = A + U C U^T.
+    // При k больше maxUpdateRank матрица A' раскладывается заново и становится базовой
+    template <typename T>
+    class Reanalysis
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using Matrix = typename Mesh::Matrix;
+        using SparseMatrix = typename Mesh::SparseMatrix;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using Material = std::pair<Value, Value>; // модуль упругости и коэффициент Пуассона
+
+        // Базовое состояние: материал (E, nu) во всех элементах, опоры и силы сетки. Если в сетке
+        // несколько материалов или сборку отклонил бюджет памяти сетки, solve возвращает false
+        Reanalysis(Mesh const &mesh, Value const &elasticityModulus, Value const &poissonRatio)
+            : mesh(mesh), defaultMaterial(elasticityModulus, poissonRatio), forces(mesh.getForceVector())
+        {
+            SparseMatrix K1;
+            if (!mesh.checkSingleMaterial("reanalysis") || !mesh.calculateAffineStiffnessMatrices(baseStiffness, K1))
+                return;
+            baseStiffness += poissonRatio * K1;
+            baseStiffness *= elasticityModulus / (1 - poissonRatio * poissonRatio);
+            this->initialize();
+        }
+
+        // Базовое состояние с материалами элементов из таблицы сетки; изменения материала
+        // отсчитываются от материала элемента в таблице
+        Reanalysis(Mesh const &mesh) : mesh(mesh), materialTable(true), forces(mesh.getForceVector())
+        {
+            if (!mesh.calculateSparseStiffnessMatrix(baseStiffness))
+                return;
+            this->initialize();
+        }
+
+        // Материал элемента e; исходные материалы и опоры возвращает reset()
+        bool setElementMaterial(Size const &e, Value const &elasticityModulus, Value const &poissonRatio)
+        {
+            if (e >= mesh.getNumElements())
+            {
+                std::cerr << "Error: element " << e << " does not exist!" << std::endl;
+                return false;
+            }
+            materials[e] = Material(elasticityModulus, poissonRatio);
+            updateReady = false;
+            return true;
+        }
+
+        // Жёсткость элемента e, умноженная на factor относительно базового материала (0 - элемент удалён)
+        bool setElementStiffnessFactor(Size const &e, Value const &factor)
+        {
+            if (e >= mesh.getNumElements())
+            {
+                std::cerr << "Error: element " << e << " does not exist!" << std::endl;
+                return false;
+            }
+            Material original = this->getOriginalMaterial(e);
+            return this->setElementMaterial(e, factor * original.first, original.second);
+        }
+
+        // Опора: перемещение узла node по направлению direction равно value
+        void setSupport(Size const &node, Size const &direction, Value const &value = 0)
+        {
+            prescribed[node * FiniteElement::nNodeDofs + direction] = value;
+            updateReady = false;
+        }
+
+        void removeSupport(Size const &node, Size const &direction)
+        {
+            prescribed.erase(node * FiniteElement::nNodeDofs + direction);
+            updateReady = false;
+        }
+
+        // Возврат к материалу и опорам, с которыми была построена сетка
+        void reset()
+        {
+            materials.clear();
+            prescribed.clear();
+            for (auto const &p : mesh.getPrescribedDofs())
+                prescribed[p.first] = p.second;
+            updateReady = false;
+        }
+
+        // Ранг, начиная с которого вместо поправки выполняется новое разложение
+        void setMaxUpdateRank(Size const &rank)
+        {
+            maxUpdateRank = rank;
+            updateReady = false;
+        }
+
+        bool solve(Vector &u)
+        {
+            return this->solve(u, forces);
+        }
+
+        // Перемещения при текущих изменениях и узловых силах loads; силы связанных узлов
+        // передаются ведущим, как в Mesh::calculateForceVector
+        bool solve(Vector &u, Eigen::Ref<const Vector> const &loads)
+        {
+            if (!assembled)
+            {
+                std::cerr << "Error: stiffness matrices are not assembled!" << std::endl;
+                return false;
+            }
+            if (!updateReady && !this->prepareUpdate())
+                return false;
+
+            // Правая часть для A': заданные перемещения переносятся с матрицей K + dK
+            Vector g = Vector::Zero(baseStiffness.rows());
+            for (auto const &p : prescribed)
+                g(p.first) = p.second;
+            Vector b = loads;
+            mesh.transferConstraintLoads(b);
+            b.noalias() -= baseStiffness * g;
+            b.noalias() -= stiffnessChange * g;
+            for (Size dof = 0; dof < constrainedDofs.size(); ++dof)
+            {
+                if (constrainedDofs[dof])
+                    b(dof) = 0;
+            }
+            for (auto const &p : prescribed)
+                b(p.first) = p.second;
+
+            u = solver.solve(b);
+            if (updateBasis.cols() != 0)
+            {
+                Vector projected = updateCoefficients * (updateBasis.transpose() * u);
+                u.noalias() -= updateSolutions * capacitance.solve(projected);
+            }
+            mesh.applyConstraints(u);
+            return true;
+        }
+
+        // Ранг поправки последнего решения (0 - решение по базовому разложению)
+        Size getUpdateRank() const
+        {
+            return updateBasis.cols();
+        }
+
+        Size getNumFactorizations() const
+        {
+            return nFactorizations;
+        }
+
+        // Разложение текущей изменённой матрицы; она становится базовой
+        bool refactorize()
+        {
+            if (!assembled)
+                return false;
+            SparseMatrix change = this->assembleStiffnessChange();
+            SparseMatrix K = baseStiffness + change;
+            std::vector<char> fixed = this->fixedDofs(prescribed);
+            K.prune([&](Eigen::Index const &row, Eigen::Index const &col, Value const &)
+                    { return !fixed[row] && !fixed[col]; });
+            for (Size dof = 0; dof < fixed.size(); ++dof)
+            {
+                if (fixed[dof])
+                    K.coeffRef(dof, dof) = 1;
+            }
+            K.makeCompressed();
+            solver.compute(K);
+            if (solver.info() != Eigen::Success)
+            {
+                std::cerr << "Error: stiffness matrix factorization failed, check supports and element stiffness!" << std::endl;
+                updateReady = false;
+                return false;
+            }
+            ++nFactorizations;
+
+            baseStiffness += change;
+            baseMaterials = materials;
+            basePrescribed = prescribed;
+            stiffnessChange.resize(baseStiffness.rows(), baseStiffness.cols());
+            updateBasis.resize(baseStiffness.rows(), 0);
+            updateSolutions.resize(baseStiffness.rows(), 0);
+            updateReady = true;
+            return true;
+        }
+
+    private:
+        void initialize()
+        {
+            constrainedDofs = mesh.getConstrainedDofs();
+            constraintOf.assign(mesh.getNumNodes(), ~Size(0));
+            auto const &constraints = mesh.getConstraints();
+            for (Size c = 0; c < constraints.size(); ++c)
+                constraintOf[constraints(c).node] = c;
+            for (auto const &p : mesh.getPrescribedDofs())
+                prescribed[p.first] = p.second;
+            assembled = true;
+            this->refactorize();
+        }
+
+        // Материал элемента e, с которым собрана исходная матрица
+        Material getOriginalMaterial(Size const &e) const
+        {
+            if (!materialTable)
+                return defaultMaterial;
+            auto const &material = mesh.getElementMaterial(e);
+            return Material(material.elasticityModulus, material.poissonRatio);
+        }
+
+        // Множество D, поправка U C U^T и её ёмкостная матрица I + C U^T A^-1 U
+        bool prepareUpdate()
+        {
+            stiffnessChange = this->assembleStiffnessChange();
+            std::vector<char> fixed = this->fixedDofs(prescribed), baseFixed = this->fixedDofs(basePrescribed);
+            Size nDofs = baseStiffness.rows();
+
+            std::vector<Size> changed;
+            for (Eigen::Index j = 0; j < stiffnessChange.outerSize(); ++j)
+            {
+                if (stiffnessChange.col(j).nonZeros() != 0)
+                    changed.push_back(j);
+            }
+            for (Size dof = 0; dof < nDofs; ++dof)
+            {
+                if (fixed[dof] != baseFixed[dof])
+                    changed.push_back(dof);
+            }
+            std::sort(changed.begin(), changed.end());
+            changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+            Size nChanged = changed.size();
+            std::vector<Size> position(nDofs, ~Size(0));
+            for (Size k = 0; k < nChanged; ++k)
+                position[changed[k]] = k;
+
+            // Столбцы разности A' - A по D: блок M и внешняя часть G
+            Matrix M = Matrix::Zero(nChanged, nChanged);
+            std::vector<Eigen::Triplet<Value>> outer;
+            Vector column(nDofs);
+            for (Size k = 0; k < nChanged; ++k)
+            {
+                Size dof = changed[k];
+                column.setZero();
+                this->addMaskedColumn(column, dof, fixed, Value(1), true);
+                this->addMaskedColumn(column, dof, baseFixed, Value(-1), false);
+                for (Size i = 0; i < nDofs; ++i)
+                {
+                    if (column(i) == 0)
+                        continue;
+                    if (position[i] != ~Size(0))
+                        M(position[i], k) = column(i);
+                    else
+                        outer.emplace_back(i, k, column(i));
+                }
+            }
+
+            Size rank = outer.empty() ? nChanged : 2 * nChanged;
+            if (rank > maxUpdateRank)
+                return this->refactorize();
+            updateBasis.resize(nDofs, rank);
+            if (rank == 0)
+            {
+                updateReady = true;
+                return true;
+            }
+
+            std::vector<Eigen::Triplet<Value>> triplets(outer);
+            for (Size k = 0; k < nChanged; ++k)
+            {
+                triplets.emplace_back(changed[k], outer.empty() ? k : nChanged + k, Value(1));
+            }
+            // Для внешней части U = [G, E_D] и C = [[0, I], [I, M]], иначе U = E_D и C = M
+            updateBasis.setFromTriplets(triplets.begin(), triplets.end());
+            updateCoefficients.setZero(rank, rank);
+            if (outer.empty())
+                updateCoefficients = M;
+            else
+            {
+                updateCoefficients.topRightCorner(nChanged, nChanged).setIdentity();
+                updateCoefficients.bottomLeftCorner(nChanged, nChanged).setIdentity();
+                updateCoefficients.bottomRightCorner(nChanged, nChanged) = M;
+            }
+
+            updateSolutions = solver.solve(Matrix(updateBasis));
+            capacitance.compute(Matrix::Identity(rank, rank) + updateCoefficients * (updateBasis.transpose() * updateSolutions));
+            if (!capacitance.isInvertible())
+            {
+                std::cerr << "Error: modified stiffness matrix is singular, check supports and element stiffness!" << std::endl;
+                return false;
+            }
+            updateReady = true;
+            return true;
+        }
+
+        // column += sign * столбец dof матрицы (K + dK или K) с заменой закреплённых строк и столбцов
+        // единичными
+        void addMaskedColumn(Vector &column, Size const &dof, std::vector<char> const &fixed,
+                             Value const &sign, bool const &modified) const
+        {
+            if (fixed[dof])
+            {
+                column(dof) += sign;
+                return;
+            }
+            for (typename SparseMatrix::InnerIterator it(baseStiffness, dof); it; ++it)
+            {
+                if (!fixed[it.row()])
+                    column(it.row()) += sign * it.value();
+            }
+            if (!modified)
+                return;
+            for (typename SparseMatrix::InnerIterator it(stiffnessChange, dof); it; ++it)
+            {
+                if (!fixed[it.row()])
+                    column(it.row()) += sign * it.value();
+            }
+        }
+
+        // dK = sum P_e (K_e(материал) - K_e(базовый материал)) P_e^T по элементам, где они различаются
+        SparseMatrix assembleStiffnessChange() const
+        {
+            std::map<Size, std::pair<Material, Material>> differences;
+            for (auto const &m : materials)
+                differences[m.first] = std::make_pair(m.second, this->getOriginalMaterial(m.first));
+            for (auto const &m : baseMaterials)
+            {
+                auto it = differences.find(m.first);
+                if (it == differences.end())
+                    differences[m.first] = std::make_pair(this->getOriginalMaterial(m.first), m.second);
+                else
+                    it->second.second = m.second;
+            }
+
+            FiniteElement fe;
+            typename FiniteElement::Nodes feNodes;
+            typename FiniteElement::StiffnessMatrix current, base;
+            std::vector<Eigen::Triplet<Value>> triplets;
+            std::vector<std::pair<Size, Value>> dofs[FiniteElement::nElemDofs];
+            for (auto const &d : differences)
+            {
+                if (d.second.first == d.second.second)
+                    continue;
+                Size e = d.first;
+                mesh.getElementNodes(feNodes, e);
+                fe.calculateStiffnessMatrix(current, feNodes, d.second.first.first, d.second.first.second);
+                fe.calculateStiffnessMatrix(base, feNodes, d.second.second.first, d.second.second.second);
+                current -= base;
+                for (Size i = 0; i < FiniteElement::nElemDofs; ++i)
+                    this->expandElementDof(dofs[i], e, i);
+                for (Size j = 0; j < FiniteElement::nElemDofs; ++j)
+                {
+                    for (Size i = 0; i < FiniteElement::nElemDofs; ++i)
+                    {
+                        for (auto const &dofJ : dofs[j])
+                        {
+                            for (auto const &dofI : dofs[i])
+                                triplets.emplace_back(dofI.first, dofJ.first, dofI.second * dofJ.second * current(i, j));
+                        }
+                    }
+                }
+            }
+            SparseMatrix change(baseStiffness.rows(), baseStiffness.cols());
+            change.setFromTriplets(triplets.begin(), triplets.end());
+            return change;
+        }
+
+        // Степени свободы с весами, через которые выражается степень свободы i элемента e
+        void expandElementDof(std::vector<std::pair<Size, Value>> &dofs, Size const &e, Size const &i) const
+        {
+            dofs.clear();
+            Size node = mesh.getElements()(e)(i / FiniteElement::nNodeDofs), direction = i % FiniteElement::nNodeDofs;
+            if (constraintOf[node] == ~Size(0))
+            {
+                dofs.emplace_back(node * FiniteElement::nNodeDofs + direction, Value(1));
+                return;
+            }
+            auto const &constraint = mesh.getConstraints()(constraintOf[node]);
+            for (Size k = 0; k < constraint.masters.size(); ++k)
+                dofs.emplace_back(constraint.masters(k) * FiniteElement::nNodeDofs + direction, constraint.weights(k));
+        }
+
+        std::vector<char> fixedDofs(std::map<Size, Value> const &supports) const
+        {
+            std::vector<char> fixed = constrainedDofs;
+            for (auto const &p : supports)
+                fixed[p.first] = 1;
+            return fixed;
+        }
+
+        Mesh const &mesh;
+        bool materialTable = false; // исходные материалы из таблицы сетки, а не defaultMaterial
+        Material defaultMaterial;
+        Vector forces;
+        SparseMatrix baseStiffness, stiffnessChange;
+        std::vector<char> constrainedDofs;
+        std::vector<Size> constraintOf;
+        std::map<Size, Material> materials, baseMaterials; // элементы с материалом, отличным от базового
+        std::map<Size, Value> prescribed, basePrescribed;  // опоры: степень свободы и её перемещение
+        Eigen::SimplicialLDLT<SparseMatrix> solver;
+        SparseMatrix updateBasis;
+        Matrix updateCoefficients, updateSolutions;
+        Eigen::FullPivLU<Matrix> capacitance;
+        Size maxUpdateRank = 64;
+        bool assembled = false, updateReady = false;
+        Size nFactorizations = 0;
+    };
+}
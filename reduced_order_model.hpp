@@ -0,0 +1,301 @@
+#pragma once
+
+#include "mesh.hpp"
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace fem
+{
+    // Проекционная модель пониженного порядка (POD-Галёркин) для многократных расчётов одной
+    // сетки при разных нагрузках и значениях заданных перемещений. Офлайн: снимки перемещений
+    // (полные решения) сжимаются сингулярным разложением в базис Phi из r векторов, и матрица
+    // жёсткости проецируется: Kr = Phi^T K Phi. Онлайн: u = Phi q + g, где Kr q = Phi^T (F - K g),
+    // g - заданные перемещения; решение системы r x r и восстановление поля стоят O(r^2 + n r).
+    // Индикатор погрешности - относительная невязка полной системы ||b - K Phi q|| / ||b||,
+    // b = F - K g; она раскрывается через заранее спроектированные K Phi и (K Phi)^T K Phi и
+    // не требует умножения на K. Из-за вычитания квадратов её нижний предел - около sqrt(eps)
+    template <typename T>
+    class ReducedOrderModel
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using Matrix = typename Mesh::Matrix;
+        using SparseMatrix = typename Mesh::SparseMatrix;
+        using FiniteElement = typename Mesh::FiniteElement;
+
+        // Разреженная матрица жёсткости и вектор сил сетки должны быть вычислены; набор
+        // закреплённых степеней свободы берётся из сетки, меняются только их значения
+        ReducedOrderModel(Mesh const &mesh) : mesh(mesh), K(mesh.getSparseStiffnessMatrix())
+        {
+            Size nDofs = K.rows();
+            fixedDofs = mesh.getConstrainedDofs();
+            for (auto const &p : mesh.getPrescribedDofs())
+            {
+                prescribedDofs.push_back(p.first);
+                fixedDofs[p.first] = 1;
+            }
+
+            // Столбцы заданных перемещений в строках свободных степеней свободы: вклад K_fp g
+            std::vector<Eigen::Triplet<Value>> triplets;
+            for (Size k = 0; k < prescribedDofs.size(); ++k)
+            {
+                for (typename SparseMatrix::InnerIterator it(K, prescribedDofs[k]); it; ++it)
+                {
+                    if (!fixedDofs[it.row()])
+                        triplets.emplace_back(it.row(), k, it.value());
+                }
+            }
+            prescribedColumns.resize(nDofs, prescribedDofs.size());
+            prescribedColumns.setFromTriplets(triplets.begin(), triplets.end());
+        }
+
+        // Снимок из полного решения при нагрузке forces и заданных перемещениях из
+        // prescribedDisplacements (используются только закреплённые степени свободы)
+        bool addSnapshot(Eigen::Ref<const Vector> const &forces, Eigen::Ref<const Vector> const &prescribedDisplacements)
+        {
+            if (!fullSolverReady)
+            {
+                SparseMatrix A = K;
+                A.prune([&](Eigen::Index const &row, Eigen::Index const &col, Value const &)
+                        { return !fixedDofs[row] && !fixedDofs[col]; });
+                for (Size dof = 0; dof < fixedDofs.size(); ++dof)
+                {
+                    if (fixedDofs[dof])
+                        A.coeffRef(dof, dof) = 1;
+                }
+                A.makeCompressed();
+                fullSolver.compute(A);
+                if (fullSolver.info() != Eigen::Success)
+                {
+                    std::cerr << "Error: stiffness matrix factorization failed!" << std::endl;
+                    return false;
+                }
+                fullSolverReady = true;
+            }
+            Vector prescribedValues = this->gatherPrescribed(prescribedDisplacements);
+            Vector rhs = forces;
+            mesh.transferConstraintLoads(rhs);
+            rhs.noalias() -= prescribedColumns * prescribedValues;
+            for (Size dof = 0; dof < fixedDofs.size(); ++dof)
+            {
+                if (fixedDofs[dof])
+                    rhs(dof) = 0;
+            }
+            snapshots.push_back(fullSolver.solve(rhs));
+            return true;
+        }
+
+        // Снимок при заданных перемещениях сетки
+        bool addSnapshot(Eigen::Ref<const Vector> const &forces)
+        {
+            return this->addSnapshot(forces, this->meshPrescribed());
+        }
+
+        // Готовое поле перемещений, например из другого решателя; заданные перемещения вычитаются
+        void addSnapshotDisplacements(Eigen::Ref<const Vector> const &displacements)
+        {
+            Vector snapshot = displacements;
+            for (Size dof = 0; dof < fixedDofs.size(); ++dof)
+            {
+                if (fixedDofs[dof])
+                    snapshot(dof) = 0;
+            }
+            snapshots.push_back(std::move(snapshot));
+        }
+
+        // Базис из не более чем maxRank левых сингулярных векторов снимков с sigma_k >= tolerance * sigma_1.
+        // При большом числе снимков разложение рандомизированное
+        bool buildBasis(Size const &maxRank = 50,
+                        Value const &tolerance = std::sqrt(Eigen::NumTraits<Value>::epsilon()))
+        {
+            Size nSnapshots = snapshots.size();
+            if (nSnapshots == 0 || maxRank == 0)
+            {
+                std::cerr << "Error: no snapshots to build a reduced basis from!" << std::endl;
+                return false;
+            }
+            Matrix S(K.rows(), nSnapshots);
+            for (Size k = 0; k < nSnapshots; ++k)
+                S.col(k) = snapshots[k];
+
+            Matrix U;
+            if (nSnapshots > 2 * (maxRank + oversampling))
+                this->randomizedSvd(U, singularValues, S, maxRank);
+            else
+            {
+                Eigen::BDCSVD<Matrix> svd(S, Eigen::ComputeThinU);
+                U = svd.matrixU();
+                singularValues = svd.singularValues();
+            }
+
+            Size rank = 0;
+            while (rank < std::min<Size>(maxRank, singularValues.size()) &&
+                   singularValues(rank) > tolerance * singularValues(0))
+                ++rank;
+            if (rank == 0)
+            {
+                std::cerr << "Error: all snapshots are zero!" << std::endl;
+                return false;
+            }
+            basis = U.leftCols(rank);
+
+            // Проекции: Kr = Phi^T K Phi и Phi^T K_fp для переноса заданных перемещений; для невязки -
+            // K Phi по свободным строкам и её матрица Грама
+            stiffnessBasis = K * basis;
+            for (Size dof = 0; dof < fixedDofs.size(); ++dof)
+            {
+                if (fixedDofs[dof])
+                    stiffnessBasis.row(dof).setZero();
+            }
+            reducedMatrix = basis.transpose() * stiffnessBasis;
+            reducedLift = (prescribedColumns.transpose() * basis).transpose();
+            residualGram = stiffnessBasis.transpose() * stiffnessBasis;
+            reducedSolver.compute(reducedMatrix);
+            if (reducedSolver.info() != Eigen::Success)
+            {
+                std::cerr << "Error: reduced stiffness matrix is not positive definite!" << std::endl;
+                basis.resize(0, 0);
+                return false;
+            }
+            return true;
+        }
+
+        // Онлайн-решение: O(r^2) на приведённую систему и O(n r) на проекции и восстановление
+        bool solve(Vector &u, Eigen::Ref<const Vector> const &forces, Eigen::Ref<const Vector> const &prescribedDisplacements)
+        {
+            if (basis.cols() == 0)
+            {
+                std::cerr << "Error: reduced basis must be built before solving!" << std::endl;
+                return false;
+            }
+            Vector prescribedValues = this->gatherPrescribed(prescribedDisplacements);
+            // Силы связанных узлов передаются ведущим, как в Mesh::calculateForceVector
+            freeLoads = forces;
+            mesh.transferConstraintLoads(freeLoads);
+            reducedForces.noalias() = basis.transpose() * freeLoads;
+            reducedForces.noalias() -= reducedLift * prescribedValues;
+            reducedCoordinates = reducedSolver.solve(reducedForces);
+            u.noalias() = basis * reducedCoordinates;
+            for (Size k = 0; k < prescribedDofs.size(); ++k)
+                u(prescribedDofs[k]) = prescribedValues(k);
+            mesh.applyConstraints(u);
+
+            // ||b - K Phi q||^2 = ||b||^2 - 2 q^T (K Phi)^T b + q^T (K Phi)^T K Phi q по свободным строкам
+            freeLoads.noalias() -= prescribedColumns * prescribedValues;
+            for (Size dof = 0; dof < fixedDofs.size(); ++dof)
+            {
+                if (fixedDofs[dof])
+                    freeLoads(dof) = 0;
+            }
+            Value rhsNorm2 = freeLoads.squaredNorm();
+            projectedRhs.noalias() = stiffnessBasis.transpose() * freeLoads;
+            Value residualNorm2 = rhsNorm2 - 2 * reducedCoordinates.dot(projectedRhs) +
+                                  reducedCoordinates.dot(residualGram * reducedCoordinates);
+            Value residualNorm = std::sqrt(std::max<Value>(residualNorm2, 0));
+            errorIndicator = rhsNorm2 > 0 ? residualNorm / std::sqrt(rhsNorm2) : residualNorm;
+            return true;
+        }
+
+        bool solve(Vector &u, Eigen::Ref<const Vector> const &forces)
+        {
+            return this->solve(u, forces, this->meshPrescribed());
+        }
+
+        // Относительная невязка последнего онлайн-решения
+        Value getErrorIndicator() const
+        {
+            return errorIndicator;
+        }
+
+        Size getRank() const
+        {
+            return basis.cols();
+        }
+
+        Size getNumSnapshots() const
+        {
+            return snapshots.size();
+        }
+
+        const Vector &getSingularValues() const
+        {
+            return singularValues;
+        }
+
+        const Matrix &getBasis() const
+        {
+            return basis;
+        }
+
+        const Vector &getReducedCoordinates() const
+        {
+            return reducedCoordinates;
+        }
+
+    private:
+        static Size const oversampling = 10;
+
+        // Рандомизированное разложение: подпространство образа по rank + oversampling случайным
+        // проекциям с одной степенной итерацией, затем точное разложение малой матрицы Q^T S
+        void randomizedSvd(Matrix &U, Vector &values, Matrix const &S, Size const &rank) const
+        {
+            Size width = std::min<Size>(rank + oversampling, S.cols());
+            std::mt19937 generator(12345);
+            std::normal_distribution<double> distribution;
+            Matrix omega(S.cols(), width);
+            for (Eigen::Index j = 0; j < omega.cols(); ++j)
+            {
+                for (Eigen::Index i = 0; i < omega.rows(); ++i)
+                    omega(i, j) = Value(distribution(generator));
+            }
+            Matrix Q = Eigen::HouseholderQR<Matrix>(S * omega).householderQ() * Matrix::Identity(S.rows(), width);
+            Matrix Z = S.transpose() * Q;
+            Q = Eigen::HouseholderQR<Matrix>(S * Z).householderQ() * Matrix::Identity(S.rows(), width);
+            Matrix B = Q.transpose() * S;
+            Eigen::BDCSVD<Matrix> svd(B, Eigen::ComputeThinU);
+            U = Q * svd.matrixU();
+            values = svd.singularValues();
+        }
+
+        Vector gatherPrescribed(Eigen::Ref<const Vector> const &prescribedDisplacements) const
+        {
+            Vector values(prescribedDofs.size());
+            for (Size k = 0; k < prescribedDofs.size(); ++k)
+                values(k) = prescribedDisplacements(prescribedDofs[k]);
+            return values;
+        }
+
+        Vector meshPrescribed() const
+        {
+            Vector displacements = Vector::Zero(K.rows());
+            for (auto const &p : mesh.getPrescribedDofs())
+                displacements(p.first) = p.second;
+            return displacements;
+        }
+
+        Mesh const &mesh;
+        SparseMatrix K, prescribedColumns;
+        std::vector<Size> prescribedDofs;
+        std::vector<char> fixedDofs;
+        Eigen::SimplicialLDLT<SparseMatrix> fullSolver;
+        bool fullSolverReady = false;
+        std::vector<Vector> snapshots;
+        Vector singularValues;
+        Matrix basis, stiffnessBasis, reducedMatrix, reducedLift, residualGram;
+        Eigen::LLT<Matrix> reducedSolver;
+        Vector reducedCoordinates, reducedForces, projectedRhs, freeLoads;
+        Value errorIndicator = 0;
+    };
+
+    template <typename T>
+    typename ReducedOrderModel<T>::Size const ReducedOrderModel<T>::oversampling;
+}
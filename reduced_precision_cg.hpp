@@ -0,0 +1,308 @@
+#pragma once
+
+#include "profiler.hpp"
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+namespace fem
+{
+    // Точность хранения значений матрицы в сопряжённых градиентах
+    enum class StoragePrecision
+    {
+        BFloat16,
+        Float,
+        Full
+    };
+
+    // Симметричная разреженная матрица в CSR с 32-битными индексами и внедиагональными значениями в
+    // Storage (double, float или Eigen::bfloat16); произведение накапливается в double. Умножение
+    // матрицы на вектор упирается в пропускную способность памяти, и время итерации пропорционально
+    // байтам на ненулевой элемент - 12 у SparseMatrix<double>, 8 у float, 6 у bfloat16.
+    // Диагональ хранится в double и поправлена на ошибки округления строки так, что сдвиги
+    // сетки как целого (постоянные по каждому из blockSize направлений векторы) по-прежнему
+    // дают нулевые силы. Без поправки округлённая матрица жёсткости теряет эти моды, и у гибких
+    // конструкций погрешность решения растёт до обусловленности, умноженной на eps хранения
+    template <typename Storage>
+    class CompactSparseMatrix
+    {
+    public:
+        using Size = unsigned long long int;
+        using Vector = Eigen::VectorXd;
+
+        CompactSparseMatrix() = default;
+
+        // Столбцы симметричной матрицы в формате CSC совпадают с её строками
+        template <typename Scalar>
+        explicit CompactSparseMatrix(Eigen::SparseMatrix<Scalar> const &matrix, Size const &blockSize = 1)
+        {
+            Size n = matrix.outerSize();
+            starts.assign(1, 0);
+            diagonalValues.setZero(n);
+            for (Size i = 0; i < n; ++i)
+            {
+                double compensation = 0;
+                for (typename Eigen::SparseMatrix<Scalar>::InnerIterator it(matrix, i); it; ++it)
+                {
+                    Size j = it.row();
+                    double value = static_cast<double>(it.value());
+                    if (j == i)
+                    {
+                        diagonalValues(i) += value;
+                        continue;
+                    }
+                    columns.push_back(std::int32_t(j));
+                    values.push_back(Storage(value));
+                    if (j % blockSize == i % blockSize)
+                        compensation += value - static_cast<double>(values.back());
+                }
+                diagonalValues(i) += compensation;
+                starts.push_back(std::int32_t(columns.size()));
+            }
+        }
+
+        Size rows() const
+        {
+            return diagonalValues.size();
+        }
+
+        // y = A x
+        void multiply(Vector const &x, Vector &y) const
+        {
+            Size n = this->rows();
+            y.resize(n);
+            double const *xData = x.data(), *diagonalData = diagonalValues.data();
+            std::int32_t const *starts = this->starts.data(), *columns = this->columns.data();
+            Storage const *values = this->values.data();
+            for (Size i = 0; i < n; ++i)
+            {
+                double sum = diagonalData[i] * xData[i];
+                for (std::int32_t k = starts[i]; k < starts[i + 1]; ++k)
+                    sum += static_cast<double>(values[k]) * xData[columns[k]];
+                y(i) = sum;
+            }
+        }
+
+        Vector const &diagonal() const
+        {
+            return diagonalValues;
+        }
+
+        Size getMemoryBytes() const
+        {
+            return (starts.size() + columns.size()) * sizeof(std::int32_t) + values.size() * sizeof(Storage) +
+                   diagonalValues.size() * sizeof(double);
+        }
+
+    private:
+        std::vector<std::int32_t> starts, columns;
+        std::vector<Storage> values;
+        Vector diagonalValues;
+    };
+
+    // Сопряжённые градиенты с предобуславливателем Якоби, в которых матрица хранится с
+    // пониженной точностью, а векторы и скалярные произведения - в double. Итерации сходятся для
+    // округлённой матрицы, поэтому каждые checkInterval итераций невязка b - A x проверяется по
+    // исходной матрице. Когда она вдвое больше рекуррентной или погрешность хранения ||(A~ - A) x||
+    // не позволяет достичь tolerance, точность хранения повышается: bfloat16 -> float -> исходная
+    // матрица, и итерации продолжаются с текущего приближения
+    template <typename Scalar>
+    class ReducedPrecisionCg
+    {
+    public:
+        using Size = unsigned long long int;
+        using Vector = Eigen::VectorXd;
+        using SparseMatrix = Eigen::SparseMatrix<Scalar>;
+
+        static Size const checkInterval = 25;
+
+        // Матрица симметрична и хранится целиком (обе треугольные части); blockSize - число
+        // степеней свободы узла, по которому поправляется диагональ округлённых матриц
+        ReducedPrecisionCg(SparseMatrix const &matrix, StoragePrecision precision = StoragePrecision::Float,
+                           Size const &blockSize = 1) : matrix(matrix), initialPrecision(precision), blockSize(blockSize)
+        {
+            // Матрица во float уже хранится во float
+            if (initialPrecision == StoragePrecision::Float && std::is_same<Scalar, float>::value)
+                initialPrecision = StoragePrecision::Full;
+            this->setPrecision(initialPrecision);
+            inverseDiagonal = matrix.diagonal().template cast<double>();
+            for (Eigen::Index i = 0; i < inverseDiagonal.size(); ++i)
+                inverseDiagonal(i) = inverseDiagonal(i) > 0 ? 1 / inverseDiagonal(i) : 1;
+        }
+
+        // x - начальное приближение и результат; tolerance - относительная невязка ||b - A x|| / ||b||
+        bool solve(Vector &x, Vector const &b, double const &tolerance, Size const &maxIterations = 10000)
+        {
+            double const gapRatio = 2;
+            iterations = 0;
+            escalations = 0;
+            this->setPrecision(initialPrecision);
+            if (x.size() != b.size())
+                x.setZero(b.size());
+            double bNorm = b.norm();
+            if (bNorm == 0)
+            {
+                x.setZero();
+                residual = 0;
+                return true;
+            }
+
+            Vector r, z, p, q;
+            this->multiplyFull(x, q);
+            r = b - q;
+            residual = r.norm() / bNorm;
+            z = inverseDiagonal.cwiseProduct(r);
+            p = z;
+            double rz = r.dot(z);
+            while (residual > tolerance)
+            {
+                if (iterations >= maxIterations)
+                {
+                    std::cerr << "Warning: reduced-precision conjugate gradients stopped after " << iterations
+                              << " iterations with residual " << residual << std::endl;
+                    return false;
+                }
+                FEM_PROFILE("iteration");
+                this->multiply(p, q);
+                double alpha = rz / p.dot(q);
+                x += alpha * p;
+                r -= alpha * q;
+                ++iterations;
+
+                double recurrenceResidual = r.norm() / bNorm;
+                bool escalated = false;
+                if (precision == StoragePrecision::Full)
+                    residual = recurrenceResidual;
+                else if (recurrenceResidual <= tolerance || iterations % checkInterval == 0)
+                {
+                    this->multiplyFull(x, q);
+                    Vector trueResidual = b - q;
+                    residual = trueResidual.norm() / bNorm;
+                    if (residual <= tolerance)
+                        break;
+                    // Погрешность хранения на текущем приближении ||(A~ - A) x||: невязка
+                    // округлённой системы не опустится ниже неё
+                    this->multiply(x, z);
+                    double storageError = (z - q).norm() / bNorm;
+                    // Рекуррентная невязка ушла ниже исходной - итерации сходятся к решению округлённой
+                    // системы; или погрешность хранения уже не позволяет достичь tolerance
+                    if (residual > gapRatio * recurrenceResidual || gapRatio * storageError > tolerance)
+                    {
+                        this->setPrecision(precision == StoragePrecision::BFloat16 && !std::is_same<Scalar, float>::value ? StoragePrecision::Float : StoragePrecision::Full);
+                        ++escalations;
+                        escalated = true;
+                        r = trueResidual;
+                    }
+                }
+                z = inverseDiagonal.cwiseProduct(r);
+                double rzNext = r.dot(z);
+                // Направления, сопряжённые относительно округлённой матрицы, после её смены отбрасываются
+                p = escalated ? z : Vector(z + (rzNext / rz) * p);
+                rz = rzNext;
+            }
+            // Рекуррентная невязка с исходной матрицей отличается от истинной на ошибки округления
+            this->multiplyFull(x, q);
+            residual = (b - q).norm() / bNorm;
+            return true;
+        }
+
+        Size getIterations() const
+        {
+            return iterations;
+        }
+
+        // Сколько раз пришлось повысить точность хранения
+        Size getNumEscalations() const
+        {
+            return escalations;
+        }
+
+        // Точность, с которой завершилось последнее решение
+        StoragePrecision getPrecision() const
+        {
+            return precision;
+        }
+
+        // Относительная невязка по исходной матрице
+        double getResidual() const
+        {
+            return residual;
+        }
+
+        // Память под матрицу в текущей точности хранения, байт
+        Size getMemoryBytes() const
+        {
+            switch (precision)
+            {
+            case StoragePrecision::BFloat16:
+                return bfloat16Matrix.getMemoryBytes();
+            case StoragePrecision::Float:
+                return floatMatrix.getMemoryBytes();
+            default:
+                return (matrix.outerSize() + 1 + matrix.nonZeros()) * sizeof(typename SparseMatrix::StorageIndex) +
+                       matrix.nonZeros() * sizeof(Scalar);
+            }
+        }
+
+    private:
+        // Округлённая матрица строится при переходе на её точность, предыдущая освобождается
+        void setPrecision(StoragePrecision const &target)
+        {
+            if (target == StoragePrecision::BFloat16 && bfloat16Matrix.rows() == 0)
+                bfloat16Matrix = CompactSparseMatrix<Eigen::bfloat16>(matrix, blockSize);
+            if (target == StoragePrecision::Float && floatMatrix.rows() == 0)
+                floatMatrix = CompactSparseMatrix<float>(matrix, blockSize);
+            if (target != StoragePrecision::BFloat16)
+                bfloat16Matrix = CompactSparseMatrix<Eigen::bfloat16>();
+            if (target != StoragePrecision::Float)
+                floatMatrix = CompactSparseMatrix<float>();
+            precision = target;
+        }
+
+        void multiply(Vector const &x, Vector &y) const
+        {
+            switch (precision)
+            {
+            case StoragePrecision::BFloat16:
+                bfloat16Matrix.multiply(x, y);
+                break;
+            case StoragePrecision::Float:
+                floatMatrix.multiply(x, y);
+                break;
+            case StoragePrecision::Full:
+                this->multiplyFull(x, y);
+                break;
+            }
+        }
+
+        // Произведение с исходной матрицей; по симметрии столбец j - это строка j
+        void multiplyFull(Vector const &x, Vector &y) const
+        {
+            y.resize(matrix.rows());
+            double const *xData = x.data();
+            for (Eigen::Index j = 0; j < matrix.outerSize(); ++j)
+            {
+                double sum = 0;
+                for (typename SparseMatrix::InnerIterator it(matrix, j); it; ++it)
+                    sum += static_cast<double>(it.value()) * xData[it.row()];
+                y(j) = sum;
+            }
+        }
+
+        SparseMatrix const &matrix;
+        CompactSparseMatrix<float> floatMatrix;
+        CompactSparseMatrix<Eigen::bfloat16> bfloat16Matrix;
+        StoragePrecision initialPrecision, precision = StoragePrecision::Full;
+        Size blockSize;
+        Vector inverseDiagonal;
+        Size iterations = 0, escalations = 0;
+        double residual = 0;
+    };
+
+    template <typename Scalar>
+    typename ReducedPrecisionCg<Scalar>::Size const ReducedPrecisionCg<Scalar>::checkInterval;
+}
@@ -0,0 +1,789 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "mesh_source.hpp"
+#include "profiler.hpp"
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fem
+{
+    // Решения одной сетки при меняющихся нагрузках, заданных перемещениях и материале.
+    // Матрица жёсткости аффинна по материалу, K(E, nu) = E / (1 - nu^2) (K0 + nu K1) (см.
+    // ParameterSweep), поэтому K0 и K1 собираются один раз, смена E - масштабирование, а
+    // разложение зависит только от nu и набора закреплённых степеней свободы. Последние capacity
+    // разложений хранятся, и запрос с уже встречавшимися nu и закреплениями стоит двух
+    // треугольных решений. Новые значения заданных перемещений разложения не меняют
+    template <typename T>
+    class WarmSolver
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using SparseMatrix = typename Mesh::SparseMatrix;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using Prescribed = typename Mesh::Prescribed;
+
+        static Size const defaultCapacity = 4;
+
+        explicit WarmSolver(Mesh const &mesh, Size capacity = defaultCapacity) : mesh(mesh),
+                                                                                capacity(std::max<Size>(capacity, 1))
+        {
+            assembled = mesh.checkSingleMaterial("warm solve") && mesh.calculateAffineStiffnessMatrices(K0, K1);
+        }
+
+        // forces - узловые силы; силы связанных узлов передаются ведущим, как в Mesh::calculateForceVector
+        bool solve(Vector &u, Vector const &forces, Prescribed const &prescribed,
+                   Value const &elasticityModulus, Value const &poissonRatio)
+        {
+            FEM_PROFILE("warm solve");
+            if (!assembled)
+            {
+                std::cerr << "Error: stiffness matrices are not assembled!" << std::endl;
+                return false;
+            }
+            if (!(elasticityModulus > 0))
+            {
+                std::cerr << "Error: elasticity modulus must be positive!" << std::endl;
+                return false;
+            }
+            if (!(poissonRatio > -1 && poissonRatio < 1))
+            {
+                std::cerr << "Error: Poisson's ratio must lie in (-1, 1)!" << std::endl;
+                return false;
+            }
+            Size nDofs = K0.rows();
+            std::vector<Size> fixed;
+            for (auto const &p : prescribed)
+            {
+                if (p.first >= nDofs)
+                {
+                    std::cerr << "Error: prescribed DOF " << p.first << " does not exist!" << std::endl;
+                    return false;
+                }
+                fixed.push_back(p.first);
+            }
+            std::sort(fixed.begin(), fixed.end());
+            fixed.erase(std::unique(fixed.begin(), fixed.end()), fixed.end());
+
+            Factorization *factorization = this->findFactorization(fixed, poissonRatio);
+            reused = factorization != nullptr;
+            if (!reused && (factorization = this->factorize(std::move(fixed), poissonRatio)) == nullptr)
+                return false;
+
+            // K_ff u_f = F_f - K_fc g делится на E / (1 - nu^2)
+            Vector g = Vector::Zero(nDofs);
+            for (auto const &p : prescribed)
+                g(p.first) = p.second;
+            Vector F = forces;
+            mesh.transferConstraintLoads(F);
+            Vector rhs = (1 - poissonRatio * poissonRatio) / elasticityModulus * F - K0 * g - poissonRatio * (K1 * g);
+            for (auto const &p : prescribed)
+                rhs(p.first) = p.second;
+            {
+                FEM_PROFILE("triangular solves");
+                u = factorization->solver.solve(rhs);
+            }
+            mesh.applyConstraints(u);
+            ++nSolutions;
+            return true;
+        }
+
+        Size getNumDofs() const
+        {
+            return K0.rows();
+        }
+
+        // Собраны ли K0 и K1: сборку может отклонить бюджет памяти сетки, а сетку с несколькими
+        // материалами решатель с одним материалом на запрос не принимает
+        bool isAssembled() const
+        {
+            return assembled;
+        }
+
+        // Использовано ли последним решением хранимое разложение
+        bool isReused() const
+        {
+            return reused;
+        }
+
+        Size getNumFactorizations() const
+        {
+            return nFactorizations;
+        }
+
+        Size getNumSolutions() const
+        {
+            return nSolutions;
+        }
+
+    private:
+        struct Factorization
+        {
+            std::vector<Size> fixed;
+            Value poissonRatio;
+            Eigen::SimplicialLDLT<SparseMatrix> solver;
+        };
+
+        // Найденное разложение переносится в начало списка, вытесняется последнее
+        Factorization *findFactorization(std::vector<Size> const &fixed, Value const &poissonRatio)
+        {
+            for (auto it = factorizations.begin(); it != factorizations.end(); ++it)
+            {
+                if ((*it)->poissonRatio == poissonRatio && (*it)->fixed == fixed)
+                {
+                    factorizations.splice(factorizations.begin(), factorizations, it);
+                    return factorizations.front().get();
+                }
+            }
+            return nullptr;
+        }
+
+        Factorization *factorize(std::vector<Size> fixed, Value const &poissonRatio)
+        {
+            FEM_PROFILE("factorization");
+            std::vector<char> isFixed(K0.rows(), 0);
+            for (Size dof : fixed)
+                isFixed[dof] = 1;
+            SparseMatrix A = K0 + poissonRatio * K1;
+            A.prune([&](Eigen::Index const &row, Eigen::Index const &col, Value const &)
+                    { return row == col || (!isFixed[row] && !isFixed[col]); });
+            for (Size dof : fixed)
+                A.coeffRef(dof, dof) = 1;
+            A.makeCompressed();
+
+            std::unique_ptr<Factorization> factorization(new Factorization);
+            factorization->solver.compute(A);
+            if (factorization->solver.info() != Eigen::Success)
+            {
+                std::cerr << "Error: stiffness matrix factorization failed!" << std::endl;
+                return nullptr;
+            }
+            factorization->fixed = std::move(fixed);
+            factorization->poissonRatio = poissonRatio;
+            if (factorizations.size() >= capacity)
+                factorizations.pop_back();
+            factorizations.push_front(std::move(factorization));
+            ++nFactorizations;
+            return factorizations.front().get();
+        }
+
+        Mesh const &mesh;
+        Size capacity;
+        SparseMatrix K0, K1;
+        std::list<std::unique_ptr<Factorization>> factorizations;
+        bool assembled = false, reused = false;
+        Size nFactorizations = 0, nSolutions = 0;
+    };
+
+    template <typename T>
+    typename WarmSolver<T>::Size const WarmSolver<T>::defaultCapacity;
+
+    // Разделяемая память POSIX (shm_open) под массив результатов. Создавший буфер удаляет
+    // его имя при закрытии, открывший по имени - только отображение
+    class SharedBuffer
+    {
+    public:
+        SharedBuffer() = default;
+        SharedBuffer(SharedBuffer const &) = delete;
+        SharedBuffer &operator=(SharedBuffer const &) = delete;
+
+        ~SharedBuffer()
+        {
+            this->close();
+        }
+
+        bool create(std::string const &bufferName, std::size_t bytes)
+        {
+            this->close();
+            int descriptor = shm_open(bufferName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (descriptor < 0)
+            {
+                std::cerr << "Error: Could not create shared memory " << bufferName << ": " << std::strerror(errno) << "!" << std::endl;
+                return false;
+            }
+            name = bufferName;
+            owner = true;
+            bool mapped = ftruncate(descriptor, off_t(bytes)) == 0 && this->map(descriptor, bytes);
+            ::close(descriptor);
+            if (!mapped)
+                this->close();
+            return mapped;
+        }
+
+        bool open(std::string const &bufferName)
+        {
+            this->close();
+            int descriptor = shm_open(bufferName.c_str(), O_RDWR, 0);
+            if (descriptor < 0)
+            {
+                std::cerr << "Error: Could not open shared memory " << bufferName << ": " << std::strerror(errno) << "!" << std::endl;
+                return false;
+            }
+            name = bufferName;
+            struct stat bufferStat;
+            bool mapped = fstat(descriptor, &bufferStat) == 0 && this->map(descriptor, std::size_t(bufferStat.st_size));
+            ::close(descriptor);
+            if (!mapped)
+                this->close();
+            return mapped;
+        }
+
+        void close()
+        {
+            if (address != nullptr)
+                munmap(address, length);
+            if (owner)
+                shm_unlink(name.c_str());
+            address = nullptr;
+            length = 0;
+            owner = false;
+            name.clear();
+        }
+
+        char *data() const
+        {
+            return static_cast<char *>(address);
+        }
+
+        std::size_t size() const
+        {
+            return length;
+        }
+
+        std::string const &getName() const
+        {
+            return name;
+        }
+
+    private:
+        bool map(int const &descriptor, std::size_t const &bytes)
+        {
+            void *map = bytes != 0 ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+            if (map == MAP_FAILED)
+            {
+                std::cerr << "Error: Could not map shared memory " << name << "!" << std::endl;
+                return false;
+            }
+            address = map;
+            length = bytes;
+            return true;
+        }
+
+        void *address = nullptr;
+        std::size_t length = 0;
+        std::string name;
+        bool owner = false;
+    };
+
+    // Сообщения сервера решений. Каждое сообщение - заголовок и payloadBytes байт данных;
+    // на запрос приходит ответ того же типа, при status != 0 данные ответа - текст ошибки
+    struct SolveMessage
+    {
+        enum Type : std::uint32_t
+        {
+            Open = 1,    // данные - описание сетки (loadMesh); ответ - OpenReply
+            Solve = 2,   // SolveRequest, затем nLoads и nDisps записей Cond; ответ - SolveReply
+            Shutdown = 3 // остановка сервера
+        };
+
+        std::uint32_t type;
+        std::uint32_t status;
+        std::uint64_t payloadBytes;
+
+        struct OpenReply
+        {
+            std::uint64_t model, nNodes, nDofs;
+        };
+
+        // Пустой список нагрузок или заданных перемещений означает заданные в сетке
+        struct SolveRequest
+        {
+            std::uint64_t model;
+            double elasticityModulus, poissonRatio;
+            std::uint64_t nLoads, nDisps;
+            char buffer[64]; // имя разделяемой памяти для nDofs перемещений в double
+        };
+
+        struct Cond
+        {
+            std::uint64_t node, direction;
+            double value;
+        };
+
+        struct SolveReply
+        {
+            std::uint64_t nDofs, nFactorizations;
+            std::uint32_t reused, reserved;
+            double time; // с, на сервере
+        };
+
+        static bool writeAll(int const &socket, void const *data, std::size_t bytes)
+        {
+            char const *bytesLeft = static_cast<char const *>(data);
+            while (bytes != 0)
+            {
+                ssize_t written = ::send(socket, bytesLeft, bytes, MSG_NOSIGNAL);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                    return false;
+                bytesLeft += written;
+                bytes -= std::size_t(written);
+            }
+            return true;
+        }
+
+        static bool readAll(int const &socket, void *data, std::size_t bytes)
+        {
+            char *bytesLeft = static_cast<char *>(data);
+            while (bytes != 0)
+            {
+                ssize_t received = ::recv(socket, bytesLeft, bytes, 0);
+                if (received < 0 && errno == EINTR)
+                    continue;
+                if (received <= 0)
+                    return false;
+                bytesLeft += received;
+                bytes -= std::size_t(received);
+            }
+            return true;
+        }
+
+        static bool send(int const &socket, std::uint32_t const &type, std::uint32_t const &status, std::string const &payload)
+        {
+            SolveMessage header{type, status, payload.size()};
+            return writeAll(socket, &header, sizeof(header)) && writeAll(socket, payload.data(), payload.size());
+        }
+
+        static bool receive(int const &socket, SolveMessage &header, std::string &payload)
+        {
+            // Ограничение защищает от выделения памяти по испорченному заголовку
+            std::uint64_t const maxPayloadBytes = std::uint64_t(1) << 32;
+            if (!readAll(socket, &header, sizeof(header)) || header.payloadBytes > maxPayloadBytes)
+                return false;
+            payload.resize(header.payloadBytes);
+            return readAll(socket, &payload[0], payload.size());
+        }
+
+        template <typename Record>
+        static void append(std::string &payload, Record const &record)
+        {
+            payload.append(reinterpret_cast<char const *>(&record), sizeof(Record));
+        }
+    };
+
+    // Сервер решений на сокете Unix: сетки, матрицы K0, K1 и разложения остаются в памяти между
+    // запросами. Каждое соединение обслуживает свой поток; запросы к одной сетке выполняются по
+    // очереди, к разным - параллельно. Перемещения записываются в разделяемую память клиента,
+    // по сокету идут только описание запроса и ответ
+    template <typename T>
+    class SolveServer
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using FiniteElement = typename Mesh::FiniteElement;
+
+        SolveServer() = default;
+        SolveServer(SolveServer const &) = delete;
+        SolveServer &operator=(SolveServer const &) = delete;
+
+        ~SolveServer()
+        {
+            this->stop();
+            // Потоки соединений отсоединены; ждём, пока завершится последний
+            std::unique_lock<std::mutex> lock(mutex);
+            connectionsFinished.wait(lock, [this]()
+                                     { return nConnections == 0; });
+            lock.unlock();
+            if (listener >= 0)
+                ::close(listener);
+            if (!socketPath.empty())
+                unlink(socketPath.c_str());
+        }
+
+        bool listen(std::string const &path)
+        {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path))
+            {
+                std::cerr << "Error: socket path " << path << " is too long!" << std::endl;
+                return false;
+            }
+            std::strcpy(address.sun_path, path.c_str());
+            listener = socket(AF_UNIX, SOCK_STREAM, 0);
+            unlink(path.c_str());
+            if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+                ::listen(listener, 16) != 0)
+            {
+                std::cerr << "Error: Could not listen on " << path << ": " << std::strerror(errno) << "!" << std::endl;
+                return false;
+            }
+            socketPath = path;
+            return true;
+        }
+
+        // Сетка загружается заранее, чтобы первый запрос к ней не ждал сборки
+        bool preload(std::string const &description)
+        {
+            std::string error;
+            return this->openModel(description, error) != nullptr;
+        }
+
+        // Принимает соединения до запроса Shutdown или stop()
+        void run()
+        {
+            while (!stopping)
+            {
+                int connection = accept(listener, nullptr, nullptr);
+                if (connection < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    break;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping)
+                {
+                    ::close(connection);
+                    break;
+                }
+                clients.push_back(connection);
+                ++nConnections;
+                std::thread([this, connection]()
+                            {
+                                this->serve(connection);
+                                this->release(connection); })
+                    .detach();
+            }
+        }
+
+        void stop()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping.exchange(true))
+                return;
+            // shutdown будит потоки, ждущие в accept и recv
+            if (listener >= 0)
+                ::shutdown(listener, SHUT_RDWR);
+            for (int client : clients)
+                ::shutdown(client, SHUT_RDWR);
+        }
+
+    private:
+        struct Model
+        {
+            std::unique_ptr<Mesh> mesh;
+            std::unique_ptr<WarmSolver<T>> solver;
+            Vector forces;
+            typename WarmSolver<T>::Prescribed prescribed;
+            std::mutex mutex;
+            Size id;
+        };
+
+        Model *openModel(std::string const &description, std::string &error)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto found = modelIds.find(description);
+                if (found != modelIds.end())
+                    return models[found->second].get();
+            }
+            // Сетка читается и собирается без блокировки; если её успел открыть другой поток, копия отбрасывается
+            std::unique_ptr<Model> model(new Model);
+            if (!loadMesh(description, model->mesh))
+            {
+                error = "could not load mesh '" + description + "'";
+                return nullptr;
+            }
+            model->mesh->calculateForceVector();
+            model->forces = model->mesh->getForceVector();
+            model->prescribed = model->mesh->getPrescribedDofs();
+            model->solver.reset(new WarmSolver<T>(*model->mesh));
+            if (!model->solver->isAssembled())
+            {
+                error = "could not assemble stiffness matrices of mesh '" + description + "'";
+                return nullptr;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = modelIds.find(description);
+            if (found != modelIds.end())
+                return models[found->second].get();
+            model->id = models.size();
+            modelIds.emplace(description, model->id);
+            models.push_back(std::move(model));
+            std::cout << "Model " << models.back()->id << ": " << description << ", "
+                      << models.back()->solver->getNumDofs() << " DOFs" << std::endl;
+            return models.back().get();
+        }
+
+        void serve(int const &connection)
+        {
+            SolveMessage header;
+            std::string payload, reply, error;
+            SharedBuffer buffer;
+            while (SolveMessage::receive(connection, header, payload))
+            {
+                reply.clear();
+                error.clear();
+                if (header.type == SolveMessage::Open)
+                {
+                    if (Model *model = this->openModel(payload, error))
+                        SolveMessage::append(reply, SolveMessage::OpenReply{model->id, model->mesh->getNumNodes(), model->solver->getNumDofs()});
+                }
+                else if (header.type == SolveMessage::Solve)
+                    this->solve(payload, buffer, reply, error);
+                else if (header.type == SolveMessage::Shutdown)
+                {
+                    SolveMessage::send(connection, header.type, 0, reply);
+                    this->stop();
+                    break;
+                }
+                else
+                    error = "unknown request type " + std::to_string(header.type);
+
+                if (!SolveMessage::send(connection, header.type, error.empty() ? 0 : 1, error.empty() ? reply : error))
+                    break;
+            }
+        }
+
+        // Последнее действие потока соединения: после уведомления сервер может быть разрушен
+        void release(int const &connection)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            clients.erase(std::remove(clients.begin(), clients.end(), connection), clients.end());
+            ::close(connection);
+            if (--nConnections == 0)
+                connectionsFinished.notify_all();
+        }
+
+        void solve(std::string const &payload, SharedBuffer &buffer, std::string &reply, std::string &error)
+        {
+            auto start = std::chrono::steady_clock::now();
+            SolveMessage::SolveRequest request;
+            if (payload.size() < sizeof(request))
+            {
+                error = "truncated solve request";
+                return;
+            }
+            std::memcpy(&request, payload.data(), sizeof(request));
+            // Счётчики сверяются с длиной сообщения до умножения, чтобы оно не переполнилось
+            std::uint64_t maxConds = (payload.size() - sizeof(request)) / sizeof(SolveMessage::Cond);
+            if (request.nLoads > maxConds || request.nDisps > maxConds - request.nLoads ||
+                payload.size() != sizeof(request) + (request.nLoads + request.nDisps) * sizeof(SolveMessage::Cond))
+            {
+                error = "solve request size does not match its load and displacement counts";
+                return;
+            }
+            Model *model = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (request.model < models.size())
+                    model = models[request.model].get();
+            }
+            if (model == nullptr)
+            {
+                error = "model " + std::to_string(request.model) + " is not open";
+                return;
+            }
+
+            Size nNodes = model->mesh->getNumNodes(), nDofs = model->solver->getNumDofs();
+            std::vector<SolveMessage::Cond> conds(request.nLoads + request.nDisps);
+            if (!conds.empty())
+                std::memcpy(conds.data(), payload.data() + sizeof(request), conds.size() * sizeof(SolveMessage::Cond));
+            for (auto const &cond : conds)
+            {
+                if (cond.node >= nNodes || cond.direction >= FiniteElement::nNodeDofs)
+                {
+                    error = "condition on node " + std::to_string(cond.node) + ", direction " + std::to_string(cond.direction) + " is out of range";
+                    return;
+                }
+            }
+            request.buffer[sizeof(request.buffer) - 1] = 0;
+            std::string bufferName = request.buffer;
+            // Отображение буфера соединения сохраняется между запросами
+            if (buffer.getName() != bufferName && !buffer.open(bufferName))
+            {
+                error = "could not open shared memory " + bufferName;
+                return;
+            }
+            if (buffer.size() < nDofs * sizeof(double))
+            {
+                error = "shared memory " + bufferName + " holds fewer than " + std::to_string(nDofs) + " doubles";
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(model->mutex);
+            Vector forces = request.nLoads != 0 ? Vector(Vector::Zero(nDofs)) : model->forces;
+            for (Size k = 0; k < request.nLoads; ++k)
+                forces(conds[k].node * FiniteElement::nNodeDofs + conds[k].direction) += Value(conds[k].value);
+            typename WarmSolver<T>::Prescribed prescribed;
+            for (Size k = request.nLoads; k < conds.size(); ++k)
+                prescribed.emplace_back(conds[k].node * FiniteElement::nNodeDofs + conds[k].direction, Value(conds[k].value));
+            Vector u;
+            if (!model->solver->solve(u, forces, request.nDisps != 0 ? prescribed : model->prescribed,
+                                      Value(request.elasticityModulus), Value(request.poissonRatio)))
+            {
+                error = "solve failed";
+                return;
+            }
+            Eigen::Map<Eigen::VectorXd>(reinterpret_cast<double *>(buffer.data()), nDofs) = u.template cast<double>();
+
+            SolveMessage::SolveReply solveReply{};
+            solveReply.nDofs = nDofs;
+            solveReply.nFactorizations = model->solver->getNumFactorizations();
+            solveReply.reused = model->solver->isReused();
+            solveReply.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            SolveMessage::append(reply, solveReply);
+        }
+
+        int listener = -1;
+        std::string socketPath;
+        std::atomic<bool> stopping{false};
+        std::mutex mutex;
+        std::vector<int> clients;
+        Size nConnections = 0;
+        std::condition_variable connectionsFinished;
+        std::map<std::string, Size> modelIds;
+        std::vector<std::unique_ptr<Model>> models;
+    };
+
+    // Клиент сервера решений: соединение и буфер перемещений в разделяемой памяти
+    class SolveClient
+    {
+    public:
+        using Cond = SolveMessage::Cond;
+
+        SolveClient() = default;
+        SolveClient(SolveClient const &) = delete;
+        SolveClient &operator=(SolveClient const &) = delete;
+
+        ~SolveClient()
+        {
+            if (connection >= 0)
+                ::close(connection);
+        }
+
+        bool connect(std::string const &path)
+        {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path))
+            {
+                std::cerr << "Error: socket path " << path << " is too long!" << std::endl;
+                return false;
+            }
+            std::strcpy(address.sun_path, path.c_str());
+            connection = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (connection < 0 || ::connect(connection, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+            {
+                std::cerr << "Error: Could not connect to " << path << ": " << std::strerror(errno) << "!" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // Открывает сетку на сервере и создаёт буфер под её перемещения
+        bool open(std::string const &description, SolveMessage::OpenReply &model)
+        {
+            std::string reply;
+            if (!this->request(SolveMessage::Open, description, reply, sizeof(model)))
+                return false;
+            std::memcpy(&model, reply.data(), sizeof(model));
+            std::size_t bytes = model.nDofs * sizeof(double);
+            if (buffer.size() >= bytes)
+                return true;
+            return buffer.create("/fem_solve_" + std::to_string(getpid()) + "_" + std::to_string(model.model), bytes);
+        }
+
+        // Перемещения доступны через displacements() до следующего запроса
+        bool solve(std::uint64_t const &model, double const &elasticityModulus, double const &poissonRatio,
+                   std::vector<Cond> const &loads, std::vector<Cond> const &disps, SolveMessage::SolveReply &result)
+        {
+            SolveMessage::SolveRequest request{};
+            request.model = model;
+            request.elasticityModulus = elasticityModulus;
+            request.poissonRatio = poissonRatio;
+            request.nLoads = loads.size();
+            request.nDisps = disps.size();
+            std::strncpy(request.buffer, buffer.getName().c_str(), sizeof(request.buffer) - 1);
+            std::string payload, reply;
+            SolveMessage::append(payload, request);
+            for (auto const &cond : loads)
+                SolveMessage::append(payload, cond);
+            for (auto const &cond : disps)
+                SolveMessage::append(payload, cond);
+            if (!this->request(SolveMessage::Solve, payload, reply, sizeof(result)))
+                return false;
+            std::memcpy(&result, reply.data(), sizeof(result));
+            displacementCount = result.nDofs;
+            return true;
+        }
+
+        bool shutdown()
+        {
+            std::string reply;
+            return this->request(SolveMessage::Shutdown, "", reply, 0);
+        }
+
+        Eigen::Map<const Eigen::VectorXd> displacements() const
+        {
+            return Eigen::Map<const Eigen::VectorXd>(reinterpret_cast<double const *>(buffer.data()), displacementCount);
+        }
+
+    private:
+        bool request(std::uint32_t const &type, std::string const &payload, std::string &reply, std::size_t const &replyBytes)
+        {
+            SolveMessage header;
+            if (!SolveMessage::send(connection, type, 0, payload) || !SolveMessage::receive(connection, header, reply))
+            {
+                std::cerr << "Error: lost connection to the solve server!" << std::endl;
+                return false;
+            }
+            if (header.status != 0)
+            {
+                std::cerr << "Error: solve server: " << reply << "!" << std::endl;
+                return false;
+            }
+            if (reply.size() < replyBytes)
+            {
+                std::cerr << "Error: truncated reply from the solve server!" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        int connection = -1;
+        SharedBuffer buffer;
+        std::size_t displacementCount = 0;
+    };
+}
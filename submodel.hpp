@@ -0,0 +1,282 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace fem
+{
+    // Поиск элемента, содержащего точку: равномерная сетка корзин над габаритом сетки,
+    // в каждой корзине - элементы, чьи габаритные прямоугольники её пересекают.
+    // Число корзин порядка числа элементов, поэтому поиск в среднем O(1)
+    template <typename T>
+    class PointLocator
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Indices = typename Mesh::Indices;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using Coordinates = typename FiniteElement::Coordinates;
+
+        static Size const none = ~Size(0);
+
+        PointLocator(Mesh const &mesh) : mesh(mesh)
+        {
+            Size nElements = mesh.getNumElements();
+            boxes.resize(nElements, 4);
+            FiniteElement fe;
+            typename FiniteElement::Nodes feNodes;
+            for (Size e = 0; e < nElements; ++e)
+            {
+                mesh.getElementNodes(feNodes, e);
+                Coordinates lsX, lsY;
+                fe.findLimits(lsX, lsY, feNodes);
+                boxes.row(e) << lsX(0), lsY(0), lsX(1), lsY(1);
+            }
+            if (nElements == 0)
+                return;
+
+            origin << boxes.col(0).minCoeff(), boxes.col(1).minCoeff();
+            Value width = boxes.col(2).maxCoeff() - origin(0), height = boxes.col(3).maxCoeff() - origin(1);
+            Value cellSize = std::sqrt(width * height / nElements);
+            if (!(cellSize > 0))
+                cellSize = std::max(width, height) / std::max<Size>(nElements, 1);
+            nCellsX = std::max<Size>(1, Size(std::ceil(width / cellSize)));
+            nCellsY = std::max<Size>(1, Size(std::ceil(height / cellSize)));
+            cellWidth = width / nCellsX;
+            cellHeight = height / nCellsY;
+            tolerance = Value(1e-5) * std::max(cellWidth, cellHeight);
+
+            // Корзины в виде CSR: подсчёт, префиксные суммы, заполнение
+            cellOffsets.setZero(nCellsX * nCellsY + 1);
+            this->forEachElementCell([&](Size const &cell, Size const &)
+                                     { ++cellOffsets(cell + 1); });
+            for (Size c = 0; c < nCellsX * nCellsY; ++c)
+                cellOffsets(c + 1) += cellOffsets(c);
+            cellElements.resize(cellOffsets(nCellsX * nCellsY));
+            Indices next = cellOffsets.head(nCellsX * nCellsY);
+            this->forEachElementCell([&](Size const &cell, Size const &e)
+                                     { cellElements(next(cell)++) = e; });
+        }
+
+        // Элемент, содержащий точку, и её локальные координаты относительно центра элемента
+        Size locate(Coordinates const &point, Value &xi, Value &eta) const
+        {
+            if (cellOffsets.size() == 0)
+                return none;
+            Size cell = this->getCell(point(0), point(1));
+            if (cell == none)
+                return none;
+            for (Size k = cellOffsets(cell); k < cellOffsets(cell + 1); ++k)
+            {
+                Size e = cellElements(k);
+                if (point(0) >= boxes(e, 0) - tolerance && point(0) <= boxes(e, 2) + tolerance &&
+                    point(1) >= boxes(e, 1) - tolerance && point(1) <= boxes(e, 3) + tolerance)
+                {
+                    xi = point(0) - (boxes(e, 0) + boxes(e, 2)) / 2;
+                    eta = point(1) - (boxes(e, 1) + boxes(e, 3)) / 2;
+                    return e;
+                }
+            }
+            return none;
+        }
+
+        // Перемещение в точке по функциям формы найденного элемента
+        bool interpolate(Coordinates &displacement, Coordinates const &point, Eigen::Ref<const typename Mesh::Vector> const &u) const
+        {
+            Value xi, eta;
+            Size e = this->locate(point, xi, eta);
+            if (e == none)
+                return false;
+            FiniteElement fe;
+            typename FiniteElement::ShapeFunctions sf;
+            fe.calculateShapeFunctions(sf, xi, eta, boxes(e, 2) - boxes(e, 0), boxes(e, 3) - boxes(e, 1));
+            displacement.setZero();
+            for (Size i = 0; i < FiniteElement::nNodes; ++i)
+            {
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                    displacement(d) += sf(i) * u(mesh.getElements()(e)(i) * FiniteElement::nNodeDofs + d);
+            }
+            return true;
+        }
+
+    private:
+        Size getCell(Value const &x, Value const &y) const
+        {
+            Value fx = (x - origin(0)) / cellWidth, fy = (y - origin(1)) / cellHeight;
+            Value slackX = tolerance / cellWidth, slackY = tolerance / cellHeight;
+            if (fx < -slackX || fy < -slackY || fx > nCellsX + slackX || fy > nCellsY + slackY)
+                return none;
+            Size i = std::min<Size>(nCellsX - 1, Size(std::max<Value>(fx, 0)));
+            Size j = std::min<Size>(nCellsY - 1, Size(std::max<Value>(fy, 0)));
+            return j * nCellsX + i;
+        }
+
+        template <typename Function>
+        void forEachElementCell(Function const &function) const
+        {
+            for (Size e = 0; e < Size(boxes.rows()); ++e)
+            {
+                Size i0 = std::min<Size>(nCellsX - 1, Size(std::max<Value>((boxes(e, 0) - tolerance - origin(0)) / cellWidth, 0)));
+                Size j0 = std::min<Size>(nCellsY - 1, Size(std::max<Value>((boxes(e, 1) - tolerance - origin(1)) / cellHeight, 0)));
+                Size i1 = std::min<Size>(nCellsX - 1, Size(std::max<Value>((boxes(e, 2) + tolerance - origin(0)) / cellWidth, 0)));
+                Size j1 = std::min<Size>(nCellsY - 1, Size(std::max<Value>((boxes(e, 3) + tolerance - origin(1)) / cellHeight, 0)));
+                for (Size j = j0; j <= j1; ++j)
+                {
+                    for (Size i = i0; i <= i1; ++i)
+                        function(j * nCellsX + i, e);
+                }
+            }
+        }
+
+        Mesh const &mesh;
+        Eigen::Matrix<Value, Eigen::Dynamic, 4, Eigen::RowMajor> boxes; // xmin, ymin, xmax, ymax
+        Coordinates origin;
+        Size nCellsX = 0, nCellsY = 0;
+        Value cellWidth = 1, cellHeight = 1, tolerance = 0;
+        Indices cellOffsets, cellElements;
+    };
+
+    template <typename T>
+    typename PointLocator<T>::Size const PointLocator<T>::none;
+
+    // Перенос решения глобальной модели на границу подмодели по положению узлов,
+    // а не по их номерам: сетки подмодели и глобальной модели могут быть любыми
+    template <typename T>
+    class SubmodelTransfer
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Indices = typename Mesh::Indices;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using Points = Eigen::Matrix<Value, Eigen::Dynamic, FiniteElement::nNodeDofs, Eigen::RowMajor>;
+
+        SubmodelTransfer(Mesh const &globalMesh, unsigned nThreads = 0) : globalMesh(globalMesh),
+                                                                          locator(globalMesh),
+                                                                          nThreads(nThreads != 0 ? nThreads : hardwareThreads())
+        {
+        }
+
+        // Перемещения глобального решения в точках (по строкам); найденные точки отмечаются в found
+        Size interpolate(Points &displacements, std::vector<char> &found, Points const &points) const
+        {
+            return this->interpolate(displacements, found, points, nThreads);
+        }
+
+        // Заданные перемещения граничных узлов подмодели из глобального решения.
+        // Возвращает false, если часть узлов лежит вне глобальной сетки (они остаются свободными)
+        bool applyBoundaryDisplacements(Mesh &subMesh) const
+        {
+            return this->applyBoundaryDisplacements(subMesh, nThreads);
+        }
+
+        // Независимые подмодели собираются, закрепляются по глобальному решению и решаются
+        // параллельно, у каждой своя сетка и своё разложение. createMesh(i) строит сетку i-й
+        // подмодели прямо в потоке; onSolved(i, mesh) вызывается по готовности, по одному
+        // вызову за раз, после чего сетка освобождается. Подмодели, граница которых выходит за
+        // глобальную сетку или которые не удалось решить, в onSolved не передаются; тогда
+        // возвращается false.
+        // Один материал (E, nu) во всех подмоделях
+        template <typename CreateMesh, typename OnSolved>
+        bool solveSubmodels(Size const &nAreas, CreateMesh const &createMesh,
+                            Value const &elasticityModulus, Value const &poissonRatio,
+                            OnSolved const &onSolved) const
+        {
+            return this->solveAreas(nAreas, createMesh, [&](Mesh &subMesh)
+                                    { return subMesh.calculateSparseStiffnessMatrix(elasticityModulus, poissonRatio); },
+                                    onSolved);
+        }
+
+        // Материалы из таблиц сеток подмоделей: createMesh(i) задаёт их сама (Mesh::setMaterials)
+        template <typename CreateMesh, typename OnSolved>
+        bool solveSubmodels(Size const &nAreas, CreateMesh const &createMesh, OnSolved const &onSolved) const
+        {
+            return this->solveAreas(nAreas, createMesh, [](Mesh &subMesh)
+                                    { return subMesh.calculateSparseStiffnessMatrix(); },
+                                    onSolved);
+        }
+
+    private:
+        template <typename CreateMesh, typename Assemble, typename OnSolved>
+        bool solveAreas(Size const &nAreas, CreateMesh const &createMesh, Assemble const &assemble, OnSolved const &onSolved) const
+        {
+            std::mutex outputMutex;
+            std::vector<char> solved(nAreas, 0);
+            parallelFor(0, nAreas, [&](std::size_t i)
+                        {
+                            Mesh subMesh = createMesh(Size(i));
+                            if (!this->applyBoundaryDisplacements(subMesh, 1))
+                            {
+                                std::lock_guard<std::mutex> lock(outputMutex);
+                                std::cerr << "Error: boundary of submodel " << i << " lies partly outside the global mesh, submodel skipped!" << std::endl;
+                                return;
+                            }
+                            if (!assemble(subMesh))
+                                return;
+                            subMesh.calculateForceVector();
+                            if (!subMesh.calculateSparseDisplacementVector())
+                                return;
+                            solved[i] = 1;
+                            std::lock_guard<std::mutex> lock(outputMutex);
+                            onSolved(Size(i), static_cast<Mesh const &>(subMesh)); },
+                        nThreads);
+            return std::find(solved.begin(), solved.end(), 0) == solved.end();
+        }
+
+        Size interpolate(Points &displacements, std::vector<char> &found, Points const &points, unsigned threads) const
+        {
+            displacements.setZero(points.rows(), FiniteElement::nNodeDofs);
+            found.assign(points.rows(), 0);
+            auto const &u = globalMesh.getDisplacementVector();
+            parallelFor(0, points.rows(), [&](std::size_t p)
+                        {
+                            typename FiniteElement::Coordinates point = points.row(p).transpose(), displacement;
+                            if (locator.interpolate(displacement, point, u))
+                            {
+                                displacements.row(p) = displacement.transpose();
+                                found[p] = 1;
+                            } },
+                        threads, 1024);
+            return std::count(found.begin(), found.end(), 1);
+        }
+
+        bool applyBoundaryDisplacements(Mesh &subMesh, unsigned threads) const
+        {
+            Indices boundaryNodes;
+            subMesh.calculateBoundaryNodes(boundaryNodes);
+            Points points(boundaryNodes.size(), FiniteElement::nNodeDofs), displacements;
+            for (Size i = 0; i < boundaryNodes.size(); ++i)
+            {
+                points.row(i) = subMesh.getNodes()(boundaryNodes(i)).coords.transpose();
+            }
+            std::vector<char> found;
+            Size nFound = this->interpolate(displacements, found, points, threads);
+
+            for (Size i = 0; i < boundaryNodes.size(); ++i)
+            {
+                if (!found[i])
+                    continue;
+                typename Mesh::Conds disps(FiniteElement::nNodeDofs);
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                {
+                    disps(d) = {d, displacements(i, d)};
+                }
+                subMesh.setDisps(boundaryNodes(i), std::move(disps));
+            }
+            return nFound == Size(boundaryNodes.size());
+        }
+
+        Mesh const &globalMesh;
+        PointLocator<T> locator;
+        unsigned nThreads;
+    };
+}
@@ -0,0 +1,534 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace fem
+{
+    // Подконструкции со статической конденсацией. Элементы сетки разбиты на подобласти;
+    // степени свободы узлов, общих для нескольких подобластей, образуют интерфейс, остальные
+    // свободные - внутренние. В каждой подобласти параллельно раскладывается K_ii и строится
+    // дополнение Шура S = K_bb - K_bi K_ii^-1 K_ib; собранное S интерфейса раскладывается один
+    // раз. Разложения сохраняются, поэтому каждый следующий вариант нагрузки стоит только
+    // прямых и обратных ходов. Глобальная матрица жёсткости не собирается.
+    // Конгруэнтные подобласти (совпадающие с точностью до переноса геометрия, сетка,
+    // расположение интерфейса и закреплений и материалы элементов) конденсируются один раз
+    // и делят оператор.
+    template <typename T>
+    class Substructuring
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using Matrix = typename Mesh::Matrix;
+        using SparseMatrix = typename Mesh::SparseMatrix;
+        using Indices = typename Mesh::Indices;
+        using FiniteElement = typename Mesh::FiniteElement;
+
+        Substructuring(Mesh const &mesh, Indices const &elementSubdomains, unsigned nThreads = 0) : mesh(mesh),
+                                                                                                   nThreads(nThreads != 0 ? nThreads : hardwareThreads())
+        {
+            if (mesh.getConstraints().size() != 0)
+                std::cerr << "Warning: substructuring ignores hanging-node constraints" << std::endl;
+            this->classifyDofs(elementSubdomains);
+        }
+
+        // Разбиение на nx x ny прямоугольных подобластей по центрам элементов
+        static Indices partitionGrid(Mesh const &mesh, Size const &nx, Size const &ny)
+        {
+            auto const &nodes = mesh.getNodes();
+            Value x0 = nodes(0).coords(0), x1 = x0, y0 = nodes(0).coords(1), y1 = y0;
+            for (Size i = 0; i < nodes.size(); ++i)
+            {
+                x0 = std::min(x0, nodes(i).coords(0));
+                x1 = std::max(x1, nodes(i).coords(0));
+                y0 = std::min(y0, nodes(i).coords(1));
+                y1 = std::max(y1, nodes(i).coords(1));
+            }
+            Indices subdomains(mesh.getNumElements());
+            for (Size e = 0; e < mesh.getNumElements(); ++e)
+            {
+                typename FiniteElement::Coordinates center = FiniteElement::Coordinates::Zero();
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                    center += nodes(mesh.getElements()(e)(i)).coords / Value(FiniteElement::nNodes);
+                Size i = std::min<Size>(nx - 1, Size((center(0) - x0) / (x1 - x0) * nx));
+                Size j = std::min<Size>(ny - 1, Size((center(1) - y0) / (y1 - y0) * ny));
+                subdomains(e) = j * nx + i;
+            }
+            return subdomains;
+        }
+
+        Size getNumSubdomains() const
+        {
+            return subdomains.size();
+        }
+
+        Size getNumInterfaceDofs() const
+        {
+            return interfaceDofs.size();
+        }
+
+        // Число различных сконденсированных операторов после factorize
+        Size getNumDistinctSubstructures() const
+        {
+            return nDistinct;
+        }
+
+        // Разложения внутренних матриц подобластей и дополнения Шура интерфейса.
+        // Один материал на всю сетку
+        bool factorize(Value const &elasticityModulus, Value const &poissonRatio)
+        {
+            if (!mesh.checkSingleMaterial("substructuring"))
+                return false;
+            typename Mesh::Material const material{elasticityModulus, poissonRatio, 0};
+            return this->factorizeSubstructures([&](Size const &) -> typename Mesh::Material const &
+                                                { return material; });
+        }
+
+        // Материалы элементов из таблицы сетки
+        bool factorize()
+        {
+            if (!mesh.checkMaterialTable())
+                return false;
+            return this->factorizeSubstructures([&](Size const &e) -> typename Mesh::Material const &
+                                                { return mesh.getElementMaterial(e); });
+        }
+
+        // Решение для вектора нагрузки F; заданные перемещения берутся из узлов сетки
+        bool solve(Vector &u, Eigen::Ref<const Vector> const &F) const
+        {
+            return this->solve(u, F, prescribedValues);
+        }
+
+        // prescribed задаёт значения в закреплённых степенях свободы (остальные не используются)
+        bool solve(Vector &u, Eigen::Ref<const Vector> const &F, Eigen::Ref<const Vector> const &prescribed) const
+        {
+            Size nSubdomains = subdomains.size();
+            std::vector<Vector> interiorForces(nSubdomains), contributions(nSubdomains);
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        {
+                            Subdomain const &subdomain = subdomains[s];
+                            Substructure const &substructure = *subdomain.substructure;
+                            Vector uP = gather(prescribed, subdomain.prescribed);
+                            Vector &fI = interiorForces[s];
+                            fI = gather(F, subdomain.interior) - substructure.Kip * uP;
+                            contributions[s] = substructure.Kbp * uP;
+                            if (fI.size() != 0)
+                                contributions[s] += substructure.Kib.transpose() * substructure.interiorSolver.solve(fI); },
+                        nThreads);
+
+            Vector g = gather(F, interfaceDofs);
+            for (Size s = 0; s < nSubdomains; ++s)
+            {
+                for (Size k = 0; k < subdomains[s].interfaceIndices.size(); ++k)
+                    g(subdomains[s].interfaceIndices[k]) -= contributions[s](k);
+            }
+            Vector uB = interfaceDofs.empty() ? Vector() : Vector(interfaceSolver.solve(g));
+            if (!interfaceDofs.empty() && interfaceSolver.info() != Eigen::Success)
+                return false;
+
+            u.setZero(F.size());
+            for (Size k = 0; k < interfaceDofs.size(); ++k)
+                u(interfaceDofs[k]) = uB(k);
+            for (Size dof = 0; dof < prescribedDofs.size(); ++dof)
+            {
+                if (prescribedDofs[dof])
+                    u(dof) = prescribed(dof);
+            }
+            // Внутренние степени свободы подобластей не пересекаются, запись без блокировок
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        {
+                            Subdomain const &subdomain = subdomains[s];
+                            Substructure const &substructure = *subdomain.substructure;
+                            if (subdomain.interior.empty())
+                                return;
+                            Vector uBLocal(subdomain.interfaceIndices.size());
+                            for (Size k = 0; k < subdomain.interfaceIndices.size(); ++k)
+                                uBLocal(k) = uB(subdomain.interfaceIndices[k]);
+                            Vector uI = substructure.interiorSolver.solve(interiorForces[s] - substructure.Kib * uBLocal);
+                            for (Size k = 0; k < subdomain.interior.size(); ++k)
+                                u(subdomain.interior[k]) = uI(k); },
+                        nThreads);
+            return true;
+        }
+
+    private:
+        enum Category : Size
+        {
+            Interior = 0,
+            Interface = 1,
+            Prescribed = 2
+        };
+
+        // Сконденсированный оператор подобласти в её локальной нумерации
+        struct Substructure
+        {
+            SparseMatrix Kii, Kib, Kip, Kbp;
+            Matrix Kbb, schurComplement;
+            Eigen::SimplicialLDLT<SparseMatrix> interiorSolver;
+        };
+
+        struct Subdomain
+        {
+            std::vector<Size> elements;
+            std::vector<Size> interior, interface, prescribed; // глобальные степени свободы
+            std::vector<Size> interfaceIndices;                // номера в интерфейсе
+            std::vector<Size> elementDofs;                     // для каждой степени свободы элемента: 3 * индекс + категория
+            std::vector<long long> signature;                  // канонический вид для поиска конгруэнтных подобластей
+            std::size_t signatureHash = 0;
+            std::vector<Size> canonicalElements;               // номера в elements в порядке сигнатуры
+            std::shared_ptr<Substructure> substructure;
+        };
+
+        static void combineHash(std::size_t &hash, std::size_t const &value)
+        {
+            hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        }
+
+        // Подобласти группируются по сигнатуре и материалам элементов в каноническом порядке;
+        // сигнатура не зависит от материалов, поэтому строится один раз в конструкторе
+        template <typename MaterialOf>
+        bool factorizeSubstructures(MaterialOf const &materialOf)
+        {
+            std::vector<std::vector<Value>> materialKeys(subdomains.size());
+            std::vector<Size> representatives, representative(subdomains.size());
+            std::unordered_map<std::size_t, std::vector<Size>> byHash;
+            for (Size s = 0; s < subdomains.size(); ++s)
+            {
+                Subdomain const &subdomain = subdomains[s];
+                std::size_t hash = subdomain.signatureHash;
+                for (Size k : subdomain.canonicalElements)
+                {
+                    auto const &material = materialOf(subdomain.elements[k]);
+                    materialKeys[s].push_back(material.elasticityModulus);
+                    materialKeys[s].push_back(material.poissonRatio);
+                    combineHash(hash, std::hash<Value>()(material.elasticityModulus));
+                    combineHash(hash, std::hash<Value>()(material.poissonRatio));
+                }
+                auto &candidates = byHash[hash];
+                auto found = std::find_if(candidates.begin(), candidates.end(), [&](Size const &r)
+                                          { return subdomains[r].signature == subdomain.signature && materialKeys[r] == materialKeys[s]; });
+                if (found != candidates.end())
+                {
+                    representative[s] = *found;
+                    continue;
+                }
+                candidates.push_back(s);
+                representative[s] = s;
+                representatives.push_back(s);
+            }
+            nDistinct = representatives.size();
+
+            std::vector<char> ok(subdomains.size(), 1);
+            parallelFor(0, representatives.size(), [&](std::size_t k)
+                        {
+                            Size s = representatives[k];
+                            auto substructure = std::make_shared<Substructure>();
+                            ok[s] = this->condense(*substructure, subdomains[s], materialOf);
+                            subdomains[s].substructure = substructure; },
+                        nThreads);
+            for (Size s = 0; s < subdomains.size(); ++s)
+                subdomains[s].substructure = subdomains[representative[s]].substructure;
+            if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+            {
+                std::cerr << "Error: subdomain interior factorization failed!" << std::endl;
+                return false;
+            }
+            return this->factorizeInterface();
+        }
+
+        static Vector gather(Eigen::Ref<const Vector> const &source, std::vector<Size> const &dofs)
+        {
+            Vector result(dofs.size());
+            for (Size k = 0; k < dofs.size(); ++k)
+                result(k) = source(dofs[k]);
+            return result;
+        }
+
+        void classifyDofs(Indices const &elementSubdomains)
+        {
+            auto const &nodes = mesh.getNodes();
+            auto const &elements = mesh.getElements();
+            Size nNodes = nodes.size(), nDofs = nNodes * FiniteElement::nNodeDofs;
+            Size nSubdomains = elementSubdomains.size() != 0 ? elementSubdomains.maxCoeff() + 1 : 0;
+            subdomains.assign(nSubdomains, Subdomain());
+            for (Size e = 0; e < elements.size(); ++e)
+                subdomains[elementSubdomains(e)].elements.push_back(e);
+
+            prescribedDofs.assign(nDofs, 0);
+            prescribedValues.setZero(nDofs);
+            for (auto const &p : mesh.getPrescribedDofs())
+            {
+                prescribedDofs[p.first] = 1;
+                prescribedValues(p.first) = p.second;
+            }
+
+            // Узел интерфейса - узел, встречающийся в нескольких подобластях
+            std::vector<Size> owner(nNodes, none), shared(nNodes, 0);
+            for (Size s = 0; s < nSubdomains; ++s)
+            {
+                for (Size e : subdomains[s].elements)
+                {
+                    for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                    {
+                        Size n = elements(e)(i);
+                        if (owner[n] == none)
+                            owner[n] = s;
+                        else if (owner[n] != s)
+                            shared[n] = 1;
+                    }
+                }
+            }
+            std::vector<Size> interfaceIndex(nDofs, none);
+            for (Size n = 0; n < nNodes; ++n)
+            {
+                for (Size d = 0; d < FiniteElement::nNodeDofs && shared[n]; ++d)
+                {
+                    Size dof = n * FiniteElement::nNodeDofs + d;
+                    if (!prescribedDofs[dof])
+                    {
+                        interfaceIndex[dof] = interfaceDofs.size();
+                        interfaceDofs.push_back(dof);
+                    }
+                }
+            }
+
+            parallelFor(0, nSubdomains, [&](std::size_t s)
+                        { this->numberSubdomain(subdomains[s], shared, interfaceIndex); },
+                        nThreads);
+        }
+
+        // Локальная нумерация: узлы подобласти по возрастанию (y, x), чтобы она не зависела
+        // от глобальной нумерации узлов
+        void numberSubdomain(Subdomain &subdomain, std::vector<Size> const &shared, std::vector<Size> const &interfaceIndex) const
+        {
+            auto const &nodes = mesh.getNodes();
+            auto const &elements = mesh.getElements();
+            std::vector<Size> localNodes;
+            for (Size e : subdomain.elements)
+            {
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                    localNodes.push_back(elements(e)(i));
+            }
+            std::sort(localNodes.begin(), localNodes.end());
+            localNodes.erase(std::unique(localNodes.begin(), localNodes.end()), localNodes.end());
+            std::vector<Size> byPosition = localNodes;
+            std::sort(byPosition.begin(), byPosition.end(), [&](Size const &a, Size const &b)
+                      { return std::make_pair(nodes(a).coords(1), nodes(a).coords(0)) <
+                               std::make_pair(nodes(b).coords(1), nodes(b).coords(0)); });
+
+            std::vector<Size> codes(localNodes.size() * FiniteElement::nNodeDofs);
+            for (Size n : byPosition)
+            {
+                Size local = std::lower_bound(localNodes.begin(), localNodes.end(), n) - localNodes.begin();
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                {
+                    Size dof = n * FiniteElement::nNodeDofs + d;
+                    Size &code = codes[local * FiniteElement::nNodeDofs + d];
+                    if (prescribedDofs[dof])
+                    {
+                        code = 3 * subdomain.prescribed.size() + Prescribed;
+                        subdomain.prescribed.push_back(dof);
+                    }
+                    else if (shared[n])
+                    {
+                        code = 3 * subdomain.interface.size() + Interface;
+                        subdomain.interface.push_back(dof);
+                        subdomain.interfaceIndices.push_back(interfaceIndex[dof]);
+                    }
+                    else
+                    {
+                        code = 3 * subdomain.interior.size() + Interior;
+                        subdomain.interior.push_back(dof);
+                    }
+                }
+            }
+
+            subdomain.elementDofs.resize(subdomain.elements.size() * FiniteElement::nElemDofs);
+            for (Size k = 0; k < subdomain.elements.size(); ++k)
+            {
+                for (Size i = 0; i < FiniteElement::nElemDofs; ++i)
+                {
+                    Size n = elements(subdomain.elements[k])(i / FiniteElement::nNodeDofs);
+                    Size local = std::lower_bound(localNodes.begin(), localNodes.end(), n) - localNodes.begin();
+                    subdomain.elementDofs[k * FiniteElement::nElemDofs + i] = codes[local * FiniteElement::nNodeDofs + i % FiniteElement::nNodeDofs];
+                }
+            }
+            this->calculateSignature(subdomain, localNodes, byPosition, codes);
+        }
+
+        // Сигнатура подобласти в порядке (y, x): координаты узлов относительно первого узла,
+        // квантованные с относительным допуском, категории степеней свободы и упорядоченный
+        // список элементов в позиционных номерах узлов. Совпадение сигнатур и материалов
+        // элементов в этом порядке (canonicalElements) означает совпадение сконденсированных
+        // операторов в локальной нумерации
+        void calculateSignature(Subdomain &subdomain, std::vector<Size> const &localNodes,
+                                std::vector<Size> const &byPosition, std::vector<Size> const &codes) const
+        {
+            auto const &nodes = mesh.getNodes();
+            auto const &elements = mesh.getElements();
+            auto &signature = subdomain.signature;
+            signature.clear();
+            if (byPosition.empty())
+                return;
+            typename FiniteElement::Coordinates origin = nodes(byPosition.front()).coords, extent;
+            extent.setZero();
+            for (Size n : byPosition)
+                extent = extent.cwiseMax((nodes(n).coords - origin).cwiseAbs());
+            Value quantum = std::sqrt(Eigen::NumTraits<Value>::epsilon()) * std::max<Value>(extent.maxCoeff(), Value(1e-30));
+
+            std::vector<Size> position(localNodes.size());
+            signature.push_back(byPosition.size());
+            signature.push_back(subdomain.elements.size());
+            for (Size p = 0; p < byPosition.size(); ++p)
+            {
+                Size n = byPosition[p];
+                Size local = std::lower_bound(localNodes.begin(), localNodes.end(), n) - localNodes.begin();
+                position[local] = p;
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                    signature.push_back(std::llround((nodes(n).coords(d) - origin(d)) / quantum));
+                for (Size d = 0; d < FiniteElement::nNodeDofs; ++d)
+                    signature.push_back(codes[local * FiniteElement::nNodeDofs + d] % 3);
+            }
+            std::vector<Eigen::Matrix<long long, FiniteElement::nNodes, 1>> connectivity(subdomain.elements.size());
+            for (Size k = 0; k < subdomain.elements.size(); ++k)
+            {
+                for (Size i = 0; i < FiniteElement::nNodes; ++i)
+                {
+                    Size n = elements(subdomain.elements[k])(i);
+                    connectivity[k](i) = position[std::lower_bound(localNodes.begin(), localNodes.end(), n) - localNodes.begin()];
+                }
+            }
+            auto &order = subdomain.canonicalElements;
+            order.resize(subdomain.elements.size());
+            for (Size k = 0; k < order.size(); ++k)
+                order[k] = k;
+            std::sort(order.begin(), order.end(), [&](Size const &a, Size const &b)
+                      { return std::lexicographical_compare(connectivity[a].data(), connectivity[a].data() + connectivity[a].size(),
+                                                            connectivity[b].data(), connectivity[b].data() + connectivity[b].size()); });
+            for (Size k : order)
+                signature.insert(signature.end(), connectivity[k].data(), connectivity[k].data() + connectivity[k].size());
+
+            std::size_t hash = 0;
+            for (long long value : signature)
+                combineHash(hash, std::hash<long long>()(value));
+            subdomain.signatureHash = hash;
+        }
+
+        template <typename MaterialOf>
+        bool condense(Substructure &substructure, Subdomain const &subdomain, MaterialOf const &materialOf) const
+        {
+            Size nI = subdomain.interior.size(), nB = subdomain.interface.size(), nP = subdomain.prescribed.size();
+            std::vector<Eigen::Triplet<Value>> ii, ib, ip, bp;
+            substructure.Kbb.setZero(nB, nB);
+
+            FiniteElement fe;
+            typename FiniteElement::Nodes feNodes;
+            typename FiniteElement::StiffnessMatrix sm;
+            for (Size k = 0; k < subdomain.elements.size(); ++k)
+            {
+                mesh.getElementNodes(feNodes, subdomain.elements[k]);
+                auto const &material = materialOf(subdomain.elements[k]);
+                fe.calculateStiffnessMatrix(sm, feNodes, material.elasticityModulus, material.poissonRatio);
+                Size const *codes = &subdomain.elementDofs[k * FiniteElement::nElemDofs];
+                for (Size i = 0; i < FiniteElement::nElemDofs; ++i)
+                {
+                    Size ci = codes[i] % 3, li = codes[i] / 3;
+                    for (Size j = 0; j < FiniteElement::nElemDofs; ++j)
+                    {
+                        Size cj = codes[j] % 3, lj = codes[j] / 3;
+                        if (ci == Interior && cj == Interior)
+                            ii.emplace_back(li, lj, sm(i, j));
+                        else if (ci == Interior && cj == Interface)
+                            ib.emplace_back(li, lj, sm(i, j));
+                        else if (ci == Interior && cj == Prescribed)
+                            ip.emplace_back(li, lj, sm(i, j));
+                        else if (ci == Interface && cj == Interface)
+                            substructure.Kbb(li, lj) += sm(i, j);
+                        else if (ci == Interface && cj == Prescribed)
+                            bp.emplace_back(li, lj, sm(i, j));
+                    }
+                }
+            }
+            substructure.Kii.resize(nI, nI);
+            substructure.Kii.setFromTriplets(ii.begin(), ii.end());
+            substructure.Kib.resize(nI, nB);
+            substructure.Kib.setFromTriplets(ib.begin(), ib.end());
+            substructure.Kip.resize(nI, nP);
+            substructure.Kip.setFromTriplets(ip.begin(), ip.end());
+            substructure.Kbp.resize(nB, nP);
+            substructure.Kbp.setFromTriplets(bp.begin(), bp.end());
+
+            substructure.schurComplement = substructure.Kbb;
+            if (nI == 0)
+                return true;
+            substructure.interiorSolver.compute(substructure.Kii);
+            if (substructure.interiorSolver.info() != Eigen::Success)
+                return false;
+            // Дополнение Шура по блокам столбцов, чтобы не хранить K_ii^-1 K_ib целиком
+            Size const block = 64;
+            for (Size c = 0; c < nB; c += block)
+            {
+                Size width = std::min(block, nB - c);
+                Matrix rhs = Matrix(substructure.Kib.middleCols(c, width));
+                Matrix solution = substructure.interiorSolver.solve(rhs);
+                substructure.schurComplement.middleCols(c, width) -= substructure.Kib.transpose() * solution;
+            }
+            return true;
+        }
+
+        bool factorizeInterface()
+        {
+            Size nInterface = interfaceDofs.size();
+            if (nInterface == 0)
+                return true;
+            std::vector<Eigen::Triplet<Value>> triplets;
+            for (auto const &subdomain : subdomains)
+            {
+                Matrix const &S = subdomain.substructure->schurComplement;
+                for (Size j = 0; j < subdomain.interfaceIndices.size(); ++j)
+                {
+                    for (Size i = 0; i < subdomain.interfaceIndices.size(); ++i)
+                    {
+                        if (S(i, j) != 0)
+                            triplets.emplace_back(subdomain.interfaceIndices[i], subdomain.interfaceIndices[j], S(i, j));
+                    }
+                }
+            }
+            SparseMatrix S(nInterface, nInterface);
+            S.setFromTriplets(triplets.begin(), triplets.end());
+            interfaceSolver.compute(S);
+            if (interfaceSolver.info() != Eigen::Success)
+            {
+                std::cerr << "Error: interface Schur complement factorization failed!" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        static Size const none = ~Size(0);
+
+        Mesh const &mesh;
+        unsigned nThreads;
+        std::vector<Subdomain> subdomains;
+        std::vector<Size> interfaceDofs;
+        Size nDistinct = 0;
+        std::vector<char> prescribedDofs;
+        Vector prescribedValues;
+        Eigen::SimplicialLDLT<SparseMatrix> interfaceSolver;
+    };
+
+    template <typename T>
+    typename Substructuring<T>::Size const Substructuring<T>::none;
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include "mesh.hpp"
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace fem
+{
+    // Кусочно-линейная зависимость множителя нагрузки от времени; за пределами таблицы
+    // значение постоянно, пустая таблица - множитель 1
+    template <typename T>
+    class LoadCurve
+    {
+    public:
+        using Value = T;
+
+        LoadCurve() = default;
+
+        LoadCurve(std::vector<std::pair<Value, Value>> points) : points(std::move(points))
+        {
+            std::sort(this->points.begin(), this->points.end());
+        }
+
+        Value operator()(Value const &time) const
+        {
+            if (points.empty())
+                return 1;
+            if (time <= points.front().first)
+                return points.front().second;
+            if (time >= points.back().first)
+                return points.back().second;
+            auto next = std::upper_bound(points.begin(), points.end(), time, [](Value const &t, std::pair<Value, Value> const &point)
+                                         { return t < point.first; });
+            auto previous = next - 1;
+            Value fraction = (time - previous->first) / (next->first - previous->first);
+            return previous->second + fraction * (next->second - previous->second);
+        }
+
+    private:
+        std::vector<std::pair<Value, Value>> points;
+    };
+
+    // Неявное интегрирование по времени M a + C v + K u = F(t) методом HHT-alpha (при alpha = 0 -
+    // метод Ньюмарка со средним ускорением). Эффективная матрица c0 M + (1 + alpha)(c1 C + K)
+    // раскладывается один раз для шага dt и пересчитывается только при его изменении; шаг по
+    // времени - это умножения на разреженные K и M и один прямой и обратный ход.
+    // Узловые силы сетки умножаются на forceCurve(t), заданные перемещения - на displacementCurve(t).
+    // Демпфирование по Рэлею: C = massDamping M + stiffnessDamping K
+    template <typename T>
+    class TransientAnalysis
+    {
+    public:
+        using Mesh = fem::Mesh<T>;
+        using Value = T;
+        using Size = typename Mesh::Size;
+        using Vector = typename Mesh::Vector;
+        using SparseMatrix = typename Mesh::SparseMatrix;
+        using FiniteElement = typename Mesh::FiniteElement;
+        using LoadCurve = fem::LoadCurve<T>;
+
+        // Матрицы жёсткости и масс и вектор сил сетки должны быть вычислены
+        TransientAnalysis(Mesh const &mesh) : mesh(mesh),
+                                              K(mesh.getSparseStiffnessMatrix()),
+                                              M(mesh.getSparseMassMatrix()),
+                                              F0(mesh.getForceVector())
+        {
+            Size nDofs = K.rows();
+            u.setZero(nDofs);
+            v.setZero(nDofs);
+            a.setZero(nDofs);
+            prescribed = mesh.getPrescribedDofs();
+            fixedDofs = mesh.getConstrainedDofs();
+            for (auto const &p : prescribed)
+                fixedDofs[p.first] = 1;
+        }
+
+        // alpha из [-1/3, 0]: отрицательные значения гасят высокочастотный шум
+        void setHhtAlpha(Value const &alpha)
+        {
+            hhtAlpha = alpha;
+            beta = (1 - alpha) * (1 - alpha) / 4;
+            gamma = Value(0.5) - alpha;
+            factorizedStep = 0;
+        }
+
+        void setRayleighDamping(Value const &massDamping, Value const &stiffnessDamping)
+        {
+            this->massDamping = massDamping;
+            this->stiffnessDamping = stiffnessDamping;
+            factorizedStep = 0;
+        }
+
+        void setForceCurve(LoadCurve curve)
+        {
+            forceCurve = std::move(curve);
+        }
+
+        void setDisplacementCurve(LoadCurve curve)
+        {
+            displacementCurve = std::move(curve);
+        }
+
+        // Начальные перемещения и скорости; ускорения находятся из уравнения движения при t = 0
+        bool initialize(Eigen::Ref<const Vector> const &initialDisplacements,
+                        Eigen::Ref<const Vector> const &initialVelocities)
+        {
+            time = 0;
+            u = initialDisplacements;
+            v = initialVelocities;
+            this->setPrescribed(u, 0);
+
+            SparseMatrix A = M;
+            this->fixRows(A);
+            Eigen::SimplicialLDLT<SparseMatrix> massSolver(A);
+            if (massSolver.info() != Eigen::Success)
+            {
+                std::cerr << "Error: mass matrix factorization failed!" << std::endl;
+                return false;
+            }
+            Vector r = forceCurve(0) * F0 - K * u - massDamping * (M * v) - stiffnessDamping * (K * v);
+            for (Size dof = 0; dof < fixedDofs.size(); ++dof)
+            {
+                if (fixedDofs[dof])
+                    r(dof) = 0;
+            }
+            a = massSolver.solve(r);
+            return true;
+        }
+
+        bool initialize()
+        {
+            return this->initialize(Vector::Zero(K.rows()), Vector::Zero(K.rows()));
+        }
+
+        // Один шаг dt; при новом dt эффективная матрица раскладывается заново
+        bool step(Value const &dt)
+        {
+            if (dt != factorizedStep && !this->factorize(dt))
+                return false;
+
+            Value const alpha = hhtAlpha;
+            Value c0 = 1 / (beta * dt * dt), c1 = gamma / (beta * dt), c2 = 1 / (beta * dt), c3 = 1 / (2 * beta) - 1;
+            Value c4 = 1 - gamma / beta, c5 = dt * (1 - gamma / (2 * beta));
+            Value timeNext = time + dt, timeAlpha = (1 + alpha) * timeNext - alpha * time;
+
+            // Правая часть: F(t_{n+1+alpha}) + M (c0 u + c2 v + c3 a) + C ((1+alpha)(c1 u - c4 v - c5 a) + alpha v) + alpha K u
+            inertia.noalias() = c0 * u + c2 * v + c3 * a;
+            damping.noalias() = (1 + alpha) * (c1 * u - c4 * v - c5 * a) + alpha * v;
+            rhs.noalias() = forceCurve(timeAlpha) * F0;
+            rhs.noalias() += M * (inertia + massDamping * damping);
+            rhs.noalias() += K * (alpha * u + stiffnessDamping * damping);
+
+            uNext.setZero(u.size());
+            this->setPrescribed(uNext, timeNext);
+            rhs.noalias() -= prescribedColumns * prescribedValues;
+            for (Size dof = 0; dof < fixedDofs.size(); ++dof)
+            {
+                if (fixedDofs[dof])
+                    rhs(dof) = uNext(dof);
+            }
+            uNext = solver.solve(rhs);
+            mesh.applyConstraints(uNext);
+
+            // Ньюмарк: ускорения и скорости по новым перемещениям
+            aNext.noalias() = c0 * (uNext - u) - c2 * v - c3 * a;
+            v += dt * ((1 - gamma) * a + gamma * aNext);
+            a.swap(aNext);
+            u.swap(uNext);
+            time = timeNext;
+            ++nSteps;
+            return true;
+        }
+
+        // nSteps шагов dt; onOutput(step, analysis) вызывается после каждого outputInterval-го шага
+        template <typename OnOutput>
+        bool run(Size const &steps, Value const &dt, Size const &outputInterval, OnOutput const &onOutput)
+        {
+            FEM_PROFILE("transient analysis");
+            for (Size k = 1; k <= steps; ++k)
+            {
+                if (!this->step(dt))
+                    return false;
+                if (outputInterval != 0 && (k % outputInterval == 0 || k == steps))
+                    onOutput(k, static_cast<TransientAnalysis const &>(*this));
+            }
+            return true;
+        }
+
+        Value getTime() const
+        {
+            return time;
+        }
+
+        const Vector &getDisplacements() const
+        {
+            return u;
+        }
+
+        const Vector &getVelocities() const
+        {
+            return v;
+        }
+
+        const Vector &getAccelerations() const
+        {
+            return a;
+        }
+
+        Size getNumSteps() const
+        {
+            return nSteps;
+        }
+
+        Size getNumFactorizations() const
+        {
+            return nFactorizations;
+        }
+
+    private:
+        bool factorize(Value const &dt)
+        {
+            Value c0 = 1 / (beta * dt * dt), c1 = gamma / (beta * dt);
+            SparseMatrix A = (c0 + (1 + hhtAlpha) * c1 * massDamping) * M +
+                             ((1 + hhtAlpha) * (1 + c1 * stiffnessDamping)) * K;
+
+            // Столбцы заданных перемещений сохраняются для переноса в правую часть на каждом шаге
+            std::vector<Eigen::Triplet<Value>> triplets;
+            std::vector<Size> column(fixedDofs.size(), ~Size(0));
+            for (Size k = 0; k < prescribed.size(); ++k)
+                column[prescribed[k].first] = k;
+            for (Eigen::Index j = 0; j < A.outerSize(); ++j)
+            {
+                if (column[j] == ~Size(0))
+                    continue;
+                for (typename SparseMatrix::InnerIterator it(A, j); it; ++it)
+                {
+                    if (!fixedDofs[it.row()])
+                        triplets.emplace_back(it.row(), column[j], it.value());
+                }
+            }
+            prescribedColumns.resize(A.rows(), prescribed.size());
+            prescribedColumns.setFromTriplets(triplets.begin(), triplets.end());
+            prescribedValues.setZero(prescribed.size());
+
+            this->fixRows(A);
+            solver.compute(A);
+            if (solver.info() != Eigen::Success)
+            {
+                std::cerr << "Error: effective stiffness matrix factorization failed!" << std::endl;
+                factorizedStep = 0;
+                return false;
+            }
+            factorizedStep = dt;
+            ++nFactorizations;
+            return true;
+        }
+
+        // Строки и столбцы закреплённых и связанных степеней свободы заменяются единицей на диагонали
+        void fixRows(SparseMatrix &A) const
+        {
+            A.prune([&](Eigen::Index const &row, Eigen::Index const &col, Value const &)
+                    { return !fixedDofs[row] && !fixedDofs[col]; });
+            for (Size dof = 0; dof < fixedDofs.size(); ++dof)
+            {
+                if (fixedDofs[dof])
+                    A.coeffRef(dof, dof) = 1;
+            }
+            A.makeCompressed();
+        }
+
+        void setPrescribed(Vector &target, Value const &t)
+        {
+            Value factor = displacementCurve(t);
+            if (Size(prescribedValues.size()) != prescribed.size())
+                prescribedValues.resize(prescribed.size());
+            for (Size k = 0; k < prescribed.size(); ++k)
+            {
+                prescribedValues(k) = factor * prescribed[k].second;
+                target(prescribed[k].first) = prescribedValues(k);
+            }
+        }
+
+        Mesh const &mesh;
+        SparseMatrix K, M;
+        Vector F0;
+        std::vector<std::pair<Size, Value>> prescribed; // степень свободы и её значение при множителе 1
+        std::vector<char> fixedDofs;
+        SparseMatrix prescribedColumns;
+        Vector prescribedValues;
+        Eigen::SimplicialLDLT<SparseMatrix> solver;
+        Value factorizedStep = 0;
+        Value hhtAlpha = 0, beta = Value(0.25), gamma = Value(0.5);
+        Value massDamping = 0, stiffnessDamping = 0;
+        LoadCurve forceCurve, displacementCurve;
+        Value time = 0;
+        Size nSteps = 0, nFactorizations = 0;
+        Vector u, v, a, uNext, aNext, rhs, inertia, damping;
+    };
+}